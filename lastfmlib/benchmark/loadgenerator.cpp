@@ -0,0 +1,191 @@
+#include "lastfmlib/handshakeadmission.h"
+#include "lastfmlib/lastfmscrobbler.h"
+#include "lastfmlib/unittest/scrobbleserverstub.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Simulates many players that scrobble to the local stand-in server and reports
+// the throughput, the latency of the player-facing calls and the resource usage
+// usage: loadgenerator [players] [seconds] [speedup] [server latency in ms] [sync|async|both]
+//
+// Time is compressed by the speedup factor: a track of 4 minutes is played in
+// 240 ms with the default factor of 1000. The start time of every track is set
+// back by the simulated play time, so the scrobbler sees the real play time.
+
+struct ProcessStatus {
+    int threads {};
+    long rssInKb {};
+};
+
+static ProcessStatus readProcessStatus()
+{
+    ProcessStatus status;
+    ifstream file("/proc/self/status");
+    string key;
+    while (file >> key) {
+        if (key == "Threads:") {
+            file >> status.threads;
+        } else if (key == "VmRSS:") {
+            file >> status.rssInKb;
+        }
+        file.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    return status;
+}
+
+static double percentile(const vector<double>& sortedValues, double fraction)
+{
+    if (sortedValues.empty()) {
+        return 0;
+    }
+    auto index = static_cast<size_t>(fraction * static_cast<double>(sortedValues.size() - 1));
+    return sortedValues[index];
+}
+
+struct PlayerResult {
+    vector<double> latencies;
+    int tracks {};
+    int skips {};
+    int pauses {};
+};
+
+static void simulatePlayer(int index, bool synchronous, const string& handshakeUrl, double speedup, steady_clock::time_point end, PlayerResult& result)
+{
+    mt19937 random(static_cast<unsigned>(index));
+    // track lengths are log-normal with a median of about 4 minutes
+    lognormal_distribution<double> trackLength(log(230.0), 0.35);
+    bernoulli_distribution skip(0.15);
+    bernoulli_distribution pause(0.05);
+    uniform_real_distribution<double> pauseLength(5, 120);
+
+    auto sleepSimulated = [speedup](double seconds) {
+        this_thread::sleep_for(duration<double>(seconds / speedup));
+    };
+
+    auto timed = [&result](auto call) {
+        auto start = steady_clock::now();
+        call();
+        result.latencies.push_back(duration<double, micro>(steady_clock::now() - start).count());
+    };
+
+    LastFmScrobbler scrobbler("player" + to_string(index), "pass", false, synchronous);
+    scrobbler.setHandshakeUrl(handshakeUrl);
+
+    // the players do not start at the same moment
+    sleepSimulated(uniform_real_distribution<double>(0, 240)(random));
+
+    while (steady_clock::now() < end) {
+        int length = clamp(static_cast<int>(trackLength(random)), 30, 1200);
+        bool skipped = skip(random);
+        double played = skipped ? uniform_real_distribution<double>(3, length * 0.4)(random) : length;
+
+        SubmissionInfo info("Artist " + to_string(random() % 5000), "Track " + to_string(random() % 20000), time(nullptr) - static_cast<time_t>(played));
+        info.setAlbum("Album " + to_string(random() % 10000));
+        info.setTrackLength(length);
+        timed([&] { scrobbler.startedPlaying(info); });
+        ++result.tracks;
+        result.skips += skipped;
+
+        if (pause(random)) {
+            ++result.pauses;
+            timed([&] { scrobbler.pausePlaying(true); });
+            sleepSimulated(pauseLength(random));
+            timed([&] { scrobbler.pausePlaying(false); });
+        }
+
+        sleepSimulated(played);
+    }
+
+    timed([&] { scrobbler.finishedPlaying(); });
+    scrobbler.shutdown(seconds(5));
+}
+
+static void runScenario(bool synchronous, int players, seconds runTime, double speedup, milliseconds latency)
+{
+    ScrobbleServerStub server;
+    server.setLatency(latency);
+
+    vector<PlayerResult> results(static_cast<size_t>(players));
+    vector<thread> threads;
+
+    atomic<bool> running { true };
+    ProcessStatus peak;
+    thread sampler([&] {
+        while (running) {
+            ProcessStatus status = readProcessStatus();
+            peak.threads = max(peak.threads, status.threads);
+            peak.rssInKb = max(peak.rssInKb, status.rssInKb);
+            this_thread::sleep_for(100ms);
+        }
+    });
+
+    auto start = steady_clock::now();
+    auto end = start + runTime;
+    for (int i = 0; i < players; ++i) {
+        threads.emplace_back(simulatePlayer, i, synchronous, server.getHandshakeUrl(), speedup, end, ref(results[static_cast<size_t>(i)]));
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+    double elapsed = duration<double>(steady_clock::now() - start).count();
+    running = false;
+    sampler.join();
+
+    vector<double> latencies;
+    int tracks = 0, skips = 0, pauses = 0;
+    for (auto& result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        tracks += result.tracks;
+        skips += result.skips;
+        pauses += result.pauses;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    int requests = server.m_Handshakes + server.m_NowPlayingRequests + server.m_SubmissionRequests;
+    cout << (synchronous ? "synchronous" : "asynchronous") << ": " << players << " players, " << tracks << " tracks ("
+         << skips << " skipped, " << pauses << " paused) in " << fixed << setprecision(1) << elapsed << " s" << endl
+         << "  scrobbles/s       " << setprecision(0) << server.m_SubmittedTracks / elapsed << " (" << server.m_SubmittedTracks << " scrobbles)" << endl
+         << "  player calls      " << latencies.size() << ", latency p50 " << setprecision(1) << percentile(latencies, 0.5)
+         << " us, p99 " << percentile(latencies, 0.99) << " us, p999 " << percentile(latencies, 0.999) << " us" << endl
+         << "  peak threads      " << peak.threads << endl
+         << "  peak rss          " << peak.rssInKb / 1024.0 << " MiB" << endl
+         << "  requests          " << requests << " (" << server.m_Handshakes << " handshakes, "
+         << server.m_NowPlayingRequests << " now playing, " << server.m_SubmissionRequests << " submissions)" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    int players = argc > 1 ? stoi(argv[1]) : 100;
+    seconds runTime(argc > 2 ? stoi(argv[2]) : 10);
+    double speedup = argc > 3 ? stod(argv[3]) : 1000;
+    milliseconds latency(argc > 4 ? stoi(argv[4]) : 5);
+    string mode = argc > 5 ? argv[5] : "both";
+
+    // all players start at once, the handshakes are not rate limited so
+    // the measurement is not dominated by the admission control
+    HandshakeAdmission::instance().configure(static_cast<unsigned int>(players), 0, 1);
+
+    if (mode != "async") {
+        runScenario(true, players, runTime, speedup, latency);
+    }
+    if (mode != "sync") {
+        runScenario(false, players, runTime, speedup, latency);
+    }
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include "lastfmlib/lastfmclient.h"
+#include "lastfmlib/nowplayinginfo.h"
+#include "lastfmlib/submissioninfo.h"
+#include "lastfmlib/submissioninfocollection.h"
+#include "lastfmlib/utils/stringoperations.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <locale.h>
+#include <new>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+// Measures the time and the heap allocations per operation of the serialization and hashing hot paths
+// usage: lastfmlib-bench [filter] [milliseconds per benchmark]
+
+static atomic<uint64_t> g_Allocations { 0 };
+static atomic<uint64_t> g_AllocatedBytes { 0 };
+
+void* operator new(size_t size)
+{
+    g_Allocations.fetch_add(1, memory_order_relaxed);
+    g_AllocatedBytes.fetch_add(size, memory_order_relaxed);
+    if (void* pData = malloc(size > 0 ? size : 1)) {
+        return pData;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pData) noexcept
+{
+    free(pData);
+}
+
+void operator delete(void* pData, size_t) noexcept
+{
+    free(pData);
+}
+
+// keeps the compiler from optimizing away the result of the benchmarked operation
+template <typename T>
+static void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+static void run(const string& filter, milliseconds minTime, const string& name, const function<void()>& operation)
+{
+    if (!filter.empty() && name.find(filter) == string::npos) {
+        return;
+    }
+
+    // warm up and find the number of iterations that takes at least the minimum time
+    uint64_t iterations = 1;
+    for (;;) {
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            operation();
+        }
+        if (steady_clock::now() - start >= minTime / 10 || iterations >= (1u << 30)) {
+            iterations *= 10;
+            break;
+        }
+        iterations *= 2;
+    }
+
+    uint64_t allocations = g_Allocations;
+    uint64_t bytes = g_AllocatedBytes;
+    auto start = steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        operation();
+    }
+    double nanoseconds = duration<double, nano>(steady_clock::now() - start).count();
+    allocations = g_Allocations - allocations;
+    bytes = g_AllocatedBytes - bytes;
+
+    cout << left << setw(44) << name << right << fixed
+         << setw(12) << setprecision(1) << nanoseconds / iterations << " ns/op"
+         << setw(10) << setprecision(2) << static_cast<double>(allocations) / iterations << " allocs/op"
+         << setw(10) << setprecision(0) << static_cast<double>(bytes) / iterations << " B/op" << endl;
+}
+
+static SubmissionInfo createSubmissionInfo(int index)
+{
+    SubmissionInfo info("Sigur Rós", "Hoppípolla " + to_string(index), 1234567890 + index * 240);
+    info.setAlbum("Takk...");
+    info.setTrackLength(268);
+    info.setTrackNr(2);
+    info.setMusicBrainzId("6ad9bcc3-5a8a-4f5d-9d1b-2c2f8e2b2a41");
+    return info;
+}
+
+static SubmissionInfoCollection createCollection(int size)
+{
+    SubmissionInfoCollection collection;
+    for (int i = 0; i < size; ++i) {
+        collection.addInfo(createSubmissionInfo(i), 1234567890);
+    }
+    return collection;
+}
+
+int main(int argc, char** argv)
+{
+    if (!setlocale(LC_CTYPE, "")) {
+        cerr << "Locale not specified. Check LANG, LC_CTYPE, LC_ALL" << endl;
+        return 1;
+    }
+
+    string filter = argc > 1 ? argv[1] : "";
+    milliseconds minTime(argc > 2 ? stoi(argv[2]) : 500);
+
+    const string text = "Godspeed You! Black Emperor - Storm & Static (Live) / 100% Mädchen";
+    const wstring wideText = L"Sigur Rós - Hoppípolla, Með blóðnasir (Ágætis byrjun) 2005";
+    const string response = "OK\n3f8c1a2b4d5e6f708192a3b4c5d6e7f8\nhttp://post.audioscrobbler.com:80/np_1.2\nhttp://post2.audioscrobbler.com:80/protocol_1.2\n";
+
+    run(filter, minTime, "StringOperations::urlEncode", [&] {
+        doNotOptimize(StringOperations::urlEncode(text));
+    });
+    run(filter, minTime, "StringOperations::tokenize", [&] {
+        doNotOptimize(StringOperations::tokenize(response, "\n"));
+    });
+    run(filter, minTime, "StringOperations::wideCharToUtf8", [&] {
+        string utf8;
+        StringOperations::wideCharToUtf8(wideText, utf8);
+        doNotOptimize(utf8);
+    });
+
+    NowPlayingInfo nowPlayingInfo("Sigur Rós", "Hoppípolla");
+    nowPlayingInfo.setAlbum("Takk...");
+    nowPlayingInfo.setTrackLength(268);
+    nowPlayingInfo.setTrackNr(2);
+    run(filter, minTime, "NowPlayingInfo::getPostData", [&] {
+        doNotOptimize(nowPlayingInfo.getPostData());
+    });
+
+    SubmissionInfo submissionInfo = createSubmissionInfo(0);
+    run(filter, minTime, "SubmissionInfo::getPostData", [&] {
+        doNotOptimize(submissionInfo.getPostData());
+    });
+
+    for (int size : { 1, 10, 50 }) {
+        const SubmissionInfoCollection collection = createCollection(size);
+        run(filter, minTime, "SubmissionInfoCollection::getPostData/" + to_string(size), [&] {
+            // a copy, so the post data is not taken from the cache
+            SubmissionInfoCollection uncached = collection;
+            doNotOptimize(uncached.getPostData());
+        });
+        run(filter, minTime, "SubmissionInfoCollection::copy/" + to_string(size), [&] {
+            SubmissionInfoCollection copy = collection;
+            doNotOptimize(copy);
+        });
+    }
+
+    run(filter, minTime, "LastFmClient::generatePasswordHash", [&] {
+        doNotOptimize(LastFmClient::generatePasswordHash("correct horse battery staple"));
+    });
+
+    // the handshake token is the md5 hash of the password hash followed by the timestamp
+    const string passwordHash = LastFmClient::generatePasswordHash("correct horse battery staple");
+    run(filter, minTime, "LastFmClient auth token", [&] {
+        doNotOptimize(LastFmClient::generatePasswordHash(passwordHash + to_string(time(nullptr))));
+    });
+
+    return 0;
+}
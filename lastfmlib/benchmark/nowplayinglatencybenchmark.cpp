@@ -0,0 +1,81 @@
+#include "lastfmlib/lastfmscrobbler.h"
+#include "lastfmlib/unittest/scrobbleserverstub.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Measures the latency of now playing updates while a backlog is drained
+// usage: nowplayinglatencybenchmark [tracks] [latency in ms] [updates] [directory]
+
+int main(int argc, char** argv)
+{
+    int tracks = argc > 1 ? stoi(argv[1]) : 10000;
+    auto latency = milliseconds(argc > 2 ? stoi(argv[2]) : 5);
+    int updates = argc > 3 ? stoi(argv[3]) : 20;
+    string path = string(argc > 4 ? argv[4] : "/tmp") + "/nowplayinglatencybenchmark.spool";
+
+    std::remove(path.c_str());
+    {
+        SubmissionSpool spool(path, static_cast<uint64_t>(tracks));
+        SubmissionInfo info("Artist", "Track", time(nullptr));
+        info.setTrackLength(240);
+        for (int i = 0; i < tracks; ++i) {
+            spool.enqueue(info, time(nullptr));
+        }
+    }
+
+    ScrobbleServerStub server;
+    server.setLatency(latency);
+
+    LastFmScrobbler scrobbler("user", "pass", false, false);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setSubmissionSpool(path);
+    scrobbler.authenticate();
+    while (server.m_Handshakes == 0) {
+        this_thread::sleep_for(1ms);
+    }
+    this_thread::sleep_for(latency + 50ms);
+
+    auto drainStart = steady_clock::now();
+    scrobbler.flush();
+
+    vector<double> latencies;
+    for (int i = 0; i < updates && server.m_SubmittedTracks < tracks; ++i) {
+        uint64_t sent = scrobbler.getStatistics().nowPlayingSent;
+
+        auto start = steady_clock::now();
+        scrobbler.startedPlaying(SubmissionInfo("Artist", "Track " + to_string(i)));
+        while (scrobbler.getStatistics().nowPlayingSent == sent) {
+            this_thread::sleep_for(100us);
+        }
+        latencies.push_back(duration<double, milli>(steady_clock::now() - start).count());
+
+        this_thread::sleep_for(50ms);
+    }
+
+    while (server.m_SubmittedTracks < tracks) {
+        this_thread::sleep_for(1ms);
+    }
+    double drainSeconds = duration<double>(steady_clock::now() - drainStart).count();
+
+    sort(latencies.begin(), latencies.end());
+    cout << tracks << " track backlog drained in " << drainSeconds << " s with " << latency.count() << " ms server latency" << endl;
+    if (!latencies.empty()) {
+        cout << latencies.size() << " now playing updates during the drain: "
+             << "min " << latencies.front() << " ms, "
+             << "median " << latencies[latencies.size() / 2] << " ms, "
+             << "max " << latencies.back() << " ms" << endl;
+    }
+
+    scrobbler.shutdown(1s);
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "lastfmlib/lastfmscrobbler.h"
+#include "lastfmlib/unittest/scrobbleserverstub.h"
+#include "lastfmlib/utils/log.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+// Measures the cost of the logging on the scrobbler hot paths with every level enabled and with logging disabled
+// usage: scrobblerloggingbenchmark [iterations]
+
+static atomic<uint64_t> g_Allocations { 0 };
+
+void* operator new(size_t size)
+{
+    g_Allocations.fetch_add(1, memory_order_relaxed);
+    if (void* pData = malloc(size)) {
+        return pData;
+    }
+
+    throw bad_alloc();
+}
+
+void operator delete(void* pData) noexcept
+{
+    free(pData);
+}
+
+void operator delete(void* pData, size_t) noexcept
+{
+    free(pData);
+}
+
+static void run(const string& name, int iterations, const function<void(int)>& operation)
+{
+    uint64_t allocations = g_Allocations.load();
+    auto start = steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        operation(i);
+    }
+    double elapsed = duration<double, nano>(steady_clock::now() - start).count();
+    Log::flush();
+    allocations = g_Allocations.load() - allocations;
+
+    cout << left << setw(56) << name
+         << right << setw(10) << fixed << setprecision(1) << elapsed / iterations << " ns/op"
+         << setw(10) << setprecision(2) << static_cast<double>(allocations) / iterations << " allocs/op" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? stoi(argv[1]) : 100000;
+
+    ScrobbleServerStub server;
+
+    // commit only: tracks are too short to be submitted, so the hot paths never reach the server
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setCommitOnlyMode(true);
+    scrobbler.authenticate();
+
+    const SubmissionInfo track("Godspeed You! Black Emperor", "Storm", time(nullptr));
+
+    for (auto level : { Log::Level::Debug, Log::Level::Critical }) {
+        Log::setLevel(level);
+        string suffix = level == Log::Level::Debug ? " (logging enabled)" : " (logging disabled)";
+
+        run("Log::info" + suffix, iterations, [&](int i) {
+            Log::info("Track", track.getArtist(), "-", track.getTrack(), "played", i, "seconds");
+        });
+        run("LastFmScrobbler::startedPlaying" + suffix, iterations, [&](int) {
+            scrobbler.startedPlaying(track);
+        });
+        run("LastFmScrobbler::pausePlaying" + suffix, iterations, [&](int i) {
+            scrobbler.pausePlaying(i % 2 == 0);
+        });
+        run("LastFmScrobbler::finishedPlaying" + suffix, iterations, [&](int) {
+            scrobbler.finishedPlaying();
+        });
+    }
+
+    Log::setLevel(Log::Level::Debug);
+    cout << Log::getDroppedCount() << " log messages dropped, " << server.m_SubmittedTracks << " tracks submitted" << endl;
+
+    scrobbler.shutdown(1s);
+    return 0;
+}
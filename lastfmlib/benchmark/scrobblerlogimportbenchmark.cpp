@@ -0,0 +1,50 @@
+#include "lastfmlib/scrobblerlogimporter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+// Measures the import throughput of a large synthetic .scrobbler.log for different thread counts
+// usage: scrobblerlogimportbenchmark [lines] [directory]
+
+static void writeLog(const string& path, int lines)
+{
+    ofstream file(path, ios::binary);
+    file << "#AUDIOSCROBBLER/1.1\n#TZ/UTC\n#CLIENT/Rockbox sansae200 $Revision$\n";
+    for (int i = 0; i < lines; ++i) {
+        file << "Artist " << i % 1000 << "\tAlbum " << i % 100 << "\tTrack title " << i << "\t" << i % 12 + 1
+             << "\t" << 120 + i % 300 << "\t" << (i % 10 == 0 ? 'S' : 'L') << "\t" << 1200000000 + i * 240
+             << "\t5ce8b8c6-6bd2-4d2e-9e92-6b1d1e7f2a4c\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int lines = argc > 1 ? stoi(argv[1]) : 2000000;
+    string path = string(argc > 2 ? argv[2] : "/tmp") + "/scrobblerlogimportbenchmark.log";
+
+    writeLog(path, lines);
+    cout << lines << " lines in " << path << endl;
+
+    unsigned maxThreads = max(1u, thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        uint64_t pages = 0;
+        auto start = steady_clock::now();
+        ScrobblerLogImporter importer(path, threads);
+        auto statistics = importer.import([&pages](const SubmissionInfoCollection&, const vector<string>&) { ++pages; });
+        double seconds = duration<double>(steady_clock::now() - start).count();
+
+        cout << setw(3) << threads << " threads" << setw(12) << fixed << setprecision(0) << statistics.lines / seconds
+             << " lines/s" << setw(10) << pages << " pages" << endl;
+    }
+
+    std::remove(path.c_str());
+    return 0;
+}
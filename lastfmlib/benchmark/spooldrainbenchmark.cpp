@@ -0,0 +1,59 @@
+#include "lastfmlib/lastfmscrobbler.h"
+#include "lastfmlib/unittest/scrobbleserverstub.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+// Measures how fast a spooled backlog is drained against the stand-in server
+// usage: spooldrainbenchmark [tracks] [latency in ms] [directory]
+
+int main(int argc, char** argv)
+{
+    int tracks = argc > 1 ? stoi(argv[1]) : 100000;
+    auto latency = milliseconds(argc > 2 ? stoi(argv[2]) : 5);
+    string path = string(argc > 3 ? argv[3] : "/tmp") + "/spooldrainbenchmark.spool";
+
+    ScrobbleServerStub server;
+    server.setLatency(latency);
+
+    SubmissionInfo info("Artist", "Track", time(nullptr));
+    info.setAlbum("Album");
+    info.setTrackLength(240);
+
+    cout << tracks << " tracks, " << latency.count() << " ms server latency" << endl;
+    for (size_t depth : { 1, 2, 4, 8 }) {
+        std::remove(path.c_str());
+        {
+            SubmissionSpool spool(path, static_cast<uint64_t>(tracks));
+            for (int i = 0; i < tracks; ++i) {
+                spool.enqueue(info, time(nullptr));
+            }
+        }
+
+        int requestsBefore = server.m_SubmissionRequests;
+
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setSubmissionSpool(path);
+        scrobbler.setSubmissionPipelineDepth(depth);
+        scrobbler.authenticate();
+
+        auto start = steady_clock::now();
+        scrobbler.flush();
+        double seconds = duration<double>(steady_clock::now() - start).count();
+
+        cout << "pipeline depth " << setw(2) << depth
+             << setw(12) << fixed << setprecision(0) << scrobbler.getStatistics().tracksSubmitted / seconds << " tracks/s"
+             << setw(8) << server.m_SubmissionRequests - requestsBefore << " requests"
+             << setw(10) << setprecision(2) << seconds << " s" << endl;
+    }
+
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "lastfmlib/submissionlog.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Measures the append throughput of the submission log for different sync policies
+// usage: submissionlogbenchmark [appends] [directory]
+
+static double measure(const string& path, SubmissionLogSyncPolicy policy, int appends, int threadCount)
+{
+    std::remove(path.c_str());
+
+    SubmissionInfo info("Artist", "Track", time(nullptr));
+    info.setAlbum("Album");
+    info.setTrackLength(240);
+
+    auto start = steady_clock::now();
+    {
+        SubmissionLog log(path, policy);
+        vector<thread> threads;
+        for (int i = 0; i < threadCount; ++i) {
+            threads.emplace_back([&] {
+                for (int j = 0; j < appends / threadCount; ++j) {
+                    log.append(info, time(nullptr));
+                }
+            });
+        }
+
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    std::remove(path.c_str());
+    return appends / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    int appends = argc > 1 ? stoi(argv[1]) : 2000;
+    string path = string(argc > 2 ? argv[2] : "/tmp") + "/submissionlogbenchmark.log";
+
+    struct Scenario {
+        const char* name;
+        SubmissionLogSyncPolicy policy;
+        int threads;
+    };
+
+    const Scenario scenarios[] = {
+        { "sync every append", { 1, 0ms }, 1 },
+        { "sync every append, 8 threads", { 1, 0ms }, 8 },
+        { "sync every 16 appends", { 16, 0ms }, 1 },
+        { "sync every 256 appends", { 256, 0ms }, 1 },
+        { "sync every 100 ms", { 0, 100ms }, 1 },
+        { "no sync", { 0, 0ms }, 1 },
+    };
+
+    cout << appends << " appends to " << path << endl;
+    for (const auto& scenario : scenarios) {
+        double rate = measure(path, scenario.policy, appends, scenario.threads);
+        cout << left << setw(32) << scenario.name << right << setw(12) << fixed << setprecision(0) << rate << " appends/s" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "circuitbreaker.h"
+
+#include "utils/log.h"
+
+using namespace std;
+using namespace std::chrono;
+
+CircuitBreaker::CircuitBreaker(CircuitBreakerPolicy policy)
+: m_Policy(policy)
+{
+}
+
+void CircuitBreaker::setPolicy(CircuitBreakerPolicy policy)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    m_Policy = policy;
+    m_State = State::Closed;
+    m_ConsecutiveFailures = 0;
+}
+
+bool CircuitBreaker::allowRequest()
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    switch (m_State) {
+    case State::Closed:
+        return true;
+    case State::Open:
+        if (steady_clock::now() >= m_OpenedUntil) {
+            // the caller that finds the circuit expired performs the probe
+            m_State = State::HalfOpen;
+            return true;
+        }
+        break;
+    case State::HalfOpen:
+        break;
+    }
+
+    ++m_RejectedCount;
+    return false;
+}
+
+void CircuitBreaker::recordSuccess()
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    if (m_State != State::Closed) {
+        Log::info("Connection restored: circuit closed");
+    }
+    m_State = State::Closed;
+    m_ConsecutiveFailures = 0;
+}
+
+void CircuitBreaker::recordFailure()
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    if (m_Policy.failureThreshold == 0) {
+        return;
+    }
+
+    ++m_ConsecutiveFailures;
+    if (m_State == State::HalfOpen || m_ConsecutiveFailures >= m_Policy.failureThreshold) {
+        open(steady_clock::now());
+    }
+}
+
+CircuitBreaker::State CircuitBreaker::getState() const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    return m_State;
+}
+
+uint64_t CircuitBreaker::getRejectedCount() const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    return m_RejectedCount;
+}
+
+void CircuitBreaker::open(steady_clock::time_point now)
+{
+    if (m_State != State::Open) {
+        Log::info("Connection failed", m_ConsecutiveFailures, "times: circuit opened for", duration_cast<seconds>(m_Policy.openDuration).count(), "seconds");
+    }
+    m_State = State::Open;
+    m_OpenedUntil = now + m_Policy.openDuration;
+}
@@ -0,0 +1,91 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file circuitbreaker.h
+ * @brief Contains the CircuitBreaker class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+/** The CircuitBreakerPolicy struct determines when a circuit breaker opens
+ * and how long it stays open
+ */
+struct CircuitBreakerPolicy {
+    unsigned int failureThreshold { 5 }; /**< \brief consecutive connection failures that open the circuit (0 disables the breaker) */
+    std::chrono::milliseconds openDuration { std::chrono::seconds(30) }; /**< \brief time the circuit stays open before a probe request is allowed */
+};
+
+/** The CircuitBreaker class stops requests to an endpoint that is
+ * unreachable. After a number of consecutive connection failures the
+ * circuit opens and requests fail immediately instead of waiting for a
+ * connect timeout. When the open duration has passed a single probe
+ * request is allowed (half-open), the circuit closes again if it succeeds
+ * and opens for another period if it fails.
+ */
+class CircuitBreaker {
+public:
+    /** The state of the circuit */
+    enum class State {
+        Closed, /**< \brief requests are allowed */
+        Open, /**< \brief requests fail immediately */
+        HalfOpen /**< \brief a probe request is in progress */
+    };
+
+    /** Constructor
+     * \param policy determines when the circuit opens
+     */
+    explicit CircuitBreaker(CircuitBreakerPolicy policy = {});
+
+    /** Change the policy, the circuit is closed again
+     * \param policy determines when the circuit opens
+     */
+    void setPolicy(CircuitBreakerPolicy policy);
+
+    /** Check if a request may be performed, every allowed request must be
+     * followed by a call to recordSuccess or recordFailure
+     * \return false if the request should fail immediately
+     */
+    bool allowRequest();
+
+    /** \brief indicate that the endpoint could be reached */
+    void recordSuccess();
+    /** \brief indicate that the endpoint could not be reached */
+    void recordFailure();
+
+    /** \brief returns the current state of the circuit */
+    [[nodiscard]] State getState() const;
+    /** \brief returns the number of requests that were rejected because the circuit was open */
+    [[nodiscard]] uint64_t getRejectedCount() const;
+
+private:
+    void open(std::chrono::steady_clock::time_point now);
+
+    CircuitBreakerPolicy m_Policy;
+    State m_State { State::Closed };
+    unsigned int m_ConsecutiveFailures {};
+    uint64_t m_RejectedCount {};
+    std::chrono::steady_clock::time_point m_OpenedUntil;
+    mutable std::mutex m_Mutex;
+};
+
+#endif
@@ -0,0 +1,161 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "flightrecorder.h"
+
+#include <algorithm>
+#include <array>
+#include <ctime>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#include "utils/log.h"
+
+using namespace std;
+using namespace std::chrono;
+
+static const unsigned int BAD_SESSIONS_BEFORE_DUMP = 2;
+static const seconds MIN_TIME_BETWEEN_AUTOMATIC_DUMPS(60);
+
+static const std::array<const char*, 6> EVENT_NAMES = { "handshake", "nowplaying", "submission", "buffered", "dropped", "rejected" };
+static const std::array<const char*, 5> STATUS_NAMES = { "OK", "BADSESSION", "FAILED", "ConnectionError", "CircuitOpen" };
+static const std::array<const char*, 3> REASON_NAMES = { "requested", "repeated BADSESSION", "hard failure" };
+
+template <typename T>
+static T saturate(uint64_t value)
+{
+    return static_cast<T>(min<uint64_t>(value, numeric_limits<T>::max()));
+}
+
+FlightRecorder::FlightRecorder(size_t capacity)
+: m_Records(capacity)
+{
+    if (capacity == 0) {
+        throw logic_error("FlightRecorder: capacity must not be 0");
+    }
+}
+
+void FlightRecorder::record(FlightEvent event, FlightStatus status, microseconds latency, size_t tracks)
+{
+    FlightRecord record;
+    record.timestamp = duration_cast<microseconds>(system_clock::now().time_since_epoch() - latency).count();
+    record.latency = saturate<uint32_t>(static_cast<uint64_t>(max<int64_t>(0, latency.count())));
+    record.queueDepth = m_QueueDepth.load(memory_order_relaxed);
+    record.tracks = saturate<uint16_t>(tracks);
+    record.event = event;
+    record.status = status;
+
+    optional<FlightDumpReason> dumpReason;
+    {
+        auto lock = std::scoped_lock(m_Mutex);
+        m_Records[m_Next] = record;
+        m_Next = (m_Next + 1) % m_Records.size();
+        m_Count = min(m_Count + 1, m_Records.size());
+
+        if (status == FlightStatus::BadSession) {
+            if (++m_ConsecutiveBadSessions == BAD_SESSIONS_BEFORE_DUMP) {
+                dumpReason = FlightDumpReason::RepeatedBadSession;
+            }
+        } else if (status == FlightStatus::Ok && (event == FlightEvent::NowPlaying || event == FlightEvent::Submission)) {
+            // a successful handshake does not count, its session can be rejected as well
+            m_ConsecutiveBadSessions = 0;
+        }
+
+        // a handshake that can't reach the server is the hard connection failure of the scrobbler
+        if (status == FlightStatus::Failed || (event == FlightEvent::Handshake && status == FlightStatus::ConnectionError)) {
+            dumpReason = FlightDumpReason::HardFailure;
+        }
+
+        if (dumpReason) {
+            auto now = steady_clock::now();
+            if (m_AutomaticDumpDone && now - m_LastAutomaticDump < MIN_TIME_BETWEEN_AUTOMATIC_DUMPS) {
+                dumpReason.reset();
+            } else {
+                m_AutomaticDumpDone = true;
+                m_LastAutomaticDump = now;
+            }
+        }
+    }
+
+    if (dumpReason) {
+        dump(*dumpReason);
+    }
+}
+
+void FlightRecorder::setQueueDepth(size_t depth)
+{
+    m_QueueDepth.store(saturate<uint32_t>(depth), memory_order_relaxed);
+}
+
+vector<FlightRecord> FlightRecorder::getRecords() const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+
+    vector<FlightRecord> records;
+    records.reserve(m_Count);
+    size_t first = (m_Next + m_Records.size() - m_Count) % m_Records.size();
+    for (size_t i = 0; i < m_Count; ++i) {
+        records.push_back(m_Records[(first + i) % m_Records.size()]);
+    }
+
+    return records;
+}
+
+void FlightRecorder::dump(FlightDumpReason reason) const
+{
+    DumpHandler handler;
+    {
+        auto lock = std::scoped_lock(m_Mutex);
+        handler = m_DumpHandler;
+    }
+
+    vector<FlightRecord> records = getRecords();
+    if (handler) {
+        handler(reason, records);
+        return;
+    }
+
+    Log::warn("Flight recorder dump:", records.size(), "events, reason:", REASON_NAMES[static_cast<size_t>(reason)]);
+    for (auto& record : records) {
+        Log::warn(toString(record));
+    }
+}
+
+void FlightRecorder::setDumpHandler(DumpHandler handler)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    m_DumpHandler = std::move(handler);
+}
+
+string FlightRecorder::toString(const FlightRecord& record)
+{
+    time_t seconds = record.timestamp / 1000000;
+    tm time {};
+    gmtime_r(&seconds, &time);
+
+    stringstream ss;
+    ss << put_time(&time, "%Y-%m-%dT%H:%M:%S") << '.' << setw(6) << setfill('0') << record.timestamp % 1000000 << 'Z' << setfill(' ')
+       << ' ' << EVENT_NAMES[static_cast<size_t>(record.event)]
+       << ' ' << STATUS_NAMES[static_cast<size_t>(record.status)]
+       << " latency " << fixed << setprecision(1) << record.latency / 1000.0 << " ms"
+       << " tracks " << record.tracks
+       << " queue " << record.queueDepth;
+
+    return ss.str();
+}
@@ -0,0 +1,136 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file flightrecorder.h
+ * @brief Contains the FlightRecorder class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** The kind of event in the flight recorder */
+enum class FlightEvent : uint8_t {
+    Handshake, /**< \brief a handshake request */
+    NowPlaying, /**< \brief a Now Playing request */
+    Submission, /**< \brief a submission request */
+    TrackBuffered, /**< \brief a finished track was buffered for submission */
+    TrackDropped, /**< \brief a finished track was dropped because the buffer was full */
+    TrackRejected /**< \brief a track can't be submitted and was moved to the dead-letter list */
+};
+
+/** The result of an event in the flight recorder */
+enum class FlightStatus : uint8_t {
+    Ok, /**< \brief the request succeeded */
+    BadSession, /**< \brief the server answered BADSESSION */
+    Failed, /**< \brief the server answered with an error or the track was lost */
+    ConnectionError, /**< \brief the server could not be reached */
+    CircuitOpen /**< \brief the request was not sent because the circuit breaker was open */
+};
+
+/** The reason of a flight recorder dump */
+enum class FlightDumpReason {
+    Requested, /**< \brief the dump was requested by the application */
+    RepeatedBadSession, /**< \brief the server rejected consecutive sessions */
+    HardFailure /**< \brief a request failed hard or a track was lost */
+};
+
+/** A compact record of a single event, 24 bytes */
+struct FlightRecord {
+    int64_t timestamp {}; /**< \brief start of the event in microseconds since the epoch */
+    uint32_t latency {}; /**< \brief duration of the request in microseconds */
+    uint32_t queueDepth {}; /**< \brief tracks waiting to be submitted at the end of the event */
+    uint16_t tracks {}; /**< \brief tracks in the request */
+    FlightEvent event {}; /**< \brief the kind of event */
+    FlightStatus status {}; /**< \brief the result of the event */
+};
+
+/** The FlightRecorder class keeps the most recent protocol events of a
+ * session in a fixed-size ring buffer. Recording an event only copies a
+ * FlightRecord, so the recorder can stay enabled at all times. The
+ * contents are dumped on request and automatically when the server
+ * rejects consecutive sessions or a request fails hard, automatic dumps
+ * happen at most once per minute.
+ */
+class FlightRecorder {
+public:
+    /** Callback that receives the records of a dump, oldest first */
+    using DumpHandler = std::function<void(FlightDumpReason reason, const std::vector<FlightRecord>& records)>;
+
+    /** \brief the number of records kept by default */
+    static const size_t DEFAULT_CAPACITY = 256;
+
+    /** Constructor
+     * \param capacity the number of records that are kept
+     */
+    explicit FlightRecorder(size_t capacity = DEFAULT_CAPACITY);
+
+    /** Record an event, the oldest record is overwritten when the recorder is full
+     * \param event the kind of event
+     * \param status the result of the event
+     * \param latency the duration of the request
+     * \param tracks the number of tracks in the request
+     */
+    void record(FlightEvent event, FlightStatus status, std::chrono::microseconds latency = {}, size_t tracks = 0);
+
+    /** Set the number of tracks waiting to be submitted, it is stored in the following records
+     * \param depth the number of tracks
+     */
+    void setQueueDepth(size_t depth);
+
+    /** \brief returns the records, oldest first */
+    [[nodiscard]] std::vector<FlightRecord> getRecords() const;
+
+    /** Pass the records to the dump handler, by default they are written
+     * to the log as warnings
+     * \param reason the reason of the dump
+     */
+    void dump(FlightDumpReason reason = FlightDumpReason::Requested) const;
+
+    /** Set the function that receives the dumps, it is called on the
+     * thread that recorded the event that triggered the dump
+     * \param handler the function to call, an empty function writes the dumps to the log
+     */
+    void setDumpHandler(DumpHandler handler);
+
+    /** Format a record as a single line of text
+     * \param record the record to format
+     * \return the formatted record
+     */
+    static std::string toString(const FlightRecord& record);
+
+private:
+    std::vector<FlightRecord> m_Records;
+    size_t m_Next {};
+    size_t m_Count {};
+    std::atomic<uint32_t> m_QueueDepth {};
+    unsigned int m_ConsecutiveBadSessions {};
+    std::chrono::steady_clock::time_point m_LastAutomaticDump;
+    bool m_AutomaticDumpDone {};
+    DumpHandler m_DumpHandler;
+    mutable std::mutex m_Mutex;
+};
+
+#endif
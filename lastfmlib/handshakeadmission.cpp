@@ -0,0 +1,119 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "handshakeadmission.h"
+
+#include <algorithm>
+
+#include "lastfmexceptions.h"
+
+using namespace std;
+
+HandshakeAdmission::Ticket::Ticket(HandshakeAdmission& admission, const std::function<bool()>& isCancelled)
+: m_Admission(admission)
+{
+    if (!m_Admission.acquire(isCancelled)) {
+        throw ConnectionError("Handshake cancelled while waiting for admission");
+    }
+}
+
+HandshakeAdmission::Ticket::~Ticket()
+{
+    m_Admission.release();
+}
+
+HandshakeAdmission::HandshakeAdmission(unsigned int maxConcurrent, double handshakesPerSecond, double burst)
+: m_MaxConcurrent(max(maxConcurrent, 1u))
+, m_Rate(handshakesPerSecond, burst)
+{
+}
+
+HandshakeAdmission& HandshakeAdmission::instance()
+{
+    static HandshakeAdmission admission;
+    return admission;
+}
+
+void HandshakeAdmission::configure(unsigned int maxConcurrent, double handshakesPerSecond, double burst)
+{
+    {
+        auto lock = std::scoped_lock(m_Mutex);
+        m_MaxConcurrent = max(maxConcurrent, 1u);
+    }
+    m_Rate.setRate(handshakesPerSecond, burst);
+    m_Condition.notify_all();
+}
+
+bool HandshakeAdmission::acquire(const std::function<bool()>& isCancelled)
+{
+    bool cancelled = false;
+    auto checkCancelled = [&isCancelled, &cancelled] {
+        cancelled = isCancelled && isCancelled();
+        return cancelled;
+    };
+
+    {
+        auto lock = std::unique_lock(m_Mutex);
+        uint64_t ticket = m_NextTicket++;
+        m_Waiting.push_back(ticket);
+
+        m_Condition.wait(lock, [&] { return checkCancelled() || m_Waiting.front() == ticket; });
+        if (!cancelled) {
+            // reserved at the head of the queue so the tokens are handed out in ticket order,
+            // the concurrent slot is only taken once the token can be used
+            auto tokenTime = std::chrono::steady_clock::now() + m_Rate.reserve();
+            if (m_Condition.wait_until(lock, tokenTime, checkCancelled)) {
+                // the next session does not have to wait for the unused token
+                m_Rate.cancel();
+            }
+        }
+        if (!cancelled) {
+            m_Condition.wait(lock, [&] { return checkCancelled() || m_Active < m_MaxConcurrent; });
+        }
+
+        m_Waiting.erase(find(m_Waiting.begin(), m_Waiting.end(), ticket));
+        if (!cancelled) {
+            ++m_Active;
+        }
+    }
+    m_Condition.notify_all();
+
+    return !cancelled;
+}
+
+void HandshakeAdmission::release()
+{
+    {
+        auto lock = std::scoped_lock(m_Mutex);
+        --m_Active;
+    }
+    m_Condition.notify_all();
+}
+
+void HandshakeAdmission::interrupt()
+{
+    {
+        // taken so a waiter can't miss the wakeup between checking and waiting
+        auto lock = std::scoped_lock(m_Mutex);
+    }
+    m_Condition.notify_all();
+}
+
+uint64_t HandshakeAdmission::getQueueLength() const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    return m_Waiting.size();
+}
@@ -0,0 +1,106 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file handshakeadmission.h
+ * @brief Contains the HandshakeAdmission class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef HANDSHAKE_ADMISSION_H
+#define HANDSHAKE_ADMISSION_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "tokenbucket.h"
+
+/** The HandshakeAdmission class limits the handshakes that are performed
+ * by all the scrobblers in the process. At most a fixed number of
+ * handshakes run concurrently and they are started at a limited rate.
+ * Sessions that have to wait are admitted in the order they arrived, so
+ * after an outage the sessions reconnect gradually instead of all at once.
+ */
+class HandshakeAdmission {
+public:
+    /** \brief Default number of concurrent handshakes */
+    static constexpr unsigned int DEFAULT_MAX_CONCURRENT = 4;
+    /** \brief Default number of handshakes per second */
+    static constexpr double DEFAULT_RATE = 5.0;
+    /** \brief Default number of handshakes that can be started at once */
+    static constexpr double DEFAULT_BURST = 10.0;
+
+    /** The Ticket class admits a handshake for as long as it exists */
+    class Ticket {
+    public:
+        /** Constructor, waits until the handshake is admitted
+         * \param admission the admission control to use
+         * \param isCancelled stops the wait when it returns true, see acquire()
+         * \exception ConnectionError when the wait was cancelled
+         */
+        explicit Ticket(HandshakeAdmission& admission, const std::function<bool()>& isCancelled = {});
+        ~Ticket();
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+
+    private:
+        HandshakeAdmission& m_Admission;
+    };
+
+    HandshakeAdmission(unsigned int maxConcurrent = DEFAULT_MAX_CONCURRENT, double handshakesPerSecond = DEFAULT_RATE, double burst = DEFAULT_BURST);
+
+    /** \brief returns the admission control shared by all scrobblers */
+    static HandshakeAdmission& instance();
+
+    /** Change the limits
+     * \param maxConcurrent the maximum number of concurrent handshakes
+     * \param handshakesPerSecond the sustained handshake rate, 0 disables the rate limit
+     * \param burst the number of handshakes that can be started at once
+     */
+    void configure(unsigned int maxConcurrent, double handshakesPerSecond, double burst);
+
+    /** Wait until a handshake can be started, every admitted call must be
+     * followed by a call to release (use the Ticket class). The wait for
+     * the rate limit happens before a concurrent slot is taken, so waiting
+     * sessions never block the sessions that are admitted.
+     * \param isCancelled is checked when the wait starts and on every
+     * call to interrupt(), the wait stops when it returns true
+     * \return false if the wait was cancelled, the handshake is not admitted then
+     */
+    bool acquire(const std::function<bool()>& isCancelled = {});
+    /** \brief indicate that an admitted handshake has finished */
+    void release();
+
+    /** Wake up the waiting sessions so they check whether they were cancelled */
+    void interrupt();
+
+    /** \brief returns the number of handshakes waiting to be admitted */
+    [[nodiscard]] uint64_t getQueueLength() const;
+
+private:
+    unsigned int m_MaxConcurrent;
+    unsigned int m_Active {};
+    uint64_t m_NextTicket {};
+    std::deque<uint64_t> m_Waiting;
+    TokenBucket m_Rate;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+};
+
+#endif
@@ -16,19 +16,73 @@
 
 #include "lastfmclient.h"
 
+#include <algorithm>
+#include <array>
 #include <iomanip>
 
 #include "md5/md5.h"
 #include "utils/log.h"
 #include "utils/stringoperations.h"
 
+#include "metricsregistry.h"
 #include "nowplayinginfo.h"
 #include "submissioninfo.h"
 #include "submissioninfocollection.h"
+#include "tracepoints.h"
 
 using namespace std;
 using namespace StringOperations;
 
+namespace {
+// the outcomes are named after the status line of the response
+const std::array<const char*, 4> REQUEST_OUTCOMES = { "OK", "BADSESSION", "FAILED", "ConnectionError" };
+const size_t CONNECTION_ERROR_OUTCOME = 3;
+
+// the phases of a request, derived from the curl timing
+const std::array<const char*, 5> TRANSFER_PHASES = { "namelookup", "connect", "tls", "server", "transfer" };
+
+struct EndpointMetrics {
+    std::array<MetricsCounter*, REQUEST_OUTCOMES.size()> outcomes {};
+    LatencyHistogram* pLatency {};
+    std::array<LatencyHistogram*, TRANSFER_PHASES.size()> phases {};
+    MetricsCounter* pBytesSent {};
+    MetricsCounter* pBytesReceived {};
+};
+
+EndpointMetrics& getEndpointMetrics(LastFmClient::Endpoint endpoint)
+{
+    static std::array<EndpointMetrics, 3> metrics = [] {
+        MetricsRegistry& registry = MetricsRegistry::instance();
+        const std::array<const char*, 3> endpointNames = { "handshake", "nowplaying", "submission" };
+
+        std::array<EndpointMetrics, 3> result;
+        for (size_t i = 0; i < endpointNames.size(); ++i) {
+            for (size_t j = 0; j < REQUEST_OUTCOMES.size(); ++j) {
+                result[i].outcomes[j] = &registry.counter("lastfm_requests_total", "Requests to the Last.fm servers by outcome",
+                    { { "endpoint", endpointNames[i] }, { "outcome", REQUEST_OUTCOMES[j] } });
+            }
+            result[i].pLatency = &registry.histogram("lastfm_request_duration_seconds", "Duration of the requests to the Last.fm servers",
+                { { "endpoint", endpointNames[i] } });
+            for (size_t j = 0; j < TRANSFER_PHASES.size(); ++j) {
+                result[i].phases[j] = &registry.histogram("lastfm_request_phase_seconds", "Duration of the phases of the requests to the Last.fm servers",
+                    { { "endpoint", endpointNames[i] }, { "phase", TRANSFER_PHASES[j] } });
+            }
+            result[i].pBytesSent = &registry.counter("lastfm_sent_bytes_total", "Bytes sent to the Last.fm servers", { { "endpoint", endpointNames[i] } });
+            result[i].pBytesReceived = &registry.counter("lastfm_received_bytes_total", "Bytes received from the Last.fm servers", { { "endpoint", endpointNames[i] } });
+        }
+        return result;
+    }();
+
+    return metrics[static_cast<size_t>(endpoint)];
+}
+
+// the endpoints are the first events of the flight recorder, in the same order
+FlightEvent toFlightEvent(LastFmClient::Endpoint endpoint)
+{
+    return static_cast<FlightEvent>(endpoint);
+}
+} // namespace
+
 LastFmClient::LastFmClient(std::string clientIdentifier, std::string clientVersion)
 : m_ClientIdentifier(std::move(clientIdentifier))
 , m_ClientVersion(std::move(clientVersion))
@@ -42,13 +96,10 @@ void LastFmClient::handshake(const string& user, const string& pass)
     }
 
     string response;
-    try {
-        m_UrlClient.get(createRequestString(user, pass), response);
-    } catch (const logic_error& e) {
-        throw ConnectionError(e.what());
-    }
+    auto latency = performRequest(Endpoint::Handshake, 0, [&](TransferTiming* pTiming) { m_UrlClient.get(createRequestString(user, pass), response, pTiming); });
 
     vector<string> lines = tokenize(response, "\n");
+    recordOutcome(Endpoint::Handshake, lines.size() < 4 ? "FAILED" : lines[0], latency, 0);
     if (lines[0] != "OK") {
         throw logic_error("Failed to connect to last.fm: " + lines[0]);
     }
@@ -57,23 +108,18 @@ void LastFmClient::handshake(const string& user, const string& pass)
         throw logic_error("Failed to connect to last.fm: invalid response length");
     }
 
-    m_SessionId = lines[1];
-    m_NowPlayingUrl = lines[2];
-    m_SubmissionUrl = lines[3];
+    setSession(LastFmSession { lines[1], lines[2], lines[3] });
 }
 
 void LastFmClient::nowPlaying(const NowPlayingInfo& info)
 {
-    throwOnInvalidSession();
+    auto pSession = getValidSession();
 
     string response;
-    try {
-        UrlClient::post(m_NowPlayingUrl, createNowPlayingString(info), response);
-    } catch (const logic_error& e) {
-        throw ConnectionError(e.what());
-    }
+    auto latency = performRequest(Endpoint::NowPlaying, 1, [&](TransferTiming* pTiming) { m_UrlClient.post(pSession->nowPlayingUrl, createNowPlayingString(*pSession, info), response, pTiming); });
 
     vector<string> lines = tokenize(response, "\n");
+    recordOutcome(Endpoint::NowPlaying, lines[0], latency, 1);
 
     if (lines[0] == "BADSESSION") {
         throw BadSessionError("Session has become invalid");
@@ -85,27 +131,23 @@ void LastFmClient::nowPlaying(const NowPlayingInfo& info)
 
 void LastFmClient::submit(const SubmissionInfo& info)
 {
-    submit(createSubmissionString(info));
+    auto pSession = getValidSession();
+    submit(*pSession, createSubmissionString(*pSession, info), 1);
 }
 
 void LastFmClient::submit(const SubmissionInfoCollection& infoCollection)
 {
-    submit(createSubmissionString(infoCollection));
+    auto pSession = getValidSession();
+    submit(*pSession, createSubmissionString(*pSession, infoCollection), infoCollection.size());
 }
 
-void LastFmClient::submit(const string& postData) const
+void LastFmClient::submit(const LastFmSession& session, const string& postData, size_t tracks) const
 {
-    throwOnInvalidSession();
-
     string response;
-
-    try {
-        UrlClient::post(m_SubmissionUrl, postData, response);
-    } catch (const logic_error& e) {
-        throw ConnectionError(e.what());
-    }
+    auto latency = performRequest(Endpoint::Submission, tracks, [&](TransferTiming* pTiming) { m_UrlClient.post(session.submissionUrl, postData, response, pTiming); });
 
     vector<string> lines = tokenize(response, "\n");
+    recordOutcome(Endpoint::Submission, lines[0], latency, tracks);
 
     if (lines[0] == "BADSESSION") {
         throw BadSessionError("Session has become invalid");
@@ -150,12 +192,92 @@ void LastFmClient::setProxy(const std::string& server, uint32_t port, const std:
     m_UrlClient.setProxy(server, port, username, password);
 }
 
+void LastFmClient::setTimeout(std::chrono::milliseconds timeout)
+{
+    m_UrlClient.setTimeout(timeout);
+}
+
+void LastFmClient::abort()
+{
+    {
+        auto lock = std::scoped_lock(m_AbortMutex);
+        m_UrlClient.abort();
+    }
+    m_AbortCondition.notify_all();
+}
+
+bool LastFmClient::isAborted() const
+{
+    return m_UrlClient.isAborted();
+}
+
+void LastFmClient::setRateLimit(double requestsPerSecond, double burst)
+{
+    m_RateLimiter.configure(requestsPerSecond, burst);
+}
+
+RateLimiterStatistics LastFmClient::getRateLimiterStatistics() const
+{
+    return m_RateLimiter.getStatistics();
+}
+
+void LastFmClient::setCircuitBreakerPolicy(const CircuitBreakerPolicy& policy)
+{
+    m_HandshakeCircuit.setPolicy(policy);
+    m_NowPlayingCircuit.setPolicy(policy);
+    m_SubmissionCircuit.setPolicy(policy);
+}
+
+CircuitBreaker::State LastFmClient::getCircuitState(Endpoint endpoint) const
+{
+    return getCircuitBreaker(endpoint).getState();
+}
+
+uint64_t LastFmClient::getCircuitRejectedCount() const
+{
+    return m_HandshakeCircuit.getRejectedCount() + m_NowPlayingCircuit.getRejectedCount() + m_SubmissionCircuit.getRejectedCount();
+}
+
+void LastFmClient::setTransferObserver(TransferObserver observer)
+{
+    m_TransferObserver = std::move(observer);
+}
+
+void LastFmClient::setTransferMetricsEnabled(bool enabled)
+{
+    m_TransferMetricsEnabled = enabled;
+}
+
+FlightRecorder& LastFmClient::getFlightRecorder()
+{
+    return m_FlightRecorder;
+}
+
+void LastFmClient::setHandshakeUrl(const std::string& url)
+{
+    m_HandshakeUrl = url;
+}
+
+LastFmSession LastFmClient::getSession() const
+{
+    auto lock = std::scoped_lock(m_SessionMutex);
+    return *m_pSession;
+}
+
+void LastFmClient::setSession(const LastFmSession& session)
+{
+    auto pSession = std::make_shared<const LastFmSession>(session);
+
+    auto lock = std::scoped_lock(m_SessionMutex);
+    m_pSession = std::move(pSession);
+}
+
 string LastFmClient::createRequestString(const string& user, const string& pass) const
 {
     time_t timestamp = time(nullptr);
 
     stringstream request;
-    request << "http://post.audioscrobbler.com/?hs=true&p=1.2"
+    request << m_HandshakeUrl << "?hs=true&p=1.2"
             << "&c=" << m_ClientIdentifier
             << "&v=" << m_ClientVersion
             << "&u=" << user
@@ -165,24 +287,165 @@ string LastFmClient::createRequestString(const string& user, const string& pass)
     return request.str();
 }
 
-string LastFmClient::createNowPlayingString(const NowPlayingInfo& info) const
+string LastFmClient::createNowPlayingString(const LastFmSession& session, const NowPlayingInfo& info)
+{
+    return "&s=" + session.sessionId + info.getPostData();
+}
+
+string LastFmClient::createSubmissionString(const LastFmSession& session, const SubmissionInfo& info)
+{
+    return "&s=" + session.sessionId + info.getPostData();
+}
+
+string LastFmClient::createSubmissionString(const LastFmSession& session, const SubmissionInfoCollection& infoCollection)
 {
-    return "&s=" + m_SessionId + info.getPostData();
+    return "&s=" + session.sessionId + infoCollection.getPostData();
 }
 
-string LastFmClient::createSubmissionString(const SubmissionInfo& info) const
+template <typename Request>
+chrono::microseconds LastFmClient::performRequest(Endpoint endpoint, size_t tracks, Request request) const
 {
-    return "&s=" + m_SessionId + info.getPostData();
+    LASTFMLIB_TRACE(request__start, static_cast<int>(endpoint), tracks);
+
+    EndpointMetrics& metrics = getEndpointMetrics(endpoint);
+    CircuitBreaker& circuit = getCircuitBreaker(endpoint);
+    if (!circuit.allowRequest()) {
+        metrics.outcomes[CONNECTION_ERROR_OUTCOME]->increment();
+        recordRequest(endpoint, FlightStatus::CircuitOpen, {}, tracks);
+        throw ConnectionError("Failed to connect to last.fm: circuit is open");
+    }
+
+    auto start = chrono::steady_clock::now();
+    // curl is only asked for the timing when something uses it
+    TransferTiming timing;
+    TransferTiming* pTiming = m_TransferObserver || m_TransferMetricsEnabled ? &timing : nullptr;
+    try {
+        // handshakes are limited by the HandshakeAdmission instead
+        if (endpoint != Endpoint::Handshake) {
+            waitForRateLimit();
+            start = chrono::steady_clock::now();
+        }
+        request(pTiming);
+    } catch (const ConnectionError&) {
+        circuit.recordFailure();
+        metrics.outcomes[CONNECTION_ERROR_OUTCOME]->increment();
+        recordRequest(endpoint, FlightStatus::ConnectionError, chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start), tracks);
+        throw;
+    } catch (const logic_error& e) {
+        auto latency = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+        circuit.recordFailure();
+        metrics.outcomes[CONNECTION_ERROR_OUTCOME]->increment();
+        metrics.pLatency->record(latency);
+        if (pTiming) {
+            recordTransfer(endpoint, timing);
+        }
+        recordRequest(endpoint, FlightStatus::ConnectionError, latency, tracks);
+        throw ConnectionError(e.what());
+    }
+
+    auto latency = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    metrics.pLatency->record(latency);
+    if (pTiming) {
+        recordTransfer(endpoint, timing);
+    }
+    circuit.recordSuccess();
+    return latency;
 }
 
-string LastFmClient::createSubmissionString(const SubmissionInfoCollection& infoCollection) const
+void LastFmClient::recordOutcome(Endpoint endpoint, const string& status, chrono::microseconds latency, size_t tracks) const
 {
-    return "&s=" + m_SessionId + infoCollection.getPostData();
+    // every status other than OK and BADSESSION is a failure (BADAUTH, BADTIME, ...)
+    size_t outcome = status == "OK" ? 0 : status == "BADSESSION" ? 1 : 2;
+    getEndpointMetrics(endpoint).outcomes[outcome]->increment();
+
+    const std::array<FlightStatus, 3> flightStatus = { FlightStatus::Ok, FlightStatus::BadSession, FlightStatus::Failed };
+    recordRequest(endpoint, flightStatus[outcome], latency, tracks);
 }
 
-void LastFmClient::throwOnInvalidSession() const
+void LastFmClient::recordRequest(Endpoint endpoint, FlightStatus status, chrono::microseconds latency, size_t tracks) const
 {
-    if (m_SessionId.empty()) {
+    LASTFMLIB_TRACE(request__done, static_cast<int>(endpoint), static_cast<int>(status), static_cast<int64_t>(latency.count()), tracks);
+    m_FlightRecorder.record(toFlightEvent(endpoint), status, latency, tracks);
+}
+
+void LastFmClient::recordTransfer(Endpoint endpoint, const TransferTiming& timing) const
+{
+    // the timing stays empty when the request was aborted before curl started it
+    if (timing.total.count() == 0) {
+        return;
+    }
+
+    if (m_TransferMetricsEnabled) {
+        EndpointMetrics& metrics = getEndpointMetrics(endpoint);
+        metrics.pBytesSent->increment(timing.bytesSent);
+        metrics.pBytesReceived->increment(timing.bytesReceived);
+
+        // a phase that was not reached (e.g. no connection) has no end time
+        auto connected = max(timing.connect, timing.appConnect);
+        const std::array<pair<chrono::microseconds, chrono::microseconds>, TRANSFER_PHASES.size()> phases = { {
+            { chrono::microseconds(0), timing.nameLookup },
+            { timing.nameLookup, timing.connect },
+            { timing.connect, timing.appConnect },
+            { connected, timing.startTransfer },
+            { timing.startTransfer, timing.total },
+        } };
+        for (size_t i = 0; i < phases.size(); ++i) {
+            if (phases[i].second > phases[i].first) {
+                metrics.phases[i]->record(phases[i].second - phases[i].first);
+            }
+        }
+    }
+
+    if (m_TransferObserver) {
+        m_TransferObserver(endpoint, timing);
+    }
+}
+
+CircuitBreaker& LastFmClient::getCircuitBreaker(Endpoint endpoint) const
+{
+    switch (endpoint) {
+    case Endpoint::Handshake:
+        return m_HandshakeCircuit;
+    case Endpoint::NowPlaying:
+        return m_NowPlayingCircuit;
+    case Endpoint::Submission:
+        return m_SubmissionCircuit;
+    }
+
+    throw logic_error("Invalid endpoint");
+}
+
+void LastFmClient::waitForRateLimit() const
+{
+    // the session limit is waited for first, so a session that exceeds its
+    // own limit does not hold back the other sessions in the process
+    waitFor(m_RateLimiter.reserve());
+    waitFor(RequestRateLimiter::instance().reserve());
+}
+
+void LastFmClient::waitFor(std::chrono::steady_clock::duration wait) const
+{
+    if (wait <= std::chrono::steady_clock::duration::zero()) {
+        return;
+    }
+
+    auto lock = std::unique_lock(m_AbortMutex);
+    if (m_AbortCondition.wait_for(lock, wait, [this] { return m_UrlClient.isAborted(); })) {
+        throw ConnectionError("Request aborted while waiting for the rate limit");
+    }
+}
+
+std::shared_ptr<const LastFmSession> LastFmClient::getValidSession() const
+{
+    std::shared_ptr<const LastFmSession> pSession;
+    {
+        auto lock = std::scoped_lock(m_SessionMutex);
+        pSession = m_pSession;
+    }
+
+    if (pSession->sessionId.empty()) {
         throw logic_error("No last.fm session available");
     }
+
+    return pSession;
 }
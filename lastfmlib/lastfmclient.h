@@ -23,18 +23,45 @@
 #ifndef LAST_FM_CLIENT_H
 #define LAST_FM_CLIENT_H
 
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "circuitbreaker.h"
+#include "flightrecorder.h"
 #include "lastfmexceptions.h"
+#include "requestratelimiter.h"
 #include "urlclient.h"
 
 class NowPlayingInfo;
 class SubmissionInfo;
 class SubmissionInfoCollection;
 
+/** The LastFmSession struct contains the session information that is
+ * obtained by a handshake
+ */
+struct LastFmSession {
+    std::string sessionId; /**< \brief the session id */
+    std::string nowPlayingUrl; /**< \brief the url for Now Playing requests */
+    std::string submissionUrl; /**< \brief the url for submission requests */
+};
+
 /** The LastFmClient class provides access to Last.Fm to submit tracks
  *  and set Now Playing info.
  */
 class LastFmClient {
 public:
+    /** The Last.fm endpoints, every endpoint has its own circuit breaker */
+    enum class Endpoint {
+        Handshake, /**< \brief the handshake url */
+        NowPlaying, /**< \brief the Now Playing url of the session */
+        Submission /**< \brief the submission url of the session */
+    };
+
+    /** Callback that receives the timing of every request that was sent */
+    using TransferObserver = std::function<void(Endpoint endpoint, const TransferTiming& timing)>;
+
     /** Default constructor which will use the Last.fm client identifier
      * and version of lastfmlib
      */
@@ -92,20 +119,122 @@ public:
      */
     void setProxy(const std::string& server, uint32_t port, const std::string& username = "", const std::string& password = "");
 
+    /** Set the maximum time a request to the Last.fm server may take
+     * \param timeout the timeout, 0 means no timeout (default)
+     */
+    void setTimeout(std::chrono::milliseconds timeout);
+
+    /** Abort the requests that are in progress, all following requests
+     * fail immediately with a ConnectionError
+     */
+    void abort();
+
+    /** \brief returns true once abort() was called */
+    [[nodiscard]] bool isAborted() const;
+
+    /** Limit the rate of the Now Playing and submission requests of this
+     * client. Requests above the rate are delayed, not rejected. All
+     * clients are also limited by RequestRateLimiter::instance().
+     * \param requestsPerSecond the sustained request rate, 0 disables the limit (default)
+     * \param burst the number of requests that can be sent at once
+     */
+    void setRateLimit(double requestsPerSecond, double burst);
+
+    /** Returns the time requests of this client waited for its rate limit
+     * \return a RateLimiterStatistics object
+     */
+    [[nodiscard]] RateLimiterStatistics getRateLimiterStatistics() const;
+
+    /** Set the policy of the circuit breakers of the endpoints. When an
+     * endpoint could not be reached a number of times in a row, requests
+     * to it fail immediately with a ConnectionError until the open
+     * duration has passed and a probe request succeeds.
+     * \param policy the circuit breaker policy
+     */
+    void setCircuitBreakerPolicy(const CircuitBreakerPolicy& policy);
+
+    /** Returns the state of the circuit breaker of an endpoint
+     * \param endpoint the endpoint
+     * \return the state of the circuit
+     */
+    [[nodiscard]] CircuitBreaker::State getCircuitState(Endpoint endpoint) const;
+
+    /** \brief returns the number of requests that failed immediately because a circuit was open */
+    [[nodiscard]] uint64_t getCircuitRejectedCount() const;
+
+    /** Set a callback that receives the curl timing and the byte counts
+     * of every request, also of failed requests that reached curl. The
+     * callback is called on the thread that performed the request. Set
+     * it before requests are made.
+     * \param observer the callback, an empty function removes it
+     */
+    void setTransferObserver(TransferObserver observer);
+
+    /** Record the byte counts and the phases of the curl timing of every
+     * request in the MetricsRegistry (lastfm_sent_bytes_total,
+     * lastfm_received_bytes_total and lastfm_request_phase_seconds).
+     * Without these metrics and without a transfer observer the timing is
+     * not read from curl. Disabled by default, set it before requests are
+     * made.
+     * \param enabled true to record the transfer metrics
+     */
+    void setTransferMetricsEnabled(bool enabled);
+
+    /** Returns the flight recorder that keeps the recent requests of this
+     * client, the owner of the client can add its own events to it
+     * \return the FlightRecorder of the client
+     */
+    FlightRecorder& getFlightRecorder();
+
+    /** Set the url used for the handshake, allows to use another server
+     * that implements the Audioscrobbler protocol
+     * \param url the handshake url (default: http://post.audioscrobbler.com/)
+     */
+    void setHandshakeUrl(const std::string& url);
+
+    /** Returns the session obtained by the last handshake
+     * \return a LastFmSession object, the session id is empty if no handshake was done
+     */
+    [[nodiscard]] LastFmSession getSession() const;
+
+    /** Use a session from a previous handshake instead of performing a new one
+     * \param session a LastFmSession object
+     */
+    void setSession(const LastFmSession& session);
+
 private:
     [[nodiscard]] std::string createRequestString(const std::string& user, const std::string& pass) const;
-    [[nodiscard]] std::string createNowPlayingString(const NowPlayingInfo& info) const;
-    [[nodiscard]] std::string createSubmissionString(const SubmissionInfo& info) const;
-    [[nodiscard]] std::string createSubmissionString(const SubmissionInfoCollection& infoCollection) const;
-    void throwOnInvalidSession() const;
-    void submit(const std::string& postData) const;
+    [[nodiscard]] static std::string createNowPlayingString(const LastFmSession& session, const NowPlayingInfo& info);
+    [[nodiscard]] static std::string createSubmissionString(const LastFmSession& session, const SubmissionInfo& info);
+    [[nodiscard]] static std::string createSubmissionString(const LastFmSession& session, const SubmissionInfoCollection& infoCollection);
+    [[nodiscard]] std::shared_ptr<const LastFmSession> getValidSession() const;
+    void submit(const LastFmSession& session, const std::string& postData, size_t tracks) const;
+    template <typename Request>
+    std::chrono::microseconds performRequest(Endpoint endpoint, size_t tracks, Request request) const;
+    void recordOutcome(Endpoint endpoint, const std::string& status, std::chrono::microseconds latency, size_t tracks) const;
+    void recordRequest(Endpoint endpoint, FlightStatus status, std::chrono::microseconds latency, size_t tracks) const;
+    void recordTransfer(Endpoint endpoint, const TransferTiming& timing) const;
+    [[nodiscard]] CircuitBreaker& getCircuitBreaker(Endpoint endpoint) const;
+    void waitForRateLimit() const;
+    void waitFor(std::chrono::steady_clock::duration wait) const;
 
     UrlClient m_UrlClient;
+    mutable RequestRateLimiter m_RateLimiter;
+    mutable CircuitBreaker m_HandshakeCircuit;
+    mutable CircuitBreaker m_NowPlayingCircuit;
+    mutable CircuitBreaker m_SubmissionCircuit;
+    TransferObserver m_TransferObserver;
+    bool m_TransferMetricsEnabled {};
+    mutable FlightRecorder m_FlightRecorder;
+    mutable std::mutex m_AbortMutex;
+    mutable std::condition_variable m_AbortCondition;
     std::string m_ClientIdentifier { "lfc" };
     std::string m_ClientVersion { "1.0" };
-    std::string m_SessionId;
-    std::string m_NowPlayingUrl;
-    std::string m_SubmissionUrl;
+    std::string m_HandshakeUrl { "http://post.audioscrobbler.com/" };
+    // a handshake replaces the session while other threads send requests,
+    // the session is never modified so a request keeps using its own one
+    std::shared_ptr<const LastFmSession> m_pSession { std::make_shared<LastFmSession>() };
+    mutable std::mutex m_SessionMutex;
 };
 
 #endif
@@ -16,14 +16,71 @@
 
 #include "lastfmscrobbler.h"
 
+#include <exception>
+#include <future>
+#include <iomanip>
+
+#include "handshakeadmission.h"
+#include "metricsregistry.h"
+#include "reconnectscheduler.h"
+#include "tracepoints.h"
 #include "utils/log.h"
 
 using namespace std;
+using namespace std::chrono;
 
 static const time_t MIN_SECONDS_TO_SUBMIT = 240;
 static const time_t MIN_TRACK_LENGTH_TO_SUBMIT = 30;
 static const time_t MIN_SECS_BETWEEN_CONNECT = 60;
 static const time_t MAX_SECS_BETWEEN_CONNECT = 7200;
+static const milliseconds DEFAULT_SHUTDOWN_TIMEOUT = 5s;
+static const size_t MAX_DEAD_LETTERS = 1000;
+// a server that fails these tracks on their own without accepting any other
+// track fails every submission, the isolation stops then
+static const size_t MAX_FAILED_TRACKS_WITHOUT_ACCEPTED = 3;
+
+static bool canBeEncoded(const SubmissionInfoCollection& tracks)
+{
+    try {
+        static_cast<void>(tracks.getPostData());
+        return true;
+    } catch (const logic_error&) {
+        return false;
+    }
+}
+
+// Tracks that can't be encoded are rejected whatever the batch, they are
+// taken out before sending so the other tracks can be submitted
+static std::vector<SubmissionInfo> removeRejectedTracks(SubmissionInfoCollection& tracks)
+{
+    if (canBeEncoded(tracks)) {
+        return {};
+    }
+
+    SubmissionInfoCollection validTracks;
+    std::vector<SubmissionInfo> rejectedTracks;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        try {
+            static_cast<void>(tracks.getInfo(i).getPostData(0));
+            validTracks.addInfo(tracks.getInfo(i), tracks.getTimeAdded(i));
+        } catch (const logic_error& e) {
+            Log::error(e.what(), ":", tracks.getInfo(i).getArtist(), "-", tracks.getInfo(i).getTrack());
+            rejectedTracks.push_back(tracks.getInfo(i));
+        }
+    }
+
+    tracks = std::move(validTracks);
+    return rejectedTracks;
+}
+
+static SubmissionInfoCollection copyTracks(const SubmissionInfoCollection& tracks, size_t first, size_t count)
+{
+    SubmissionInfoCollection range;
+    for (size_t i = first; i < first + count; ++i) {
+        range.addInfo(tracks.getInfo(i), tracks.getTimeAdded(i));
+    }
+    return range;
+}
 
 LastFmScrobbler::LastFmScrobbler(string user, const string& pass, bool hashedPass, bool synchronous)
 : m_pLastFmClient(std::make_shared<LastFmClient>())
@@ -54,16 +111,149 @@ LastFmScrobbler::LastFmScrobbler(bool synchronous)
 
 LastFmScrobbler::~LastFmScrobbler()
 {
-    if (m_FinishPlayingThread.joinable())
-        m_FinishPlayingThread.join();
+    shutdown(DEFAULT_SHUTDOWN_TIMEOUT);
+}
+
+std::vector<SubmissionInfo> LastFmScrobbler::shutdown(std::chrono::milliseconds timeout)
+{
+    auto deadline = steady_clock::now() + timeout;
+
+    TimerWheel::TimerId reconnectTimer;
+    TimerWheel::TimerId batchDeadlineTimer;
+    {
+        auto lock = std::scoped_lock(m_AuthenticateThreadMutex);
+        if (m_ShuttingDown) {
+            return {};
+        }
+        m_ShutdownDeadline = deadline;
+        m_ShuttingDown = true;
+        reconnectTimer = m_ReconnectTimer;
+        batchDeadlineTimer = m_BatchDeadlineTimer;
+        m_BatchDeadlineTimer = 0;
+    }
+    ReconnectScheduler::instance().cancel(reconnectTimer);
+    ReconnectScheduler::instance().cancel(batchDeadlineTimer);
+
+    Log::info("Shutting down scrobbler");
+
+    // the per-request timeout does not bound retries, handshakes and drained pages,
+    // so everything that is still in progress is aborted when the deadline passes
+    TimerWheel::TimerId watchdogTimer = 0;
+    if (timeout > 0ms) {
+        watchdogTimer = ReconnectScheduler::instance().schedule(timeout, [this] { abortRequests(); });
+    } else {
+        abortRequests();
+    }
+
+    // a pending now playing update is no longer useful
+    {
+        auto lock = std::scoped_lock(m_NowPlayingMutex);
+        ++m_NowPlayingGeneration;
+    }
+    m_NowPlayingCondition.notify_all();
+
+    bool threadsFinished;
+    {
+        auto lock = std::unique_lock(m_ThreadsMutex);
+        threadsFinished = m_ThreadsFinished.wait_until(lock, deadline, [this] { return m_RunningThreads == 0; });
+    }
+
+    if (m_pLastFmClient) {
+        auto remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+        if (threadsFinished && remaining > 0ms && !m_pLastFmClient->isAborted()) {
+            m_pLastFmClient->setTimeout(remaining);
+            submitBufferedTracks(true);
+        }
+    }
+
+    // whatever is still in progress is given up, so the threads can be joined
+    ReconnectScheduler::instance().cancel(watchdogTimer);
+    abortRequests();
+
+    if (m_SubmissionThread.joinable())
+        m_SubmissionThread.join();
     if (m_SendInfoThread.joinable())
         m_SendInfoThread.join();
     if (m_AuthenticateThread.joinable())
         m_AuthenticateThread.join();
+
+    std::vector<SubmissionInfo> unsentTracks;
+    {
+        auto lock = std::scoped_lock(m_TrackInfosMutex);
+        for (size_t i = 0; i < m_BufferedTrackInfos.size(); ++i) {
+            unsentTracks.push_back(m_BufferedTrackInfos.getInfo(i));
+        }
+        m_BufferedTrackInfos.clear();
+    }
+    {
+        // tracks the submission lane did not get to before the deadline
+        auto lock = std::scoped_lock(m_SubmissionQueueMutex);
+        for (auto& submission : m_SubmissionQueue) {
+            if (submission.track) {
+                unsentTracks.push_back(*submission.track);
+            }
+        }
+        m_SubmissionQueue.clear();
+    }
+
+    if (!unsentTracks.empty()) {
+        Log::info("Shutdown:", unsentTracks.size(), "tracks could not be submitted");
+        if (m_UnsentTracksHandler) {
+            m_UnsentTracksHandler(unsentTracks);
+        }
+    }
+    if (m_pSubmissionSpool && !m_pSubmissionSpool->empty()) {
+        Log::info("Shutdown:", m_pSubmissionSpool->size(), "tracks remain in the submission spool");
+    }
+
+    // the gauges only cover running scrobblers, spooled tracks stay on disk
+    reportBufferedTracks(0);
+    reportConnectionFailures(0);
+
+    return unsentTracks;
+}
+
+void LastFmScrobbler::abortRequests()
+{
+    if (!m_pLastFmClient) {
+        return;
+    }
+
+    m_pLastFmClient->abort();
+    // wakes up a handshake that waits for admission, it checks the aborted client
+    HandshakeAdmission::instance().interrupt();
+}
+
+void LastFmScrobbler::setUnsentTracksHandler(std::function<void(const std::vector<SubmissionInfo>&)> handler)
+{
+    m_UnsentTracksHandler = std::move(handler);
+}
+
+void LastFmScrobbler::startThread(std::thread& thread, std::function<void()> function)
+{
+    if (thread.joinable())
+        thread.join();
+
+    {
+        auto lock = std::scoped_lock(m_ThreadsMutex);
+        ++m_RunningThreads;
+    }
+
+    thread = std::thread([this, function = std::move(function)] {
+        function();
+
+        auto lock = std::scoped_lock(m_ThreadsMutex);
+        --m_RunningThreads;
+        m_ThreadsFinished.notify_all();
+    });
 }
 
 void LastFmScrobbler::authenticate()
 {
+    if (m_ShuttingDown) {
+        return;
+    }
+
     authenticateIfNecessary();
 }
 
@@ -72,11 +262,63 @@ void LastFmScrobbler::setCommitOnlyMode(bool enabled)
     m_CommitOnly = enabled;
 }
 
+void LastFmScrobbler::setNowPlayingDebounce(std::chrono::milliseconds window)
+{
+    m_NowPlayingDebounce = window;
+}
+
+void LastFmScrobbler::setNowPlayingDuplicateTtl(std::chrono::seconds ttl)
+{
+    m_NowPlayingDuplicateTtl = ttl;
+}
+
+ScrobblerStatistics LastFmScrobbler::getStatistics() const
+{
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    ScrobblerStatistics statistics = m_Statistics;
+    if (m_pDedupIndex) {
+        statistics.duplicatesFiltered = m_pDedupIndex->getFilteredCount();
+    }
+
+    auto rateLimiterStatistics = m_pLastFmClient->getRateLimiterStatistics();
+    statistics.rateLimitedRequests = rateLimiterStatistics.delayedRequests;
+    statistics.rateLimitWaitTotalMs = duration_cast<milliseconds>(rateLimiterStatistics.totalWait).count();
+    statistics.rateLimitWaitMaxMs = duration_cast<milliseconds>(rateLimiterStatistics.maxWait).count();
+    statistics.circuitRejectedRequests = m_pLastFmClient->getCircuitRejectedCount();
+    return statistics;
+}
+
+void LastFmScrobbler::setBatchPolicy(const SubmissionBatchPolicy& policy)
+{
+    auto lock = std::scoped_lock(m_TrackInfosMutex);
+    m_BatchPolicy = policy;
+}
+
+void LastFmScrobbler::flush()
+{
+    if (m_ShuttingDown) {
+        return;
+    }
+
+    if (m_Synchronous) {
+        submitBufferedTracks(true);
+    } else {
+        queueSubmission(std::nullopt, true);
+    }
+}
+
 void LastFmScrobbler::startedPlaying(const SubmissionInfo& info)
 {
+    if (m_ShuttingDown) {
+        Log::info("startedPlaying ignored: scrobbler is shutting down");
+        return;
+    }
+
+    LASTFMLIB_TRACE(scrobbler__started, info.getArtist().c_str(), info.getTrack().c_str());
     authenticateIfNecessary();
 
-    Log::info("startedPlaying " + info.getTrack());
+    Log::info("startedPlaying", info.getTrack());
+
     m_PreviousTrackInfo = m_CurrentTrackInfo;
     m_CurrentTrackInfo = info;
 
@@ -84,20 +326,32 @@ void LastFmScrobbler::startedPlaying(const SubmissionInfo& info)
         m_CurrentTrackInfo.setTimeStarted(time(nullptr));
     }
 
+    uint64_t generation;
+    {
+        auto lock = std::scoped_lock(m_NowPlayingMutex);
+        generation = ++m_NowPlayingGeneration;
+        m_NowPlayingInfo = m_CurrentTrackInfo;
+    }
+    // wake up a pending now playing update so it can be dropped
+    m_NowPlayingCondition.notify_all();
+
     if (m_Synchronous) {
         submitTrack(m_PreviousTrackInfo);
         if (!m_CommitOnly) {
-            setNowPlaying();
+            setNowPlaying(m_CurrentTrackInfo, generation);
         }
     } else {
-        if (m_SendInfoThread.joinable())
-            m_SendInfoThread.join();
-        m_SendInfoThread = std::thread([this] { sendInfoThread(); });
+        // the lanes run independently, so now playing never waits for a submission
+        if (!m_CommitOnly) {
+            startNowPlayingLane();
+        }
+        queueSubmission(takeCommittableTrack(m_PreviousTrackInfo), false);
     }
 }
 
 void LastFmScrobbler::pausePlaying(bool paused)
 {
+    LASTFMLIB_TRACE(scrobbler__paused, paused ? 1 : 0);
     time_t curTime = time(nullptr);
     if (paused) {
         m_TrackPlayTime += curTime - m_CurrentTrackInfo.getTimeStarted();
@@ -108,13 +362,17 @@ void LastFmScrobbler::pausePlaying(bool paused)
 
 void LastFmScrobbler::finishedPlaying()
 {
+    if (m_ShuttingDown) {
+        Log::info("finishedPlaying ignored: scrobbler is shutting down");
+        return;
+    }
+
+    LASTFMLIB_TRACE(scrobbler__finished);
     authenticateIfNecessary();
     if (m_Synchronous) {
         submitTrack(m_CurrentTrackInfo);
     } else {
-        if (m_FinishPlayingThread.joinable())
-            m_FinishPlayingThread.join();
-        m_FinishPlayingThread = std::thread([this] { finishPlayingThread(); });
+        queueSubmission(takeCommittableTrack(m_CurrentTrackInfo), false);
     }
 }
 
@@ -123,6 +381,160 @@ void LastFmScrobbler::setProxy(const std::string& server, uint32_t port, const s
     m_pLastFmClient->setProxy(server, port, username, password);
 }
 
+void LastFmScrobbler::setHandshakeUrl(const std::string& url) const
+{
+    m_pLastFmClient->setHandshakeUrl(url);
+}
+
+void LastFmScrobbler::setRateLimit(double requestsPerSecond, double burst) const
+{
+    m_pLastFmClient->setRateLimit(requestsPerSecond, burst);
+}
+
+void LastFmScrobbler::setCircuitBreakerPolicy(const CircuitBreakerPolicy& policy) const
+{
+    m_pLastFmClient->setCircuitBreakerPolicy(policy);
+}
+
+void LastFmScrobbler::setTransferObserver(LastFmClient::TransferObserver observer) const
+{
+    m_pLastFmClient->setTransferObserver(std::move(observer));
+}
+
+void LastFmScrobbler::setTransferMetricsEnabled(bool enabled) const
+{
+    m_pLastFmClient->setTransferMetricsEnabled(enabled);
+}
+
+std::vector<FlightRecord> LastFmScrobbler::getFlightRecords() const
+{
+    return m_pLastFmClient->getFlightRecorder().getRecords();
+}
+
+void LastFmScrobbler::dumpFlightRecorder() const
+{
+    m_pLastFmClient->getFlightRecorder().dump();
+}
+
+void LastFmScrobbler::setFlightRecorderDumpHandler(FlightRecorder::DumpHandler handler) const
+{
+    m_pLastFmClient->getFlightRecorder().setDumpHandler(std::move(handler));
+}
+
+void LastFmScrobbler::setSessionCache(const std::string& path)
+{
+    if (path.empty()) {
+        m_pSessionCache.reset();
+    } else {
+        m_pSessionCache = std::make_unique<SessionCache>(path);
+    }
+    m_SessionCacheChecked = false;
+}
+
+void LastFmScrobbler::setSubmissionLog(const std::string& path, SubmissionLogSyncPolicy policy)
+{
+    auto lock = std::scoped_lock(m_TrackInfosMutex);
+    if (path.empty()) {
+        m_pSubmissionLog.reset();
+        return;
+    }
+
+    m_pSubmissionLog = std::make_unique<SubmissionLog>(path, policy);
+    size_t count = m_pSubmissionLog->replay(m_BufferedTrackInfos);
+    if (count > 0) {
+        Log::info("Restored", m_BufferedTrackInfos.size(), "buffered tracks from the submission log");
+    }
+    if (count > m_BufferedTrackInfos.size()) {
+        // a log written by an older version can exceed the buffer
+        Log::error("Submission log contained", count, "tracks, the oldest", count - m_BufferedTrackInfos.size(), "were dropped");
+        m_pLastFmClient->getFlightRecorder().record(FlightEvent::TrackDropped, FlightStatus::Failed, {}, count - m_BufferedTrackInfos.size());
+        m_pSubmissionLog->rewrite(m_BufferedTrackInfos);
+    }
+    reportBufferedTracks(m_BufferedTrackInfos.size());
+}
+
+void LastFmScrobbler::setSubmissionSpool(const std::string& path, uint64_t capacity)
+{
+    auto lock = std::scoped_lock(m_SpoolDrainMutex);
+    if (path.empty()) {
+        m_pSubmissionSpool.reset();
+        return;
+    }
+
+    m_pSubmissionSpool = std::make_unique<SubmissionSpool>(path, capacity);
+    if (!m_pSubmissionSpool->empty()) {
+        Log::info("Submission spool contains", m_pSubmissionSpool->size(), "tracks");
+    }
+    reportBufferedTracks(m_pSubmissionSpool->size());
+}
+
+void LastFmScrobbler::setSubmissionPipelineDepth(size_t depth)
+{
+    m_SubmissionPipelineDepth = max<size_t>(depth, 1);
+}
+
+ScrobblerLogStatistics LastFmScrobbler::importScrobblerLog(const std::string& path)
+{
+    if (!m_pSubmissionSpool) {
+        throw logic_error("A submission spool is required to import a scrobbler log");
+    }
+
+    uint64_t dropped = 0;
+    uint64_t tooLarge = 0;
+    ScrobblerLogImporter importer(path);
+    // the spool records were encoded by the threads of the importer
+    auto statistics = importer.import([this, &dropped, &tooLarge](const SubmissionInfoCollection& page, const std::vector<std::string>& records) {
+        // the window of the filter is based on the time of the import, the
+        // historical start time is only part of the hash
+        time_t now = time(nullptr);
+
+        auto lock = std::scoped_lock(m_TrackInfosMutex);
+        for (size_t i = 0; i < page.size(); ++i) {
+            const SubmissionInfo& info = page.getInfo(i);
+            if (m_pDedupIndex && m_pDedupIndex->isDuplicate(info, now)) {
+                continue;
+            }
+
+            // a dropped track is not remembered, so it can be imported again
+            bool spooled = false;
+            try {
+                spooled = m_pSubmissionSpool->enqueueRecord(records[i]);
+                if (!spooled) {
+                    ++dropped;
+                }
+            } catch (const logic_error& e) {
+                Log::error(e.what(), ":", info.getArtist(), "-", info.getTrack());
+                ++tooLarge;
+            }
+
+            if (spooled && m_pDedupIndex) {
+                m_pDedupIndex->insert(info, now);
+            }
+        }
+    });
+    // tracks that don't fit in the spool are skipped like the tracks the player skipped
+    statistics.imported -= tooLarge;
+    statistics.skipped += tooLarge;
+    m_pSubmissionSpool->sync();
+    reportBufferedTracks(m_pSubmissionSpool->size());
+
+    Log::info("Imported", statistics.imported, "tracks from", path);
+    Log::info("Skipped tracks:", statistics.skipped, "invalid lines:", statistics.invalid);
+    if (dropped > 0) {
+        Log::error("Submission spool is full,", dropped, "imported tracks dropped");
+    }
+
+    flush();
+    return statistics;
+}
+
+void LastFmScrobbler::setDuplicateFilter(std::chrono::seconds window)
+{
+    auto lock = std::scoped_lock(m_TrackInfosMutex, m_StatisticsMutex);
+    m_pDedupIndex = window > 0s ? std::make_shared<SubmissionDedupIndex>(window) : nullptr;
+    m_BufferedTrackInfos.setDedupIndex(m_pDedupIndex);
+}
+
 bool LastFmScrobbler::trackCanBeCommited(const SubmissionInfo& info)
 {
     time_t curTime = time(nullptr);
@@ -133,11 +545,11 @@ bool LastFmScrobbler::trackCanBeCommited(const SubmissionInfo& info)
         || m_TrackPlayTime >= (info.getTrackLength() / 2);
 
     if (trackTooShort) {
-        Log::info("Track \"" + info.getTrack() + "\" can't be committed: length is too short");
+        Log::info("Track", quoted(info.getTrack()), "can't be committed: length is too short");
     } else if (!trackPlayedLongEnough) {
-        Log::info("Track \"" + info.getTrack() + "\" can't be committed: not played long enough");
+        Log::info("Track", quoted(info.getTrack()), "can't be committed: not played long enough");
     } else {
-        Log::info("Track \"" + info.getTrack() + "\" can be committed: conditions OK");
+        Log::info("Track", quoted(info.getTrack()), "can be committed: conditions OK");
     }
 
     return (!trackTooShort) && trackPlayedLongEnough;
@@ -145,39 +557,179 @@ bool LastFmScrobbler::trackCanBeCommited(const SubmissionInfo& info)
 
 void LastFmScrobbler::authenticateIfNecessary()
 {
-    if (!m_Authenticated && !m_AuthenticateThread.joinable() && canReconnect()) {
-        if (m_Synchronous) {
-            authenticateNow();
-        } else {
-            if (m_AuthenticateThread.joinable())
-                m_AuthenticateThread.join();
-            m_AuthenticateThread = std::thread([this] { authenticateThread(); });
+    if (m_Authenticated || !canReconnect()) {
+        return;
+    }
+
+    if (m_Synchronous) {
+        authenticateNow();
+    } else {
+        auto lock = std::scoped_lock(m_AuthenticateThreadMutex);
+        if (m_Authenticating || m_ShuttingDown) {
+            return;
         }
+
+        m_Authenticating = true;
+        startThread(m_AuthenticateThread, [this] { authenticateThread(); });
     }
 }
 
 void LastFmScrobbler::authenticateNow()
 {
+    // both lanes can detect an invalid session at the same time
+    auto lock = std::scoped_lock(m_HandshakeMutex);
+
+    if (restoreCachedSession()) {
+        return;
+    }
+
     try {
+        // limits the number of sessions that reconnect at the same time, the wait ends on shutdown
+        HandshakeAdmission::Ticket ticket(HandshakeAdmission::instance(), [this] { return m_pLastFmClient->isAborted(); });
         m_pLastFmClient->handshake(m_Username, m_Password);
-        Log::info("Authentication successfull for user: " + m_Username);
+        Log::info("Authentication successfull for user:", m_Username);
         m_HardConnectionFailureCount = 0;
-        m_Authenticated = true;
+        reportConnectionFailures(0);
+        setAuthenticated(true);
+
+        if (m_pSessionCache) {
+            m_pSessionCache->store(m_Username, m_pLastFmClient->getSession());
+        }
     } catch (const ConnectionError&) {
-        ++m_HardConnectionFailureCount;
+        int failures = ++m_HardConnectionFailureCount;
+        reportConnectionFailures(failures);
+        auto delay = ReconnectScheduler::backoffDelay(failures - 1, seconds(MIN_SECS_BETWEEN_CONNECT), seconds(MAX_SECS_BETWEEN_CONNECT));
+        // the delay is stored first, canReconnect() never combines the new attempt with the old delay
+        m_ReconnectDelay = delay;
         m_LastConnectionAttempt = time(nullptr);
+        Log::info("Authentication failed, next attempt in", ceil<seconds>(delay).count(), "seconds");
+        scheduleReconnect();
     } catch (const logic_error& e) {
         Log::error(e.what());
     }
 }
 
+bool LastFmScrobbler::restoreCachedSession()
+{
+    // only the first authentication uses the cache, later ones are
+    // caused by an invalid session
+    if (!m_pSessionCache || m_SessionCacheChecked) {
+        return false;
+    }
+    m_SessionCacheChecked = true;
+
+    LastFmSession session;
+    try {
+        if (!m_pSessionCache->load(m_Username, session)) {
+            return false;
+        }
+    } catch (const logic_error& e) {
+        Log::error(e.what());
+        return false;
+    }
+
+    m_pLastFmClient->setSession(session);
+    setAuthenticated(true);
+    Log::info("Using cached session for user:", m_Username);
+    return true;
+}
+
 bool LastFmScrobbler::canReconnect() const
 {
     time_t curTime = time(nullptr);
     time_t timeSinceLastConnectionAttempt = curTime - m_LastConnectionAttempt;
-    time_t connectionDelay = max(MAX_SECS_BETWEEN_CONNECT, m_HardConnectionFailureCount * MIN_SECS_BETWEEN_CONNECT);
 
-    return timeSinceLastConnectionAttempt > connectionDelay;
+    return timeSinceLastConnectionAttempt >= ceil<seconds>(m_ReconnectDelay.load()).count();
+}
+
+void LastFmScrobbler::scheduleReconnect()
+{
+    if (m_Synchronous) {
+        // the reconnection happens on the next call of the player
+        return;
+    }
+
+    // the lock is not held while cancelling, the timer callback needs it
+    TimerWheel::TimerId previousTimer;
+    {
+        auto lock = std::scoped_lock(m_AuthenticateThreadMutex);
+        previousTimer = m_ReconnectTimer;
+        m_ReconnectTimer = 0;
+    }
+
+    ReconnectScheduler& scheduler = ReconnectScheduler::instance();
+    scheduler.cancel(previousTimer);
+    TimerWheel::TimerId timer = scheduler.schedule(m_ReconnectDelay.load(), [this] { authenticateIfNecessary(); });
+
+    auto lock = std::unique_lock(m_AuthenticateThreadMutex);
+    if (m_ShuttingDown) {
+        lock.unlock();
+        scheduler.cancel(timer);
+    } else {
+        m_ReconnectTimer = timer;
+    }
+}
+
+void LastFmScrobbler::scheduleBatchDeadline()
+{
+    if (m_Synchronous) {
+        // the age of the batch is checked on the next call of the player
+        return;
+    }
+
+    time_t maxAge;
+    time_t oldestTimeAdded = 0;
+    {
+        auto lock = std::scoped_lock(m_TrackInfosMutex);
+        maxAge = m_BatchPolicy.maxAgeInSecs;
+        if (maxAge <= 0) {
+            return;
+        }
+
+        if (!m_pSubmissionSpool) {
+            if (m_BufferedTrackInfos.empty()) {
+                return;
+            }
+            oldestTimeAdded = m_BufferedTrackInfos.getTimeAdded(0);
+        }
+    }
+
+    if (m_pSubmissionSpool) {
+        SubmissionInfoCollection oldest;
+        m_pSubmissionSpool->readPage(0, oldest, 1);
+        if (oldest.empty()) {
+            return;
+        }
+        oldestTimeAdded = oldest.getTimeAdded(0);
+    }
+
+    // an overdue batch was just attempted, it is retried with the next track
+    time_t remaining = oldestTimeAdded + maxAge - time(nullptr);
+    if (remaining <= 0) {
+        return;
+    }
+
+    // the timer callback takes the lock, but the scheduler never holds its own lock while calling it
+    auto lock = std::scoped_lock(m_AuthenticateThreadMutex);
+    if (m_ShuttingDown || m_BatchDeadlineTimer != 0) {
+        // a pending timer that fires early schedules the next one
+        return;
+    }
+    m_BatchDeadlineTimer = ReconnectScheduler::instance().schedule(seconds(remaining), [this] { batchDeadlineExpired(); });
+}
+
+void LastFmScrobbler::batchDeadlineExpired()
+{
+    {
+        auto lock = std::scoped_lock(m_AuthenticateThreadMutex);
+        m_BatchDeadlineTimer = 0;
+        if (m_ShuttingDown) {
+            return;
+        }
+    }
+
+    // the submission lane checks the batch policy, so the scheduler thread never waits for a request
+    queueSubmission(std::nullopt, false);
 }
 
 void LastFmScrobbler::authenticateThread()
@@ -185,6 +737,7 @@ void LastFmScrobbler::authenticateThread()
     Log::info("Authenticate thread started");
 
     authenticateNow();
+    m_Authenticating = false;
 
     {
         auto lock = std::scoped_lock(m_AuthenticatedMutex);
@@ -194,62 +747,179 @@ void LastFmScrobbler::authenticateThread()
     Log::info("Authenticate thread finished");
 }
 
-void LastFmScrobbler::sendInfoThread()
+void LastFmScrobbler::startNowPlayingLane()
 {
-    Log::debug("sendInfo thread started");
+    auto lock = std::scoped_lock(m_NowPlayingMutex);
+    if (m_NowPlayingLaneActive) {
+        // the running lane picks up the newest track
+        return;
+    }
 
-    {
-        auto lock = std::unique_lock(m_AuthenticatedMutex);
-        if (!m_Authenticated) {
-            if (!m_AuthenticatedCondition.wait_for(lock, 4ms, [this] { return m_Authenticated; })) {
-                Log::info("send info terminated because no connection");
-                submitTrack(m_PreviousTrackInfo);
-                return;
+    m_NowPlayingLaneActive = true;
+    m_NowPlayingHandledGeneration = m_NowPlayingGeneration - 1;
+    startThread(m_SendInfoThread, [this] { nowPlayingLane(); });
+}
+
+void LastFmScrobbler::nowPlayingLane()
+{
+    Log::debug("now playing lane started");
+
+    for (;;) {
+        SubmissionInfo info;
+        uint64_t generation;
+        {
+            auto lock = std::scoped_lock(m_NowPlayingMutex);
+            if (m_ShuttingDown || m_NowPlayingHandledGeneration == m_NowPlayingGeneration) {
+                m_NowPlayingLaneActive = false;
+                break;
+            }
+
+            // only the newest track is sent, the tracks in between are coalesced
+            for (uint64_t skipped = m_NowPlayingHandledGeneration + 1; skipped < m_NowPlayingGeneration; ++skipped) {
+                suppressNowPlaying("superseded by a newer track");
+            }
+
+            generation = m_NowPlayingGeneration;
+            info = m_NowPlayingInfo;
+            m_NowPlayingHandledGeneration = generation;
+        }
+
+        {
+            auto lock = std::unique_lock(m_AuthenticatedMutex);
+            if (!m_AuthenticatedCondition.wait_for(lock, 4ms, [this] { return m_Authenticated.load(); })) {
+                Log::info("Now playing update dropped: no connection");
+                continue;
             }
         }
+
+        if (waitForNowPlayingDebounce(generation)) {
+            setNowPlaying(info, generation);
+        } else {
+            suppressNowPlaying("superseded by a newer track");
+        }
+    }
+
+    Log::debug("now playing lane finished");
+}
+
+std::optional<SubmissionInfo> LastFmScrobbler::takeCommittableTrack(const SubmissionInfo& info)
+{
+    bool committable = info.getTrackLength() >= 0 && trackCanBeCommited(info);
+    if (!committable) {
+        Log::info("Won't submit");
     }
 
-    submitTrack(m_PreviousTrackInfo);
-    if (!m_CommitOnly) {
-        setNowPlaying();
+    m_TrackPlayTime = 0;
+    m_TrackResumeTime = m_CurrentTrackInfo.getTimeStarted();
+
+    if (!committable) {
+        return std::nullopt;
     }
+    return info;
+}
+
+void LastFmScrobbler::queueSubmission(std::optional<SubmissionInfo> track, bool force)
+{
+    auto lock = std::scoped_lock(m_SubmissionQueueMutex);
+    m_SubmissionQueue.push_back(QueuedSubmission { std::move(track), force });
 
-    Log::debug("sendInfo thread finished");
+    if (!m_SubmissionLaneActive) {
+        m_SubmissionLaneActive = true;
+        startThread(m_SubmissionThread, [this] { submissionLane(); });
+    }
 }
 
-void LastFmScrobbler::finishPlayingThread()
+void LastFmScrobbler::submissionLane()
 {
-    Log::debug("finishPlaying thread started");
+    Log::debug("submission lane started");
 
-    {
-        auto lock = std::scoped_lock(m_AuthenticatedMutex);
-        if (!m_Authenticated) {
-            // Program is probalby cleaning up, dont't try to start authentication
-            return;
+    for (;;) {
+        std::deque<QueuedSubmission> submissions;
+        {
+            auto lock = std::scoped_lock(m_SubmissionQueueMutex);
+            if (m_SubmissionQueue.empty()) {
+                m_SubmissionLaneActive = false;
+                break;
+            }
+            submissions.swap(m_SubmissionQueue);
+        }
+
+        // everything that was queued while the previous submission was in flight is handled at once
+        bool force = false;
+        for (auto& submission : submissions) {
+            if (submission.track) {
+                bufferTrack(*submission.track);
+            }
+            force = force || submission.force;
         }
+
+        submitBufferedTracks(force);
     }
 
-    submitTrack(m_PreviousTrackInfo);
+    Log::debug("submission lane finished");
+}
+
+bool LastFmScrobbler::waitForNowPlayingDebounce(uint64_t generation)
+{
+    auto lock = std::unique_lock(m_NowPlayingMutex);
+    return !m_NowPlayingCondition.wait_for(lock, m_NowPlayingDebounce, [this, generation] {
+        return m_NowPlayingGeneration != generation;
+    });
+}
+
+bool LastFmScrobbler::isDuplicateNowPlaying(const NowPlayingInfo& info) const
+{
+    return m_NowPlayingDuplicateTtl.count() > 0
+        && m_LastNowPlayingInfo == info
+        && std::chrono::steady_clock::now() - m_LastNowPlayingTime < m_NowPlayingDuplicateTtl;
+}
+
+void LastFmScrobbler::suppressNowPlaying(const std::string& reason)
+{
+    Log::debug("Now playing update dropped:", reason);
 
-    Log::debug("finishPlaying thread finished");
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    ++m_Statistics.nowPlayingSuppressed;
 }
 
-void LastFmScrobbler::setNowPlaying()
+void LastFmScrobbler::setNowPlaying(const SubmissionInfo& info, uint64_t generation)
 {
     if (!m_Authenticated) {
         Log::info("Can't set Now Playing status: not authenticated");
         return;
     }
 
+    bool superseded;
+    {
+        auto lock = std::scoped_lock(m_NowPlayingMutex);
+        superseded = m_NowPlayingGeneration != generation;
+    }
+
+    if (superseded) {
+        suppressNowPlaying("superseded by a newer track");
+        return;
+    }
+
+    if (isDuplicateNowPlaying(info)) {
+        suppressNowPlaying("identical to previous update");
+        return;
+    }
+
     try {
-        m_pLastFmClient->nowPlaying(m_CurrentTrackInfo);
-        Log::info("Now playing info submitted: " + m_CurrentTrackInfo.getArtist() + " - " + m_CurrentTrackInfo.getTrack());
+        m_pLastFmClient->nowPlaying(info);
+        m_LastNowPlayingInfo = info;
+        m_LastNowPlayingTime = std::chrono::steady_clock::now();
+        {
+            auto lock = std::scoped_lock(m_StatisticsMutex);
+            ++m_Statistics.nowPlayingSent;
+        }
+        Log::info("Now playing info submitted:", info.getArtist(), "-", info.getTrack());
     } catch (const BadSessionError&) {
         Log::info("Session has become invalid: starting new handshake");
         authenticateNow();
-        setNowPlaying();
+        setNowPlaying(info, generation);
     } catch (const ConnectionError&) {
-        m_Authenticated = false;
+        setAuthenticated(false);
     } catch (const logic_error& e) {
         Log::error(e.what());
     }
@@ -257,42 +927,537 @@ void LastFmScrobbler::setNowPlaying()
 
 void LastFmScrobbler::submitTrack(const SubmissionInfo& info)
 {
-    if (info.getTrackLength() < 0 || !trackCanBeCommited(info)) {
-        Log::info("Won't submit");
-        m_TrackPlayTime = 0;
-        m_TrackResumeTime = m_CurrentTrackInfo.getTimeStarted();
-        return;
+    if (auto track = takeCommittableTrack(info)) {
+        bufferTrack(*track);
     }
 
-    {
+    submitBufferedTracks(false);
+}
+
+void LastFmScrobbler::bufferTrack(const SubmissionInfo& info)
+{
+    time_t timeAdded = time(nullptr);
+
+    try {
+        if (m_pSubmissionSpool) {
+            bool spooled = false;
+            {
+                // the check and the insert are done under the same lock, so the
+                // filter only remembers tracks that were spooled
+                auto lock = std::scoped_lock(m_TrackInfosMutex);
+                if (m_pDedupIndex && m_pDedupIndex->isDuplicate(info, timeAdded)) {
+                    Log::info("Duplicate track filtered:", info.getArtist(), "-", info.getTrack());
+                    return;
+                }
+
+                try {
+                    spooled = m_pSubmissionSpool->enqueue(info, timeAdded);
+                    if (!spooled) {
+                        Log::error("Submission spool is full, track dropped:", info.getArtist(), "-", info.getTrack());
+                    }
+                } catch (const logic_error& e) {
+                    // the track is too large for the spool, it is dropped like on a full spool
+                    Log::error(e.what());
+                }
+
+                if (spooled && m_pDedupIndex) {
+                    m_pDedupIndex->insert(info, timeAdded);
+                }
+            }
+            if (spooled) {
+                m_pSubmissionSpool->sync();
+            }
+            reportBufferedTracks(m_pSubmissionSpool->size());
+            m_pLastFmClient->getFlightRecorder().record(spooled ? FlightEvent::TrackBuffered : FlightEvent::TrackDropped, spooled ? FlightStatus::Ok : FlightStatus::Failed, {}, 1);
+            return;
+        }
+
         auto lock = std::scoped_lock(m_TrackInfosMutex);
-        m_BufferedTrackInfos.addInfo(info);
+        // a full buffer drops its oldest track
+        bool dropsOldest = m_BufferedTrackInfos.size() == SubmissionInfoCollection::MAX_SIZE;
+        if (!m_BufferedTrackInfos.addInfo(info, timeAdded)) {
+            Log::info("Duplicate track filtered:", info.getArtist(), "-", info.getTrack());
+            return;
+        }
+        reportBufferedTracks(m_BufferedTrackInfos.size());
+        if (dropsOldest) {
+            Log::error("Submission buffer is full, oldest track dropped");
+            m_pLastFmClient->getFlightRecorder().record(FlightEvent::TrackDropped, FlightStatus::Failed, {}, 1);
+        }
+        m_pLastFmClient->getFlightRecorder().record(FlightEvent::TrackBuffered, FlightStatus::Ok, {}, 1);
+        if (m_pSubmissionLog) {
+            if (dropsOldest) {
+                // the log holds the same tracks as the buffer, it does not grow while offline
+                m_pSubmissionLog->rewrite(m_BufferedTrackInfos);
+            } else {
+                m_pSubmissionLog->append(info, timeAdded);
+            }
+        }
+    } catch (const logic_error& e) {
+        Log::error(e.what());
+    }
+}
+
+void LastFmScrobbler::submitBufferedTracks(bool force)
+{
+    if (m_pSubmissionSpool) {
+        submitSpooledTracks(force);
+        scheduleBatchDeadline();
+        return;
     }
 
     SubmissionInfoCollection tracksToSubmit;
     {
-        auto lock = std::scoped_lock(m_TrackInfosMutex);
+        auto lock = std::unique_lock(m_TrackInfosMutex);
+        if (m_BufferedTrackInfos.empty()) {
+            return;
+        }
+
+        if (!force && !m_BufferedTrackInfos.isFlushRequired(m_BatchPolicy, time(nullptr))) {
+            Log::info("Track info buffered: batch not complete");
+            lock.unlock();
+            scheduleBatchDeadline();
+            return;
+        }
+
         tracksToSubmit = m_BufferedTrackInfos;
     }
 
+    size_t processed = 0;
     try {
         if (m_Authenticated) {
-            m_pLastFmClient->submit(tracksToSubmit);
-            Log::info("Buffered tracks submitted");
-            m_BufferedTrackInfos.clear();
+            try {
+                submitTracks(tracksToSubmit);
+                processed = tracksToSubmit.size();
+                Log::info("Buffered tracks submitted");
+            } catch (const logic_error& e) {
+                Log::error("Submission of", tracksToSubmit.size(), "tracks failed, isolating the failing tracks:", e.what());
+                isolateFailedTracks([&tracksToSubmit](size_t first, size_t count) { return copyTracks(tracksToSubmit, first, count); }, tracksToSubmit.size(), processed);
+            }
         } else {
             Log::info("Track info buffered: not connected");
         }
     } catch (const BadSessionError&) {
+        removeBufferedTracks(processed);
         Log::info("Session has become invalid: starting new handshake");
         authenticateNow();
-        submitTrack(info);
+        submitBufferedTracks(force);
+        return;
     } catch (const ConnectionError&) {
-        m_Authenticated = false;
+        setAuthenticated(false);
+    }
+
+    removeBufferedTracks(processed);
+    scheduleBatchDeadline();
+}
+
+void LastFmScrobbler::removeBufferedTracks(size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    auto lock = std::scoped_lock(m_TrackInfosMutex);
+    m_BufferedTrackInfos.removeFront(count);
+    reportBufferedTracks(m_BufferedTrackInfos.size());
+    if (!m_pSubmissionLog) {
+        return;
+    }
+
+    try {
+        // the log only contains the tracks that are still buffered, it is
+        // replaced at once so a crash never loses the unacknowledged tracks
+        if (m_BufferedTrackInfos.empty()) {
+            m_pSubmissionLog->truncate();
+        } else {
+            m_pSubmissionLog->rewrite(m_BufferedTrackInfos);
+        }
     } catch (const logic_error& e) {
         Log::error(e.what());
     }
+}
 
-    m_TrackPlayTime = 0;
-    m_TrackResumeTime = m_CurrentTrackInfo.getTimeStarted();
+bool LastFmScrobbler::submitTracks(const SubmissionInfoCollection& tracks)
+{
+    if (canBeEncoded(tracks)) {
+        m_pLastFmClient->submit(tracks);
+        updateSubmissionStatistics(tracks);
+        return true;
+    }
+
+    SubmissionInfoCollection validTracks = tracks;
+    auto rejectedTracks = removeRejectedTracks(validTracks);
+    if (!validTracks.empty()) {
+        m_pLastFmClient->submit(validTracks);
+        updateSubmissionStatistics(validTracks);
+    }
+
+    // only after the submission, a failed batch is submitted again with the same tracks
+    addDeadLetters(rejectedTracks);
+    return !validTracks.empty();
+}
+
+void LastFmScrobbler::isolateFailedTracks(const TrackReader& readTracks, size_t count, size_t& processed)
+{
+    if (count < 2) {
+        Log::error("Submission of a single track failed, the track stays buffered");
+        return;
+    }
+
+    TrackIsolation isolation;
+    isolation.readTracks = readTracks;
+    // the parts are submitted in order, so the handled tracks are always at the front
+    auto finish = [this, &isolation, &processed] {
+        if (isolation.accepted) {
+            processed = isolation.handledTracks;
+            addDeadLetters(isolation.failedTracks);
+        }
+    };
+
+    try {
+        splitFailedTracks(isolation, 0, count);
+    } catch (...) {
+        finish();
+        throw;
+    }
+
+    finish();
+    if (!isolation.accepted) {
+        // no track is blamed when the server accepted none of them
+        Log::error("Submission failed for every part of the batch, the tracks stay buffered");
+    }
+}
+
+void LastFmScrobbler::splitFailedTracks(TrackIsolation& isolation, size_t first, size_t count)
+{
+    size_t half = count / 2;
+    submitIsolatedTracks(isolation, first, half);
+    submitIsolatedTracks(isolation, first + half, count - half);
+}
+
+void LastFmScrobbler::submitIsolatedTracks(TrackIsolation& isolation, size_t first, size_t count)
+{
+    if (isolation.stopped) {
+        return;
+    }
+
+    SubmissionInfoCollection tracks = isolation.readTracks(first, count);
+    try {
+        if (!tracks.empty() && submitTracks(tracks)) {
+            isolation.accepted = true;
+        }
+        isolation.handledTracks = first + count;
+    } catch (const logic_error& e) {
+        if (!isolation.accepted && isolation.failedTracks.size() >= MAX_FAILED_TRACKS_WITHOUT_ACCEPTED) {
+            isolation.stopped = true;
+        } else if (count == 1) {
+            Log::error("Submission failed:", tracks.getInfo(0).getArtist(), "-", tracks.getInfo(0).getTrack(), ":", e.what());
+            isolation.failedTracks.push_back(tracks.getInfo(0));
+            isolation.handledTracks = first + 1;
+        } else {
+            splitFailedTracks(isolation, first, count);
+        }
+    }
+}
+
+bool LastFmScrobbler::isolateFailedSpooledTracks(size_t count)
+{
+    // the failed page is at the start of the spool
+    auto readTracks = [this](size_t first, size_t count) {
+        SubmissionInfoCollection tracks;
+        m_pSubmissionSpool->readPage(first, tracks, count);
+        return tracks;
+    };
+
+    size_t processed = 0;
+    try {
+        isolateFailedTracks(readTracks, count, processed);
+    } catch (...) {
+        m_pSubmissionSpool->remove(processed);
+        reportBufferedTracks(m_pSubmissionSpool->size());
+        throw;
+    }
+
+    if (processed < count) {
+        m_pSubmissionSpool->remove(processed);
+        reportBufferedTracks(m_pSubmissionSpool->size());
+        return false;
+    }
+    return true;
+}
+
+void LastFmScrobbler::addDeadLetters(const std::vector<SubmissionInfo>& tracks)
+{
+    if (tracks.empty()) {
+        return;
+    }
+
+    for (auto& info : tracks) {
+        Log::error("Track moved to the dead-letter list:", info.getArtist(), "-", info.getTrack());
+        m_pLastFmClient->getFlightRecorder().record(FlightEvent::TrackRejected, FlightStatus::Failed, {}, 1);
+    }
+
+    time_t timeAdded = time(nullptr);
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    m_Statistics.tracksRejected += tracks.size();
+    for (auto& info : tracks) {
+        if (!m_pDeadLetterSpool) {
+            if (m_DeadLetters.size() == MAX_DEAD_LETTERS) {
+                m_DeadLetters.erase(m_DeadLetters.begin());
+            }
+            m_DeadLetters.push_back(info);
+            continue;
+        }
+
+        try {
+            if (!m_pDeadLetterSpool->enqueue(info, timeAdded)) {
+                Log::error("Dead-letter spool is full, track dropped:", info.getArtist(), "-", info.getTrack());
+            }
+        } catch (const logic_error& e) {
+            Log::error(e.what());
+        }
+    }
+
+    if (m_pDeadLetterSpool) {
+        m_pDeadLetterSpool->sync();
+    }
+}
+
+void LastFmScrobbler::setDeadLetterSpool(const std::string& path, uint64_t capacity)
+{
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    if (path.empty()) {
+        m_pDeadLetterSpool.reset();
+        return;
+    }
+
+    m_pDeadLetterSpool = std::make_unique<SubmissionSpool>(path, capacity);
+    if (!m_pDeadLetterSpool->empty()) {
+        Log::info("Dead-letter spool contains", m_pDeadLetterSpool->size(), "tracks");
+    }
+}
+
+std::vector<SubmissionInfo> LastFmScrobbler::getDeadLetters() const
+{
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    if (!m_pDeadLetterSpool) {
+        return m_DeadLetters;
+    }
+
+    std::vector<SubmissionInfo> deadLetters;
+    SubmissionInfoCollection page;
+    for (size_t offset = 0, count; (count = m_pDeadLetterSpool->readPage(offset, page)) > 0; offset += count) {
+        for (size_t i = 0; i < page.size(); ++i) {
+            deadLetters.push_back(page.getInfo(i));
+        }
+        page.clear();
+    }
+
+    return deadLetters;
+}
+
+void LastFmScrobbler::clearDeadLetters()
+{
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    m_DeadLetters.clear();
+    if (m_pDeadLetterSpool) {
+        m_pDeadLetterSpool->remove(m_pDeadLetterSpool->size());
+        m_pDeadLetterSpool->sync();
+    }
+}
+
+void LastFmScrobbler::submitSpooledTracks(bool force)
+{
+    // pages are removed from the spool after they were submitted, so only one drain may run
+    auto drainLock = std::scoped_lock(m_SpoolDrainMutex);
+
+    try {
+        drainSpool(force);
+    } catch (const BadSessionError&) {
+        Log::info("Session has become invalid: starting new handshake");
+        authenticateNow();
+        try {
+            drainSpool(force);
+        } catch (const BadSessionError&) {
+            Log::error("New session was rejected as well: retrying later");
+            setAuthenticated(false);
+        } catch (const ConnectionError&) {
+            setAuthenticated(false);
+        } catch (const logic_error& e) {
+            Log::error(e.what());
+        }
+    } catch (const ConnectionError&) {
+        setAuthenticated(false);
+    } catch (const logic_error& e) {
+        Log::error(e.what());
+    }
+
+    m_pSubmissionSpool->sync();
+}
+
+void LastFmScrobbler::drainSpool(bool force)
+{
+    struct Page {
+        SubmissionInfoCollection infos;
+        std::vector<SubmissionInfo> rejectedTracks;
+        size_t count {};
+        std::future<void> result;
+        std::exception_ptr error;
+    };
+
+    size_t offset = 0;
+    bool stopped = false;
+    auto readPage = [this, &offset, &stopped](Page& page) {
+        // the pages that were not read stay in the spool
+        if (isDrainStopped()) {
+            stopped = true;
+            return false;
+        }
+
+        page.count = m_pSubmissionSpool->readPage(offset, page.infos);
+        offset += page.count;
+        // serializes the page now, submit() uses the cached post data
+        page.rejectedTracks = removeRejectedTracks(page.infos);
+        return page.count > 0;
+    };
+
+    auto next = std::make_unique<Page>();
+    if (!readPage(*next)) {
+        return;
+    }
+
+    if (!force && !next->infos.isFlushRequired(m_BatchPolicy, time(nullptr))) {
+        Log::info("Track info spooled: batch not complete");
+        return;
+    }
+
+    if (!m_Authenticated) {
+        Log::info("Track info spooled: not connected");
+        return;
+    }
+
+    // waits for the request of the page, the error is kept until the page is committed
+    auto completePage = [this](Page& page) {
+        if (!page.result.valid()) {
+            return;
+        }
+
+        try {
+            page.result.get();
+            updateSubmissionStatistics(page.infos);
+        } catch (...) {
+            page.error = current_exception();
+        }
+    };
+
+    // the futures of the pages in flight wait for their request when the queue
+    // is destroyed, so an exception never leaves a request running
+    std::deque<std::unique_ptr<Page>> pagesInFlight;
+
+    // the pages after a failed page stay in the spool, the ones the server
+    // accepted are marked so they are not submitted again
+    auto markAcceptedPages = [this, &pagesInFlight, &completePage] {
+        size_t pageOffset = pagesInFlight.front()->count;
+        for (size_t i = 1; i < pagesInFlight.size(); ++i) {
+            Page& page = *pagesInFlight[i];
+            completePage(page);
+            if (!page.error) {
+                addDeadLetters(page.rejectedTracks);
+                page.rejectedTracks.clear();
+                m_pSubmissionSpool->markSubmitted(pageOffset, page.count);
+            }
+            pageOffset += page.count;
+        }
+    };
+
+    while (next || !pagesInFlight.empty()) {
+        while (next && pagesInFlight.size() < m_SubmissionPipelineDepth) {
+            if (!next->infos.empty()) {
+                next->result = std::async(std::launch::async, [this, pInfos = &next->infos] { m_pLastFmClient->submit(*pInfos); });
+            }
+            pagesInFlight.push_back(std::move(next));
+
+            next = std::make_unique<Page>();
+            if (!readPage(*next)) {
+                next.reset();
+            }
+        }
+
+        // pages are committed in order, the next page was serialized while the oldest was in flight
+        Page& oldest = *pagesInFlight.front();
+        completePage(oldest);
+        if (oldest.error) {
+            markAcceptedPages();
+            try {
+                rethrow_exception(oldest.error);
+            } catch (const logic_error& e) {
+                Log::error("Submission of", oldest.infos.size(), "spooled tracks failed, isolating the failing tracks:", e.what());
+                if (!isolateFailedSpooledTracks(oldest.count)) {
+                    // the rest of the page and the pages after it stay spooled
+                    return;
+                }
+                // the isolation submitted the whole page, including its tracks that can't be encoded
+                oldest.rejectedTracks.clear();
+            }
+        }
+        addDeadLetters(oldest.rejectedTracks);
+
+        m_pSubmissionSpool->remove(oldest.count);
+        reportBufferedTracks(m_pSubmissionSpool->size());
+        offset -= oldest.count;
+        pagesInFlight.pop_front();
+    }
+
+    if (stopped) {
+        Log::info("Shutdown deadline reached:", m_pSubmissionSpool->size(), "tracks left in the spool");
+        return;
+    }
+
+    Log::info("Spooled tracks submitted");
+}
+
+bool LastFmScrobbler::isDrainStopped() const
+{
+    return m_ShuttingDown && (steady_clock::now() >= m_ShutdownDeadline.load() || m_pLastFmClient->isAborted());
+}
+
+void LastFmScrobbler::updateSubmissionStatistics(const SubmissionInfoCollection& submittedTracks)
+{
+    time_t curTime = time(nullptr);
+
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    ++m_Statistics.submissionRequests;
+    m_Statistics.tracksSubmitted += submittedTracks.size();
+    for (size_t i = 0; i < submittedTracks.size(); ++i) {
+        auto delay = static_cast<uint64_t>(max<time_t>(0, curTime - submittedTracks.getTimeAdded(i)));
+        m_Statistics.scrobbleDelayTotalSecs += delay;
+        m_Statistics.scrobbleDelayMaxSecs = max(m_Statistics.scrobbleDelayMaxSecs, delay);
+    }
+}
+
+void LastFmScrobbler::reportBufferedTracks(size_t count)
+{
+    static MetricsGauge& gauge = MetricsRegistry::instance().gauge("lastfm_buffered_tracks", "Tracks waiting to be submitted");
+
+    // the gauge is shared by all scrobblers, every scrobbler adds its own change
+    int64_t previous = m_ReportedBufferedTracks.exchange(static_cast<int64_t>(count));
+    gauge.add(static_cast<int64_t>(count) - previous);
+    m_pLastFmClient->getFlightRecorder().setQueueDepth(count);
+    LASTFMLIB_TRACE(scrobbler__buffered, count);
+}
+
+void LastFmScrobbler::setAuthenticated(bool authenticated)
+{
+    bool previous = m_Authenticated.exchange(authenticated);
+    if (previous != authenticated) {
+        LASTFMLIB_TRACE(scrobbler__authenticated, authenticated ? 1 : 0);
+    }
+}
+
+void LastFmScrobbler::reportConnectionFailures(int count)
+{
+    static MetricsGauge& gauge = MetricsRegistry::instance().gauge("lastfm_reconnect_failures", "Consecutive failed connection attempts");
+
+    int64_t previous = m_ReportedConnectionFailures.exchange(count);
+    gauge.add(count - previous);
 }
@@ -23,16 +23,48 @@
 #ifndef LAST_FM_SCROBBLER_H
 #define LAST_FM_SCROBBLER_H
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
+#include <vector>
 
 #include "lastfmclient.h"
+#include "scrobblerlogimporter.h"
+#include "sessioncache.h"
 #include "submissioninfo.h"
 #include "submissioninfocollection.h"
+#include "submissionlog.h"
+#include "submissionspool.h"
+#include "timerwheel.h"
+
+/** The ScrobblerStatistics struct contains counters about the traffic
+ * generated by a LastFmScrobbler
+ */
+struct ScrobblerStatistics {
+    uint64_t nowPlayingSent {}; /**< \brief Now Playing updates sent to Last.fm */
+    uint64_t nowPlayingSuppressed {}; /**< \brief Now Playing updates that were coalesced or duplicates */
+    uint64_t submissionRequests {}; /**< \brief successful submission requests */
+    uint64_t tracksSubmitted {}; /**< \brief tracks submitted by those requests */
+    uint64_t scrobbleDelayTotalSecs {}; /**< \brief sum of the time the submitted tracks spent in the buffer */
+    uint64_t scrobbleDelayMaxSecs {}; /**< \brief longest time a submitted track spent in the buffer */
+    uint64_t tracksRejected {}; /**< \brief tracks that were rejected and moved to the dead-letter list */
+    uint64_t duplicatesFiltered {}; /**< \brief tracks that were not buffered because they were already submitted */
+    uint64_t rateLimitedRequests {}; /**< \brief requests that were delayed by the rate limit of the scrobbler */
+    uint64_t rateLimitWaitTotalMs {}; /**< \brief sum of the time requests waited for the rate limit */
+    uint64_t rateLimitWaitMaxMs {}; /**< \brief longest time a request waited for the rate limit */
+    uint64_t circuitRejectedRequests {}; /**< \brief requests that failed immediately because the endpoint was unreachable */
+};
 
 class LastFmScrobbler {
 public:
+    static constexpr uint64_t DEFAULT_DEAD_LETTER_CAPACITY = 10000; /**< \brief the default number of tracks in a dead-letter spool */
+
     /** Constructor which will use the Last.fm client identifier and version of lastfmlib
      * \param user Last.fm user name
      * \param pass Last.fm password for user
@@ -55,6 +87,7 @@ public:
      */
     LastFmScrobbler(std::string clientIdentifier, std::string clientVersion, std::string user, const std::string& pass, bool hashedPass, bool synchronous);
 
+    /** The destructor calls shutdown() with a timeout of 5 seconds */
     ~LastFmScrobbler();
 
     LastFmScrobbler(const LastFmScrobbler&) = delete;
@@ -71,6 +104,37 @@ public:
      */
     void setCommitOnlyMode(bool enabled);
 
+    /** Set the time a Now Playing update is held back before it is sent.
+     * When a new track is started within this window, the update of the
+     * previous track is dropped (only applies in asynchronous mode)
+     * \param window the debounce window, 0 sends updates immediately (default)
+     */
+    void setNowPlayingDebounce(std::chrono::milliseconds window);
+
+    /** Identical consecutive Now Playing updates within this time are
+     * not sent again
+     * \param ttl the suppression time, 0 disables suppression (default)
+     */
+    void setNowPlayingDuplicateTtl(std::chrono::seconds ttl);
+
+    /** Returns the traffic counters of the scrobbler
+     * \return a ScrobblerStatistics object
+     */
+    [[nodiscard]] ScrobblerStatistics getStatistics() const;
+
+    /** Set the policy that determines when buffered tracks are submitted,
+     * by default every track is submitted as soon as it is finished. In
+     * asynchronous mode a batch is also submitted when its oldest track
+     * reaches the maximum age while nothing is playing, in synchronous mode
+     * the age is checked on the next call.
+     * \param policy the batch policy
+     */
+    void setBatchPolicy(const SubmissionBatchPolicy& policy);
+
+    /** Submit all buffered tracks, regardless of the batch policy
+     */
+    void flush();
+
     /** Indicate that a new track has started playing, the previous track
      * will be submitted (if available) and the new track will be set as
      * Now Playing
@@ -96,47 +160,287 @@ public:
      */
     void setProxy(const std::string& server, uint32_t port, const std::string& username = "", const std::string& password = "") const;
 
+    /** Stop the scrobbler: new events are ignored from now on and the
+     * buffered tracks are submitted until the timeout expires. Requests,
+     * handshakes and rate limit waits that are still in progress at that
+     * time are aborted.
+     * \param timeout the maximum time the shutdown may take
+     * \return the tracks that could not be submitted, these are also
+     * passed to the handler set with setUnsentTracksHandler() and remain
+     * in the submission log when one is used. Tracks in the submission
+     * spool stay in the spool and are not returned, no new page of the
+     * spool is submitted after the timeout.
+     */
+    std::vector<SubmissionInfo> shutdown(std::chrono::milliseconds timeout);
+
+    /** Set a function that receives the tracks that could not be submitted
+     * when the scrobbler is shut down, so they can be persisted
+     * \param handler the function to call
+     */
+    void setUnsentTracksHandler(std::function<void(const std::vector<SubmissionInfo>&)> handler);
+
+    /** Set the url used for the handshake, allows to use another server
+     * that implements the Audioscrobbler protocol
+     * \param url the handshake url (default: http://post.audioscrobbler.com/)
+     */
+    void setHandshakeUrl(const std::string& url) const;
+
+    /** Limit the rate of the Now Playing and submission requests of this
+     * scrobbler, requests above the rate are delayed. To limit all the
+     * scrobblers in the process use RequestRateLimiter::instance().
+     * \param requestsPerSecond the sustained request rate, 0 disables the limit (default)
+     * \param burst the number of requests that can be sent at once
+     */
+    void setRateLimit(double requestsPerSecond, double burst) const;
+
+    /** Set the policy of the circuit breakers of the Last.fm endpoints.
+     * While an endpoint is unreachable, requests to it fail immediately
+     * and the tracks are buffered, a single probe request closes the
+     * circuit again once the endpoint is back.
+     * \param policy the circuit breaker policy
+     */
+    void setCircuitBreakerPolicy(const CircuitBreakerPolicy& policy) const;
+
+    /** Set a callback that receives the curl timing and the byte counts
+     * of every request to Last.fm, see LastFmClient::setTransferObserver()
+     * \param observer the callback, an empty function removes it
+     */
+    void setTransferObserver(LastFmClient::TransferObserver observer) const;
+
+    /** Record the byte counts and the curl timing phases of the requests
+     * to Last.fm in the metrics, see LastFmClient::setTransferMetricsEnabled()
+     * \param enabled true to record the transfer metrics
+     */
+    void setTransferMetricsEnabled(bool enabled) const;
+
+    /** Returns the recent protocol events of this scrobbler: requests,
+     * buffered, dropped and rejected tracks with their latency and the
+     * number of tracks waiting to be submitted
+     * \return the records of the flight recorder, oldest first
+     */
+    [[nodiscard]] std::vector<FlightRecord> getFlightRecords() const;
+
+    /** Write the flight recorder to the log, or pass it to the dump handler */
+    void dumpFlightRecorder() const;
+
+    /** Set a function that receives the flight recorder when it is dumped.
+     * Besides dumpFlightRecorder(), the recorder is dumped automatically
+     * when a new session is rejected as well, a request fails hard or a
+     * track is lost (at most once per minute).
+     * \param handler the function to call, an empty function writes the dumps to the log
+     */
+    void setFlightRecorderDumpHandler(FlightRecorder::DumpHandler handler) const;
+
+    /** Store the session in a file so it can be reused the next time the
+     * scrobbler is created. A cached session is used without a handshake,
+     * a new handshake is only performed when the server rejects it.
+     * \param path the location of the cache file, an empty path disables the cache
+     */
+    void setSessionCache(const std::string& path);
+
+    /** Keep the buffered tracks in a write-ahead log, so tracks that were
+     * not submitted yet survive a crash or restart. The tracks in an
+     * existing log are buffered again, tracks are removed from the log
+     * once the server accepted them. The log holds the same 50 tracks as
+     * the buffer, use a submission spool to keep a longer backlog. Call
+     * this before tracks are played.
+     * \param path the location of the log file, an empty path disables the log
+     * \param policy determines how often the log is synced to disk
+     * \exception std::logic_error when the log could not be opened
+     */
+    void setSubmissionLog(const std::string& path, SubmissionLogSyncPolicy policy = {});
+
+    /** Keep the buffered tracks in a memory-mapped spool file instead of
+     * memory, for devices that are offline for a long time. The buffer is
+     * no longer limited to 50 tracks, the spool is submitted in pages of
+     * 50 tracks once the connection is restored. The submission log is not
+     * used when a spool is set. Call this before tracks are played.
+     * \param path the location of the spool file, an empty path disables the spool
+     * \param capacity the maximum number of tracks in a new spool
+     * \exception std::logic_error when the spool could not be opened
+     */
+    void setSubmissionSpool(const std::string& path, uint64_t capacity = SubmissionSpool::DEFAULT_CAPACITY);
+
+    /** Set the number of submission requests that may be in flight while
+     * the spool is drained. The next page is always prepared while the
+     * previous requests are in progress, pages are removed from the spool
+     * in order. When a request fails, the pages after it that the server
+     * accepted stay in the spool until the failed page is removed, they are
+     * marked as submitted so they are not submitted again.
+     * \param depth the maximum number of requests in flight (1 by default)
+     */
+    void setSubmissionPipelineDepth(size_t depth);
+
+    /** Import the tracks of a .scrobbler.log file written by a portable
+     * player into the submission spool and submit them. Requires a
+     * submission spool, skipped tracks are not imported.
+     * \param path the location of the .scrobbler.log file
+     * \return the statistics of the import, tracks that are too large for
+     * the spool are counted as skipped
+     * \exception std::logic_error when no spool is set or the file could not be read
+     */
+    ScrobblerLogStatistics importScrobblerLog(const std::string& path);
+
+    /** Drop tracks with the same artist, title and start time as a track
+     * that was buffered recently, e.g. when a player reports a track twice.
+     * The filter is disabled by default.
+     * \param window the time tracks are remembered, 0 disables the filter
+     */
+    void setDuplicateFilter(std::chrono::seconds window);
+
+    /** Keep the dead-letter list in a spool file, so the rejected tracks
+     * survive a restart. Without a spool the list is kept in memory and
+     * holds at most 1000 tracks. Call this before tracks are played.
+     * \param path the location of the spool file, an empty path keeps the list in memory
+     * \param capacity the maximum number of tracks in a new spool
+     * \exception std::logic_error when the spool could not be opened
+     */
+    void setDeadLetterSpool(const std::string& path, uint64_t capacity = DEFAULT_DEAD_LETTER_CAPACITY);
+
+    /** When the server fails a submission, the batch is split in halves
+     * that are submitted separately until the tracks that fail on their
+     * own are isolated, so one bad track costs O(log n) extra requests.
+     * Those tracks, and user chosen tracks without a length that can't be
+     * submitted at all, are moved to a dead-letter list so they don't
+     * block the buffer. Tracks are only rejected when the server accepts
+     * other tracks of the batch, when it fails every part the batch stays
+     * buffered.
+     * \return the rejected tracks, oldest first
+     */
+    [[nodiscard]] std::vector<SubmissionInfo> getDeadLetters() const;
+    /** Empty the dead-letter list */
+    void clearDeadLetters();
+
 protected:
     explicit LastFmScrobbler(bool synchronous);
     std::shared_ptr<LastFmClient> m_pLastFmClient;
     /** \brief Last time a connection attempt was made */
-    time_t m_LastConnectionAttempt {};
+    std::atomic<time_t> m_LastConnectionAttempt {};
     /** \brief The time that the current track has been played, is set on pause */
     time_t m_TrackPlayTime { -1 };
     /** \brief The time that the current track was resumed after a pause */
     time_t m_TrackResumeTime {};
     /** \brief Thread handle of authentication thread (protected for testing) */
     std::thread m_AuthenticateThread;
-    /** \brief Thread handle of sendinfo thread (protected for testing) */
+    /** \brief Thread handle of the now playing lane (protected for testing) */
     std::thread m_SendInfoThread;
-    /** \brief Thread handle of finishPlaying thread (protected for testing) */
-    std::thread m_FinishPlayingThread;
+    /** \brief Thread handle of the submission lane (protected for testing) */
+    std::thread m_SubmissionThread;
 
 private:
+    struct QueuedSubmission {
+        std::optional<SubmissionInfo> track;
+        bool force {};
+    };
+
+    // returns a part of the tracks that are isolated: the number of the first track and the number of tracks
+    using TrackReader = std::function<SubmissionInfoCollection(size_t, size_t)>;
+
+    struct TrackIsolation {
+        TrackReader readTracks;
+        std::vector<SubmissionInfo> failedTracks;
+        size_t handledTracks {};
+        bool accepted {};
+        bool stopped {};
+    };
+
     void authenticateIfNecessary();
     void authenticateNow();
+    bool restoreCachedSession();
     bool trackCanBeCommited(const SubmissionInfo& info);
     [[nodiscard]] bool canReconnect() const;
+    void scheduleReconnect();
+    void scheduleBatchDeadline();
+    void batchDeadlineExpired();
     void submitTrack(const SubmissionInfo& info);
-    void setNowPlaying();
+    std::optional<SubmissionInfo> takeCommittableTrack(const SubmissionInfo& info);
+    void bufferTrack(const SubmissionInfo& info);
+    void submitBufferedTracks(bool force);
+    void removeBufferedTracks(size_t count);
+    bool submitTracks(const SubmissionInfoCollection& tracks);
+    void isolateFailedTracks(const TrackReader& readTracks, size_t count, size_t& processed);
+    void splitFailedTracks(TrackIsolation& isolation, size_t first, size_t count);
+    void submitIsolatedTracks(TrackIsolation& isolation, size_t first, size_t count);
+    bool isolateFailedSpooledTracks(size_t count);
+    void addDeadLetters(const std::vector<SubmissionInfo>& tracks);
+    void submitSpooledTracks(bool force);
+    void drainSpool(bool force);
+    [[nodiscard]] bool isDrainStopped() const;
+    void updateSubmissionStatistics(const SubmissionInfoCollection& submittedTracks);
+    void reportBufferedTracks(size_t count);
+    void reportConnectionFailures(int count);
+    void setAuthenticated(bool authenticated);
+    void setNowPlaying(const SubmissionInfo& info, uint64_t generation);
+    bool waitForNowPlayingDebounce(uint64_t generation);
+    [[nodiscard]] bool isDuplicateNowPlaying(const NowPlayingInfo& info) const;
+    void suppressNowPlaying(const std::string& reason);
 
+    void abortRequests();
+    void startThread(std::thread& thread, std::function<void()> function);
     void authenticateThread();
-    void sendInfoThread();
-    void finishPlayingThread();
+    void startNowPlayingLane();
+    void nowPlayingLane();
+    void queueSubmission(std::optional<SubmissionInfo> track, bool force);
+    void submissionLane();
 
     SubmissionInfo m_PreviousTrackInfo;
     SubmissionInfo m_CurrentTrackInfo;
     SubmissionInfoCollection m_BufferedTrackInfos;
 
-    bool m_Authenticated {};
-    int m_HardConnectionFailureCount {};
+    std::atomic<bool> m_Authenticated {};
+    // written by the handshake of a lane or the authentication thread, read by the player thread
+    std::atomic<int> m_HardConnectionFailureCount {};
+    std::atomic<int64_t> m_ReportedBufferedTracks {};
+    std::atomic<int64_t> m_ReportedConnectionFailures {};
+    std::atomic<std::chrono::milliseconds> m_ReconnectDelay {};
+    TimerWheel::TimerId m_ReconnectTimer {};
+    TimerWheel::TimerId m_BatchDeadlineTimer {};
+    std::atomic<bool> m_Authenticating {};
+    std::atomic<bool> m_ShuttingDown {};
+    std::atomic<std::chrono::steady_clock::time_point> m_ShutdownDeadline {};
+    std::mutex m_AuthenticateThreadMutex;
+    std::mutex m_HandshakeMutex;
     std::condition_variable m_AuthenticatedCondition;
     std::mutex m_AuthenticatedMutex;
     std::mutex m_TrackInfosMutex;
+    SubmissionBatchPolicy m_BatchPolicy;
+
+    uint64_t m_NowPlayingGeneration {};
+    uint64_t m_NowPlayingHandledGeneration {};
+    bool m_NowPlayingLaneActive {};
+    SubmissionInfo m_NowPlayingInfo;
+    std::chrono::milliseconds m_NowPlayingDebounce {};
+    std::chrono::seconds m_NowPlayingDuplicateTtl {};
+    std::condition_variable m_NowPlayingCondition;
+    std::mutex m_NowPlayingMutex;
+    NowPlayingInfo m_LastNowPlayingInfo;
+    std::chrono::steady_clock::time_point m_LastNowPlayingTime;
+
+    std::deque<QueuedSubmission> m_SubmissionQueue;
+    bool m_SubmissionLaneActive {};
+    std::mutex m_SubmissionQueueMutex;
+
+    ScrobblerStatistics m_Statistics;
+    std::vector<SubmissionInfo> m_DeadLetters;
+    std::unique_ptr<SubmissionSpool> m_pDeadLetterSpool;
+    mutable std::mutex m_StatisticsMutex;
 
     std::string m_Username;
     std::string m_Password;
 
+    std::unique_ptr<SessionCache> m_pSessionCache;
+    std::unique_ptr<SubmissionLog> m_pSubmissionLog;
+    std::shared_ptr<SubmissionDedupIndex> m_pDedupIndex;
+    std::unique_ptr<SubmissionSpool> m_pSubmissionSpool;
+    std::mutex m_SpoolDrainMutex;
+    size_t m_SubmissionPipelineDepth { 1 };
+    bool m_SessionCacheChecked {};
+
+    std::function<void(const std::vector<SubmissionInfo>&)> m_UnsentTracksHandler;
+    int m_RunningThreads {};
+    std::condition_variable m_ThreadsFinished;
+    std::mutex m_ThreadsMutex;
+
     bool m_Synchronous;
     bool m_CommitOnly {};
 };
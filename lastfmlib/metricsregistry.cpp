@@ -0,0 +1,279 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "metricsregistry.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+using namespace std::chrono;
+
+// the Prometheus buckets are powers of two microseconds, from 16 us up to 64 s
+static const unsigned int MIN_PROMETHEUS_BUCKET_EXPONENT = 4;
+static const unsigned int MAX_PROMETHEUS_BUCKET_EXPONENT = 26;
+
+// values below 8 get a bucket each, above that a power of two is split in 8 buckets
+static const unsigned int SUB_BUCKET_BITS = 3;
+
+uint64_t HistogramSnapshot::percentile(double fraction) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(fraction * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return LatencyHistogram::bucketUpperBound(i);
+        }
+    }
+    return LatencyHistogram::bucketUpperBound(buckets.size() - 1);
+}
+
+uint64_t HistogramSnapshot::countAtMost(uint64_t microseconds) const
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < buckets.size() && LatencyHistogram::bucketUpperBound(i) <= microseconds; ++i) {
+        result += buckets[i];
+    }
+    return result;
+}
+
+void LatencyHistogram::record(std::chrono::microseconds duration)
+{
+    auto value = static_cast<uint64_t>(max<int64_t>(duration.count(), 0));
+    m_Buckets[bucketIndex(value)].fetch_add(1, memory_order_relaxed);
+    m_Sum.fetch_add(value, memory_order_relaxed);
+    m_Count.fetch_add(1, memory_order_relaxed);
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    HistogramSnapshot snapshot;
+    snapshot.buckets.reserve(BUCKET_COUNT);
+    for (auto& bucket : m_Buckets) {
+        snapshot.buckets.push_back(bucket.load(memory_order_relaxed));
+        snapshot.count += snapshot.buckets.back();
+    }
+    // the count is taken from the buckets so it is consistent with them
+    snapshot.sum = m_Sum.load(memory_order_relaxed);
+    return snapshot;
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t microseconds)
+{
+    if (microseconds <= SUB_BUCKETS) {
+        return microseconds;
+    }
+
+    // the buckets include their upper bound, so a value is placed by the value below it
+    uint64_t below = microseconds - 1;
+    unsigned int exponent = 63 - static_cast<unsigned int>(__builtin_clzll(below));
+    size_t subBucket = (below >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return min<size_t>((exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket + 1, BUCKET_COUNT - 1);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    if (index <= SUB_BUCKETS) {
+        return index;
+    }
+
+    --index;
+    auto exponent = static_cast<unsigned int>(index / SUB_BUCKETS + SUB_BUCKET_BITS - 1);
+    return (SUB_BUCKETS + index % SUB_BUCKETS + 1) << (exponent - SUB_BUCKET_BITS);
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsCounter& MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    return *getMetric(name, help, labels, MetricSnapshot::Type::Counter).pCounter;
+}
+
+MetricsGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    return *getMetric(name, help, labels, MetricSnapshot::Type::Gauge).pGauge;
+}
+
+LatencyHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    return *getMetric(name, help, labels, MetricSnapshot::Type::Histogram).pHistogram;
+}
+
+MetricsRegistry::Metric& MetricsRegistry::getMetric(const std::string& name, const std::string& help, const MetricLabels& labels, MetricSnapshot::Type type)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    for (auto& metric : m_Metrics) {
+        if (metric.name == name && metric.labels == labels) {
+            if (metric.type != type) {
+                throw logic_error("Metric " + name + " was registered with another type");
+            }
+            return metric;
+        }
+    }
+
+    Metric& metric = m_Metrics.emplace_back();
+    metric.name = name;
+    metric.help = help;
+    metric.labels = labels;
+    metric.type = type;
+    switch (type) {
+    case MetricSnapshot::Type::Counter:
+        metric.pCounter = make_unique<MetricsCounter>();
+        break;
+    case MetricSnapshot::Type::Gauge:
+        metric.pGauge = make_unique<MetricsGauge>();
+        break;
+    case MetricSnapshot::Type::Histogram:
+        metric.pHistogram = make_unique<LatencyHistogram>();
+        break;
+    }
+    return metric;
+}
+
+std::vector<MetricSnapshot> MetricsRegistry::snapshot() const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+
+    vector<MetricSnapshot> snapshots;
+    snapshots.reserve(m_Metrics.size());
+    for (auto& metric : m_Metrics) {
+        MetricSnapshot& snapshot = snapshots.emplace_back();
+        snapshot.name = metric.name;
+        snapshot.help = metric.help;
+        snapshot.labels = metric.labels;
+        snapshot.type = metric.type;
+        switch (metric.type) {
+        case MetricSnapshot::Type::Counter:
+            snapshot.value = static_cast<int64_t>(metric.pCounter->value());
+            break;
+        case MetricSnapshot::Type::Gauge:
+            snapshot.value = metric.pGauge->value();
+            break;
+        case MetricSnapshot::Type::Histogram:
+            snapshot.histogram = metric.pHistogram->snapshot();
+            snapshot.value = static_cast<int64_t>(snapshot.histogram.count);
+            break;
+        }
+    }
+    return snapshots;
+}
+
+static string escapeLabelValue(const string& value)
+{
+    string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static string formatLabels(const MetricLabels& labels, const string& extraLabel = "")
+{
+    if (labels.empty() && extraLabel.empty()) {
+        return "";
+    }
+
+    string result = "{";
+    for (auto& [name, value] : labels) {
+        if (result.size() > 1) {
+            result += ",";
+        }
+        result += name + "=\"" + escapeLabelValue(value) + "\"";
+    }
+    if (!extraLabel.empty()) {
+        if (result.size() > 1) {
+            result += ",";
+        }
+        result += extraLabel;
+    }
+    return result + "}";
+}
+
+static const char* typeName(MetricSnapshot::Type type)
+{
+    switch (type) {
+    case MetricSnapshot::Type::Counter:
+        return "counter";
+    case MetricSnapshot::Type::Gauge:
+        return "gauge";
+    case MetricSnapshot::Type::Histogram:
+        return "histogram";
+    }
+    return "untyped";
+}
+
+static void writeSample(stringstream& text, const MetricSnapshot& metric)
+{
+    if (metric.type != MetricSnapshot::Type::Histogram) {
+        text << metric.name << formatLabels(metric.labels) << " " << metric.value << "\n";
+        return;
+    }
+
+    const HistogramSnapshot& histogram = metric.histogram;
+    for (unsigned int exponent = MIN_PROMETHEUS_BUCKET_EXPONENT; exponent <= MAX_PROMETHEUS_BUCKET_EXPONENT; ++exponent) {
+        uint64_t bound = uint64_t(1) << exponent;
+        stringstream le;
+        le << "le=\"" << static_cast<double>(bound) / 1e6 << "\"";
+        text << metric.name << "_bucket" << formatLabels(metric.labels, le.str()) << " " << histogram.countAtMost(bound) << "\n";
+    }
+    text << metric.name << "_bucket" << formatLabels(metric.labels, "le=\"+Inf\"") << " " << histogram.count << "\n"
+         << metric.name << "_sum" << formatLabels(metric.labels) << " " << static_cast<double>(histogram.sum) / 1e6 << "\n"
+         << metric.name << "_count" << formatLabels(metric.labels) << " " << histogram.count << "\n";
+}
+
+std::string MetricsRegistry::toPrometheusText() const
+{
+    vector<MetricSnapshot> snapshots = snapshot();
+
+    stringstream text;
+    text << setprecision(9);
+
+    // the samples of a metric are grouped under one HELP and TYPE line
+    vector<bool> written(snapshots.size());
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+        if (written[i]) {
+            continue;
+        }
+
+        text << "# HELP " << snapshots[i].name << " " << snapshots[i].help << "\n"
+             << "# TYPE " << snapshots[i].name << " " << typeName(snapshots[i].type) << "\n";
+        for (size_t j = i; j < snapshots.size(); ++j) {
+            if (!written[j] && snapshots[j].name == snapshots[i].name) {
+                writeSample(text, snapshots[j]);
+                written[j] = true;
+            }
+        }
+    }
+
+    return text.str();
+}
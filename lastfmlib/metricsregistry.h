@@ -0,0 +1,189 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file metricsregistry.h
+ * @brief Contains the MetricsRegistry class and the metric types
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef METRICS_REGISTRY_H
+#define METRICS_REGISTRY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** \brief the labels of a metric as name, value pairs */
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/** The MetricsCounter class is a monotonically increasing counter */
+class MetricsCounter {
+public:
+    /** \brief add to the counter */
+    void increment(uint64_t amount = 1) { m_Value.fetch_add(amount, std::memory_order_relaxed); }
+    /** \brief returns the value of the counter */
+    [[nodiscard]] uint64_t value() const { return m_Value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_Value {};
+};
+
+/** The MetricsGauge class is a value that can go up and down */
+class MetricsGauge {
+public:
+    /** \brief add to the gauge, use a negative amount to subtract */
+    void add(int64_t amount) { m_Value.fetch_add(amount, std::memory_order_relaxed); }
+    /** \brief set the gauge */
+    void set(int64_t value) { m_Value.store(value, std::memory_order_relaxed); }
+    /** \brief returns the value of the gauge */
+    [[nodiscard]] int64_t value() const { return m_Value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_Value {};
+};
+
+/** The HistogramSnapshot struct contains the bucket counts of a LatencyHistogram */
+struct HistogramSnapshot {
+    std::vector<uint64_t> buckets; /**< \brief the number of values in every bucket */
+    uint64_t count {}; /**< \brief the number of recorded values */
+    uint64_t sum {}; /**< \brief the sum of the recorded values in microseconds */
+
+    /** Returns the value at or below which a fraction of the recorded values falls
+     * \param fraction the fraction (0.99 for the 99th percentile)
+     * \return the upper bound of the bucket that contains the percentile in microseconds
+     */
+    [[nodiscard]] uint64_t percentile(double fraction) const;
+    /** Returns the number of recorded values at or below a bound, like the
+     * le buckets of Prometheus. The count is exact when the bound is the
+     * upper bound of a bucket, e.g. a power of two.
+     * \param microseconds the bound in microseconds
+     * \return the number of values that are not larger than the bound
+     */
+    [[nodiscard]] uint64_t countAtMost(uint64_t microseconds) const;
+};
+
+/** The LatencyHistogram class records durations with a bounded relative
+ * error, like an HDR histogram. Every power of two is divided into 8
+ * linear buckets, so a recorded value is off by at most 12.5%. A bucket
+ * includes its upper bound, so the powers of two are upper bounds.
+ * Durations are recorded in microseconds, up to 2^40 microseconds.
+ */
+class LatencyHistogram {
+public:
+    /** \brief the number of linear buckets per power of two */
+    static constexpr unsigned int SUB_BUCKETS = 8;
+    /** \brief the total number of buckets */
+    static constexpr size_t BUCKET_COUNT = (40 - 2 + 1) * SUB_BUCKETS;
+
+    /** \brief record a duration */
+    void record(std::chrono::microseconds duration);
+    /** \brief returns the current bucket counts */
+    [[nodiscard]] HistogramSnapshot snapshot() const;
+
+    /** \brief returns the bucket of a value in microseconds */
+    static size_t bucketIndex(uint64_t microseconds);
+    /** \brief returns the largest value in microseconds that falls in a bucket, the bucket includes this value */
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_Buckets {};
+    std::atomic<uint64_t> m_Count {};
+    std::atomic<uint64_t> m_Sum {};
+};
+
+/** The MetricSnapshot struct contains the value of a metric at the time
+ * the snapshot was taken
+ */
+struct MetricSnapshot {
+    /** The type of the metric */
+    enum class Type {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    std::string name; /**< \brief the name of the metric */
+    std::string help; /**< \brief the description of the metric */
+    MetricLabels labels; /**< \brief the labels of the metric */
+    Type type {}; /**< \brief the type of the metric */
+    int64_t value {}; /**< \brief the value of a counter or gauge */
+    HistogramSnapshot histogram; /**< \brief the buckets of a histogram */
+};
+
+/** The MetricsRegistry class contains the metrics of lastfmlib. Metrics
+ * are created once and live as long as the registry, so updating them
+ * only takes an atomic operation. Only the updates are lock-free:
+ * registering a metric and taking a snapshot lock the registry and a
+ * lookup searches all metrics, so metrics are registered once at startup
+ * and the references are kept. The metrics of all scrobblers in the
+ * process are kept in the registry returned by instance().
+ */
+class MetricsRegistry {
+public:
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    /** \brief returns the registry shared by all clients and scrobblers */
+    static MetricsRegistry& instance();
+
+    /** Get or create a counter, this locks the registry so keep the
+     * returned reference instead of calling this for every update
+     * \param name the name of the metric
+     * \param help the description of the metric
+     * \param labels the labels that distinguish this counter from others with the same name
+     * \return the counter, the reference stays valid as long as the registry
+     */
+    MetricsCounter& counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    /** Get or create a gauge, see counter() */
+    MetricsGauge& gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    /** Get or create a histogram, see counter() */
+    LatencyHistogram& histogram(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+    /** \brief returns the current value of all metrics, in the order they were created */
+    [[nodiscard]] std::vector<MetricSnapshot> snapshot() const;
+
+    /** Returns the metrics in the Prometheus text exposition format.
+     * Histograms are exposed in seconds with a bucket for every power of two microseconds.
+     */
+    [[nodiscard]] std::string toPrometheusText() const;
+
+private:
+    struct Metric {
+        std::string name;
+        std::string help;
+        MetricLabels labels;
+        MetricSnapshot::Type type;
+        std::unique_ptr<MetricsCounter> pCounter;
+        std::unique_ptr<MetricsGauge> pGauge;
+        std::unique_ptr<LatencyHistogram> pHistogram;
+    };
+
+    Metric& getMetric(const std::string& name, const std::string& help, const MetricLabels& labels, MetricSnapshot::Type type);
+
+    std::deque<Metric> m_Metrics;
+    mutable std::mutex m_Mutex;
+};
+
+#endif
@@ -124,3 +124,18 @@ const std::string& NowPlayingInfo::getMusicBrainzId() const
 {
     return m_MusicBrainzId;
 }
+
+bool NowPlayingInfo::operator==(const NowPlayingInfo& other) const
+{
+    return m_Artist == other.m_Artist
+        && m_Track == other.m_Track
+        && m_Album == other.m_Album
+        && m_TrackLengthInSecs == other.m_TrackLengthInSecs
+        && m_TrackNr == other.m_TrackNr
+        && m_MusicBrainzId == other.m_MusicBrainzId;
+}
+
+bool NowPlayingInfo::operator!=(const NowPlayingInfo& other) const
+{
+    return !(*this == other);
+}
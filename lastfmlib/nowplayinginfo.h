@@ -78,6 +78,11 @@ public:
     /** \brief returns Music Brainz Id */
     [[nodiscard]] const std::string& getMusicBrainzId() const;
 
+    /** \brief returns true if both objects describe the same track */
+    bool operator==(const NowPlayingInfo& other) const;
+    /** \brief returns true if the objects describe a different track */
+    bool operator!=(const NowPlayingInfo& other) const;
+
 private:
     std::string m_Artist; /**< \brief the artist */
     std::string m_Track; /**< \brief the track title */
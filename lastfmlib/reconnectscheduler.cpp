@@ -0,0 +1,147 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "reconnectscheduler.h"
+
+#include <algorithm>
+#include <random>
+
+#include "utils/log.h"
+
+using namespace std;
+using namespace std::chrono;
+
+ReconnectScheduler::ReconnectScheduler(milliseconds tickDuration)
+: m_TickDuration(max(tickDuration, milliseconds(1)))
+, m_StartTime(steady_clock::now())
+{
+}
+
+ReconnectScheduler::~ReconnectScheduler()
+{
+    {
+        auto lock = std::scoped_lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_Condition.notify_all();
+
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+ReconnectScheduler& ReconnectScheduler::instance()
+{
+    static ReconnectScheduler scheduler;
+    return scheduler;
+}
+
+TimerWheel::TimerId ReconnectScheduler::schedule(milliseconds delay, TimerWheel::Callback callback)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    if (!m_Thread.joinable()) {
+        m_Thread = std::thread([this] { schedulerThread(); });
+    }
+
+    if (m_Wheel.size() == 0) {
+        // the wheel does not tick while it is empty, bring it up to date
+        m_Wheel.advance(currentTick() - m_Wheel.getCurrentTick());
+    }
+
+    // round up so the callback never fires early
+    auto ticks = static_cast<uint64_t>((delay + m_TickDuration - milliseconds(1)) / m_TickDuration);
+    auto id = m_Wheel.schedule(ticks, std::move(callback));
+    m_Condition.notify_all();
+    return id;
+}
+
+void ReconnectScheduler::cancel(TimerWheel::TimerId id)
+{
+    if (id == 0) {
+        return;
+    }
+
+    auto lock = std::unique_lock(m_Mutex);
+    if (m_Wheel.cancel(id) || this_thread::get_id() == m_Thread.get_id()) {
+        return;
+    }
+
+    auto iter = find_if(m_ExpiredTimers.begin(), m_ExpiredTimers.end(), [id](const auto& timer) { return timer.id == id; });
+    if (iter != m_ExpiredTimers.end()) {
+        m_ExpiredTimers.erase(iter);
+        return;
+    }
+
+    m_Condition.wait(lock, [this, id] { return m_RunningTimer != id; });
+}
+
+milliseconds ReconnectScheduler::backoffDelay(int failureCount, milliseconds baseDelay, milliseconds maxDelay)
+{
+    static thread_local std::mt19937_64 generator { std::random_device()() };
+
+    // stop doubling once the cap is reached to avoid overflow
+    milliseconds ceiling = baseDelay;
+    for (int i = 0; i < failureCount && ceiling < maxDelay; ++i) {
+        ceiling *= 2;
+    }
+    ceiling = min(ceiling, maxDelay);
+
+    std::uniform_int_distribution<milliseconds::rep> distribution(0, ceiling.count());
+    return milliseconds(distribution(generator));
+}
+
+uint64_t ReconnectScheduler::currentTick() const
+{
+    return static_cast<uint64_t>((steady_clock::now() - m_StartTime) / m_TickDuration);
+}
+
+void ReconnectScheduler::schedulerThread()
+{
+    auto lock = std::unique_lock(m_Mutex);
+
+    while (!m_Stop) {
+        if (m_Wheel.size() == 0) {
+            m_Condition.wait(lock, [this] { return m_Stop || m_Wheel.size() > 0; });
+            continue;
+        }
+
+        auto nextTick = m_StartTime + m_TickDuration * (m_Wheel.getCurrentTick() + 1);
+        if (m_Condition.wait_until(lock, nextTick, [this] { return m_Stop; })) {
+            break;
+        }
+
+        // also catches up on ticks that passed while callbacks were executing
+        for (auto& timer : m_Wheel.advance(currentTick() - m_Wheel.getCurrentTick())) {
+            m_ExpiredTimers.push_back(std::move(timer));
+        }
+
+        while (!m_ExpiredTimers.empty()) {
+            TimerWheel::ExpiredTimer timer = std::move(m_ExpiredTimers.front());
+            m_ExpiredTimers.pop_front();
+            m_RunningTimer = timer.id;
+            lock.unlock();
+
+            try {
+                timer.callback();
+            } catch (const std::exception& e) {
+                Log::error("Scheduled callback failed:", e.what());
+            }
+
+            lock.lock();
+            m_RunningTimer = 0;
+            m_Condition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,90 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file reconnectscheduler.h
+ * @brief Contains the ReconnectScheduler class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef RECONNECT_SCHEDULER_H
+#define RECONNECT_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "timerwheel.h"
+
+/** The ReconnectScheduler class runs timers on a background thread using
+ * a TimerWheel. It is shared by all scrobblers in the process so many
+ * sessions can wait for a reconnection without a thread each. Callbacks
+ * are executed on the scheduler thread and should return quickly.
+ */
+class ReconnectScheduler {
+public:
+    /** Constructor
+     * \param tickDuration the resolution of the timers
+     */
+    explicit ReconnectScheduler(std::chrono::milliseconds tickDuration = std::chrono::milliseconds(100));
+    ~ReconnectScheduler();
+
+    ReconnectScheduler(const ReconnectScheduler&) = delete;
+    ReconnectScheduler& operator=(const ReconnectScheduler&) = delete;
+
+    /** \brief returns the scheduler shared by all scrobblers */
+    static ReconnectScheduler& instance();
+
+    /** Schedule a callback
+     * \param delay the time after which the callback is executed
+     * \param callback the function to execute
+     * \return the id of the timer that can be used to cancel it
+     */
+    TimerWheel::TimerId schedule(std::chrono::milliseconds delay, TimerWheel::Callback callback);
+
+    /** Cancel a timer, if the callback is currently executing this call
+     * blocks until it has finished (unless called from the callback itself)
+     * \param id the id of the timer
+     */
+    void cancel(TimerWheel::TimerId id);
+
+    /** Computes a reconnection delay using exponential backoff with full
+     * jitter: a random delay between 0 and min(maxDelay, baseDelay * 2^failureCount)
+     * \param failureCount the number of consecutive failures
+     * \param baseDelay the delay cap after the first failure
+     * \param maxDelay the maximum delay
+     * \return the delay
+     */
+    static std::chrono::milliseconds backoffDelay(int failureCount, std::chrono::milliseconds baseDelay, std::chrono::milliseconds maxDelay);
+
+private:
+    [[nodiscard]] uint64_t currentTick() const;
+    void schedulerThread();
+
+    TimerWheel m_Wheel;
+    std::chrono::milliseconds m_TickDuration;
+    std::chrono::steady_clock::time_point m_StartTime;
+    std::deque<TimerWheel::ExpiredTimer> m_ExpiredTimers;
+    TimerWheel::TimerId m_RunningTimer {};
+    bool m_Stop {};
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::thread m_Thread;
+};
+
+#endif
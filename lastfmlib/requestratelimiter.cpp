@@ -0,0 +1,59 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "requestratelimiter.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+
+RequestRateLimiter::RequestRateLimiter(double requestsPerSecond, double burst)
+: m_Rate(requestsPerSecond, burst)
+{
+}
+
+RequestRateLimiter& RequestRateLimiter::instance()
+{
+    static RequestRateLimiter limiter;
+    return limiter;
+}
+
+void RequestRateLimiter::configure(double requestsPerSecond, double burst)
+{
+    m_Rate.setRate(requestsPerSecond, burst);
+}
+
+steady_clock::duration RequestRateLimiter::reserve()
+{
+    auto wait = m_Rate.reserve();
+    auto waitInUs = duration_cast<microseconds>(wait);
+
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    ++m_Statistics.requests;
+    if (wait > steady_clock::duration::zero()) {
+        ++m_Statistics.delayedRequests;
+        m_Statistics.totalWait += waitInUs;
+        m_Statistics.maxWait = max(m_Statistics.maxWait, waitInUs);
+    }
+    return wait;
+}
+
+RateLimiterStatistics RequestRateLimiter::getStatistics() const
+{
+    auto lock = std::scoped_lock(m_StatisticsMutex);
+    return m_Statistics;
+}
@@ -0,0 +1,78 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file requestratelimiter.h
+ * @brief Contains the RequestRateLimiter class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef REQUEST_RATE_LIMITER_H
+#define REQUEST_RATE_LIMITER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include "tokenbucket.h"
+
+/** The RateLimiterStatistics struct describes the time requests had to
+ * wait for the rate limit
+ */
+struct RateLimiterStatistics {
+    uint64_t requests {}; /**< \brief requests that passed the limiter */
+    uint64_t delayedRequests {}; /**< \brief requests that had to wait */
+    std::chrono::microseconds totalWait {}; /**< \brief sum of the waiting time of all requests */
+    std::chrono::microseconds maxWait {}; /**< \brief longest time a request had to wait */
+};
+
+/** The RequestRateLimiter class limits the rate of the requests to the
+ * Last.fm servers. Requests above the rate are not rejected but delayed,
+ * they are served in the order they arrived. Every LastFmClient has its
+ * own limiter and all clients share the process-wide limiter.
+ */
+class RequestRateLimiter {
+public:
+    /** Constructor
+     * \param requestsPerSecond the sustained request rate, 0 disables the limit
+     * \param burst the number of requests that can be sent at once
+     */
+    explicit RequestRateLimiter(double requestsPerSecond = 0, double burst = 1);
+
+    /** \brief returns the rate limiter shared by all clients (unlimited by default) */
+    static RequestRateLimiter& instance();
+
+    /** Change the limit
+     * \param requestsPerSecond the sustained request rate, 0 disables the limit
+     * \param burst the number of requests that can be sent at once
+     */
+    void configure(double requestsPerSecond, double burst);
+
+    /** Reserve the slot for a request
+     * \return the time the caller has to wait before sending the request
+     */
+    std::chrono::steady_clock::duration reserve();
+
+    /** \brief returns the waiting time statistics */
+    [[nodiscard]] RateLimiterStatistics getStatistics() const;
+
+private:
+    TokenBucket m_Rate;
+    RateLimiterStatistics m_Statistics;
+    mutable std::mutex m_StatisticsMutex;
+};
+
+#endif
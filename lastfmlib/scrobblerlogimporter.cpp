@@ -0,0 +1,288 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "scrobblerlogimporter.h"
+#include "submissionrecord.h"
+
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static const size_t LINES_PER_BLOCK = 64 * 1024;
+static const size_t LINES_PER_TASK = 4096;
+static const size_t FIELD_COUNT = 8;
+
+namespace {
+class MappedFile {
+public:
+    explicit MappedFile(const string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw logic_error("Failed to open scrobbler log: " + path);
+        }
+
+        struct stat fileInfo;
+        if (fstat(fd, &fileInfo) != 0) {
+            close(fd);
+            throw logic_error("Failed to open scrobbler log: " + path);
+        }
+
+        m_Size = static_cast<size_t>(fileInfo.st_size);
+        if (m_Size > 0) {
+            void* pData = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (pData == MAP_FAILED) {
+                close(fd);
+                throw logic_error("Failed to map scrobbler log: " + path);
+            }
+            madvise(pData, m_Size, MADV_SEQUENTIAL);
+            m_pData = static_cast<const char*>(pData);
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (m_pData) {
+            munmap(const_cast<char*>(m_pData), m_Size);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return m_pData; }
+    size_t size() const { return m_Size; }
+
+private:
+    const char* m_pData {};
+    size_t m_Size {};
+};
+
+template <typename Number>
+bool parseNumber(string_view field, Number& value)
+{
+    auto result = from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == errc() && result.ptr == field.data() + field.size();
+}
+
+// runs function(index) for every index in [0, count) on the given number of threads,
+// the first exception is rethrown once all threads finished
+template <typename Function>
+void runParallel(size_t count, unsigned threadCount, Function function)
+{
+    atomic<size_t> nextIndex { 0 };
+    exception_ptr error;
+    mutex errorMutex;
+    auto worker = [&] {
+        for (size_t index = nextIndex++; index < count; index = nextIndex++) {
+            try {
+                function(index);
+            } catch (...) {
+                auto lock = std::scoped_lock(errorMutex);
+                if (!error) {
+                    error = current_exception();
+                }
+                // the other threads stop after their current index
+                nextIndex = count;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned i = 1; i < min<size_t>(threadCount, count); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+time_t localUtcOffset()
+{
+    time_t now = time(nullptr);
+    struct tm localTime;
+    localtime_r(&now, &localTime);
+    return timegm(&localTime) - now;
+}
+
+struct ParsedLines {
+    vector<SubmissionInfo> infos;
+    vector<string> records;
+    uint64_t skipped {};
+    uint64_t invalid {};
+};
+} // namespace
+
+ScrobblerLogImporter::ScrobblerLogImporter(std::string path, unsigned threadCount)
+: m_Path(std::move(path))
+, m_ThreadCount(threadCount > 0 ? threadCount : max(1u, thread::hardware_concurrency()))
+{
+}
+
+ScrobblerLogStatistics ScrobblerLogImporter::import(const PageHandler& handler)
+{
+    MappedFile file(m_Path);
+    const char* pos = file.data();
+    const char* end = file.data() + file.size();
+
+    auto nextLine = [&pos, end]() {
+        const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        string_view line(pos, static_cast<size_t>(lineEnd - pos));
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        pos = lineEnd == end ? end : lineEnd + 1;
+        return line;
+    };
+
+    ScrobblerLogStatistics statistics;
+    time_t utcOffset = 0;
+
+    // the header lines start with a '#', timestamps are local time unless the timezone is UTC
+    while (pos < end && *pos == '#') {
+        string_view line = nextLine();
+        ++statistics.lines;
+        if (line == "#TZ/UNKNOWN") {
+            utcOffset = localUtcOffset();
+        }
+    }
+
+    time_t timeAdded = time(nullptr);
+    SubmissionInfoCollection page;
+    vector<string> records;
+    vector<string_view> lines;
+    lines.reserve(LINES_PER_BLOCK);
+
+    while (pos < end) {
+        lines.clear();
+        while (pos < end && lines.size() < LINES_PER_BLOCK) {
+            lines.push_back(nextLine());
+        }
+        statistics.lines += lines.size();
+
+        vector<ParsedLines> tasks((lines.size() + LINES_PER_TASK - 1) / LINES_PER_TASK);
+        runParallel(tasks.size(), m_ThreadCount, [&](size_t taskIndex) {
+            ParsedLines& task = tasks[taskIndex];
+            size_t last = min(lines.size(), (taskIndex + 1) * LINES_PER_TASK);
+            task.infos.reserve(last - taskIndex * LINES_PER_TASK);
+            task.records.reserve(last - taskIndex * LINES_PER_TASK);
+
+            for (size_t i = taskIndex * LINES_PER_TASK; i < last; ++i) {
+                SubmissionInfo info;
+                bool skipped = false;
+                if (lines[i].empty()) {
+                    continue;
+                }
+                if (!parseLine(lines[i], utcOffset, info, skipped)) {
+                    ++task.invalid;
+                } else if (skipped) {
+                    ++task.skipped;
+                } else {
+                    task.records.emplace_back();
+                    SubmissionRecord::encode(info, timeAdded, task.records.back());
+                    task.infos.push_back(std::move(info));
+                }
+            }
+        });
+
+        // the pages are filled in file order, a partial page is continued in the next block
+        for (auto& task : tasks) {
+            statistics.skipped += task.skipped;
+            statistics.invalid += task.invalid;
+            for (size_t i = 0; i < task.infos.size(); ++i) {
+                page.addInfo(task.infos[i], timeAdded);
+                records.push_back(std::move(task.records[i]));
+                if (page.size() == SubmissionInfoCollection::MAX_SIZE) {
+                    statistics.imported += page.size();
+                    handler(page, records);
+                    page.clear();
+                    records.clear();
+                }
+            }
+        }
+    }
+
+    if (!page.empty()) {
+        statistics.imported += page.size();
+        handler(page, records);
+    }
+
+    return statistics;
+}
+
+bool ScrobblerLogImporter::parseLine(std::string_view line, time_t utcOffset, SubmissionInfo& info, bool& skipped)
+{
+    string_view fields[FIELD_COUNT];
+    size_t fieldCount = 0;
+    while (fieldCount < FIELD_COUNT) {
+        size_t tab = line.find('\t');
+        fields[fieldCount++] = line.substr(0, tab);
+        if (tab == string_view::npos) {
+            line = {};
+            break;
+        }
+        line.remove_prefix(tab + 1);
+    }
+
+    // the MusicBrainz id is optional
+    if (fieldCount < FIELD_COUNT - 1 || !line.empty()) {
+        return false;
+    }
+
+    int trackNr = -1;
+    int length;
+    int64_t timestamp;
+    if (fields[0].empty() || fields[2].empty()
+        || (!fields[3].empty() && !parseNumber(fields[3], trackNr))
+        || !parseNumber(fields[4], length) || length < 0
+        || !parseNumber(fields[6], timestamp)
+        || (fields[5] != "L" && fields[5] != "S")) {
+        return false;
+    }
+
+    info = SubmissionInfo(string(fields[0]), string(fields[2]), static_cast<time_t>(timestamp) - utcOffset);
+    info.setAlbum(string(fields[1]));
+    info.setTrackNr(trackNr);
+    info.setTrackLength(length);
+    if (fieldCount == FIELD_COUNT) {
+        info.setMusicBrainzId(string(fields[7]));
+    }
+    skipped = fields[5] == "S";
+    return true;
+}
@@ -0,0 +1,90 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file scrobblerlogimporter.h
+ * @brief Contains the ScrobblerLogImporter class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef SCROBBLER_LOG_IMPORTER_H
+#define SCROBBLER_LOG_IMPORTER_H
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "submissioninfocollection.h"
+
+/** The ScrobblerLogStatistics struct describes the result of an import */
+struct ScrobblerLogStatistics {
+    uint64_t lines {}; /**< \brief lines in the file, including the header */
+    uint64_t imported {}; /**< \brief tracks that were passed to the page handler */
+    uint64_t skipped {}; /**< \brief tracks the player marked as skipped */
+    uint64_t invalid {}; /**< \brief lines that could not be parsed */
+};
+
+/** The ScrobblerLogImporter class reads the .scrobbler.log files written by
+ * portable players like Rockbox (Audioscrobbler portable player log 1.1).
+ * Every line contains artist, album, title, track number, length, rating
+ * ('L' listened or 'S' skipped), timestamp and optionally the MusicBrainz
+ * id, separated by tabs. Skipped tracks are not imported.
+ *
+ * The file is memory-mapped and parsed in blocks, the lines of a block are
+ * parsed and encoded as spool records on multiple threads. The pages are
+ * passed to the handler in file order. An exception of a thread stops the
+ * import and is thrown to the caller once the threads of the block finished,
+ * the pages of the blocks before it were already passed to the handler.
+ */
+class ScrobblerLogImporter {
+public:
+    /** Handler that receives the pages of at most 50 tracks and the encoded
+     * spool records of the tracks, the record of page.getInfo(i) is records[i]
+     */
+    using PageHandler = std::function<void(const SubmissionInfoCollection& page, const std::vector<std::string>& records)>;
+
+    /** Constructor
+     * \param path the location of the .scrobbler.log file
+     * \param threadCount the number of threads used for parsing, 0 uses one thread per core
+     */
+    explicit ScrobblerLogImporter(std::string path, unsigned threadCount = 0);
+
+    /** Import the file
+     * \param handler receives the imported tracks in pages of at most 50 tracks
+     * \return the statistics of the import
+     * \exception std::logic_error when the file could not be read, exceptions
+     * of the parsing threads and of the handler are passed on
+     */
+    ScrobblerLogStatistics import(const PageHandler& handler);
+
+    /** Parse a single line of a scrobbler log
+     * \param line the line without the line ending
+     * \param utcOffset the number of seconds to subtract from the timestamp
+     * \param info receives the track
+     * \param skipped set to true if the player marked the track as skipped
+     * \return false if the line is not a valid entry
+     */
+    static bool parseLine(std::string_view line, time_t utcOffset, SubmissionInfo& info, bool& skipped);
+
+private:
+    std::string m_Path;
+    unsigned m_ThreadCount;
+};
+
+#endif
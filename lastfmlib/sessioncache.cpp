@@ -0,0 +1,96 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "sessioncache.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/stringoperations.h"
+
+using namespace std;
+
+// user, session id, now playing url and submission url separated by tabs
+static const size_t FIELD_COUNT = 4;
+
+SessionCache::SessionCache(std::string path)
+: m_Path(std::move(path))
+{
+}
+
+bool SessionCache::load(const string& user, LastFmSession& session) const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+
+    ifstream file(m_Path);
+    string line;
+    while (getline(file, line)) {
+        vector<string> fields = StringOperations::tokenize(line, "\t");
+        if (fields.size() == FIELD_COUNT && fields[0] == user) {
+            session = LastFmSession { fields[1], fields[2], fields[3] };
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SessionCache::store(const string& user, const LastFmSession& session)
+{
+    update(user, &session);
+}
+
+void SessionCache::remove(const string& user)
+{
+    update(user, nullptr);
+}
+
+void SessionCache::update(const string& user, const LastFmSession* pSession)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+
+    string contents;
+    {
+        ifstream file(m_Path);
+        string line;
+        while (getline(file, line)) {
+            if (line.compare(0, user.size() + 1, user + '\t') != 0) {
+                contents += line + '\n';
+            }
+        }
+    }
+
+    if (pSession) {
+        contents += user + '\t' + pSession->sessionId + '\t' + pSession->nowPlayingUrl + '\t' + pSession->submissionUrl + '\n';
+    }
+
+    // write a new file and rename it, so a crash never leaves a partial cache behind
+    string tempPath = m_Path + ".tmp";
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        throw logic_error("Failed to write session cache: " + tempPath);
+    }
+
+    bool ok = write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size());
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tempPath.c_str(), m_Path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        throw logic_error("Failed to write session cache: " + m_Path);
+    }
+}
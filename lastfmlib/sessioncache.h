@@ -0,0 +1,69 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file sessioncache.h
+ * @brief Contains the SessionCache class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef SESSION_CACHE_H
+#define SESSION_CACHE_H
+
+#include <mutex>
+#include <string>
+
+#include "lastfmclient.h"
+
+/** The SessionCache class stores the sessions obtained by handshakes in a
+ * file so they can be reused after a restart. The file contains one line
+ * per user and is only readable by its owner.
+ */
+class SessionCache {
+public:
+    /** Constructor
+     * \param path the location of the cache file, it is created when needed
+     */
+    explicit SessionCache(std::string path);
+
+    /** Look up the session of a user
+     * \param user the Last.fm user name
+     * \param session receives the cached session
+     * \return true if a session was found
+     */
+    bool load(const std::string& user, LastFmSession& session) const;
+
+    /** Store the session of a user, replacing a previously stored session
+     * \param user the Last.fm user name
+     * \param session the session to store
+     * \exception std::logic_error when the cache file could not be written
+     */
+    void store(const std::string& user, const LastFmSession& session);
+
+    /** Remove the session of a user
+     * \param user the Last.fm user name
+     * \exception std::logic_error when the cache file could not be written
+     */
+    void remove(const std::string& user);
+
+private:
+    void update(const std::string& user, const LastFmSession* pSession);
+
+    std::string m_Path;
+    mutable std::mutex m_Mutex;
+};
+
+#endif
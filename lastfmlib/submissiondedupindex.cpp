@@ -0,0 +1,139 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "submissiondedupindex.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+uint64_t fnv1a(uint64_t hash, const void* pData, size_t size)
+{
+    const auto* pBytes = static_cast<const unsigned char*>(pData);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ pBytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer, derives a second independent hash for double hashing
+uint64_t mix(uint64_t value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+} // namespace
+
+SubmissionDedupIndex::SubmissionDedupIndex(std::chrono::seconds window, size_t bitsPerFilter, int hashCount)
+: m_HalfWindow(max<time_t>(1, static_cast<time_t>(window.count()) / 2))
+, m_BitCount(max<size_t>(64, bitsPerFilter))
+, m_HashCount(max(1, hashCount))
+, m_CurrentFilter((m_BitCount + 63) / 64)
+, m_PreviousFilter(m_CurrentFilter.size())
+{
+}
+
+bool SubmissionDedupIndex::insert(const SubmissionInfo& info, time_t now)
+{
+    uint64_t submissionHash = hash(info);
+
+    auto lock = std::scoped_lock(m_Mutex);
+    rotate(now);
+
+    if (contains(m_CurrentFilter, submissionHash) || contains(m_PreviousFilter, submissionHash)) {
+        ++m_FilteredCount;
+        return false;
+    }
+
+    uint64_t step = mix(submissionHash) | 1;
+    for (int i = 0; i < m_HashCount; ++i) {
+        size_t bit = (submissionHash + i * step) % m_BitCount;
+        m_CurrentFilter[bit / 64] |= 1ULL << (bit % 64);
+    }
+
+    return true;
+}
+
+bool SubmissionDedupIndex::isDuplicate(const SubmissionInfo& info, time_t now)
+{
+    uint64_t submissionHash = hash(info);
+
+    auto lock = std::scoped_lock(m_Mutex);
+    rotate(now);
+
+    if (contains(m_CurrentFilter, submissionHash) || contains(m_PreviousFilter, submissionHash)) {
+        ++m_FilteredCount;
+        return true;
+    }
+
+    return false;
+}
+
+uint64_t SubmissionDedupIndex::getFilteredCount() const
+{
+    return m_FilteredCount;
+}
+
+uint64_t SubmissionDedupIndex::hash(const SubmissionInfo& info)
+{
+    const char separator = '\0';
+    int64_t timeStarted = info.getTimeStarted();
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = fnv1a(hash, info.getArtist().data(), info.getArtist().size());
+    hash = fnv1a(hash, &separator, 1);
+    hash = fnv1a(hash, info.getTrack().data(), info.getTrack().size());
+    hash = fnv1a(hash, &separator, 1);
+    return fnv1a(hash, &timeStarted, sizeof(timeStarted));
+}
+
+bool SubmissionDedupIndex::contains(const std::vector<uint64_t>& filter, uint64_t hash) const
+{
+    uint64_t step = mix(hash) | 1;
+    for (int i = 0; i < m_HashCount; ++i) {
+        size_t bit = (hash + i * step) % m_BitCount;
+        if ((filter[bit / 64] & (1ULL << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SubmissionDedupIndex::rotate(time_t now)
+{
+    if (m_CurrentFilterStart == 0) {
+        m_CurrentFilterStart = now;
+    }
+
+    if (now - m_CurrentFilterStart < m_HalfWindow) {
+        return;
+    }
+
+    if (now - m_CurrentFilterStart >= 2 * m_HalfWindow) {
+        // both filters are outside the window
+        fill(m_PreviousFilter.begin(), m_PreviousFilter.end(), 0);
+    } else {
+        m_PreviousFilter.swap(m_CurrentFilter);
+    }
+    fill(m_CurrentFilter.begin(), m_CurrentFilter.end(), 0);
+    m_CurrentFilterStart = now;
+}
@@ -0,0 +1,91 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file submissiondedupindex.h
+ * @brief Contains the SubmissionDedupIndex class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef SUBMISSION_DEDUP_INDEX_H
+#define SUBMISSION_DEDUP_INDEX_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <vector>
+
+#include "submissioninfo.h"
+
+/** The SubmissionDedupIndex class remembers the submissions of a recent
+ * time window to detect duplicates. A submission is identified by a hash
+ * of its artist, track and start time.
+ *
+ * The index uses two Bloom filters of a fixed size that each cover half
+ * of the window: when the current filter is older than half the window it
+ * replaces the previous one and a new filter is started. A submission is
+ * therefore remembered for at least half and at most the whole window.
+ * Like any Bloom filter it can report false positives, the filter size
+ * should be chosen so this is unlikely for the expected number of tracks.
+ */
+class SubmissionDedupIndex {
+public:
+    /** Constructor
+     * \param window the time submissions are remembered
+     * \param bitsPerFilter the size of each of the two filters in bits
+     * \param hashCount the number of bits that are set per submission
+     */
+    explicit SubmissionDedupIndex(std::chrono::seconds window, size_t bitsPerFilter = 1 << 20, int hashCount = 4);
+
+    /** Add a submission to the index
+     * \param info the submission
+     * \param now the current time
+     * \return false if the submission is a duplicate of one in the window
+     */
+    bool insert(const SubmissionInfo& info, time_t now = time(nullptr));
+
+    /** Check for a duplicate without adding the submission, so it can be
+     * inserted once it was stored
+     * \param info the submission
+     * \param now the current time
+     * \return true if the submission is a duplicate of one in the window,
+     * it is counted as filtered then
+     */
+    bool isDuplicate(const SubmissionInfo& info, time_t now = time(nullptr));
+
+    /** \brief returns the number of duplicates that were detected */
+    [[nodiscard]] uint64_t getFilteredCount() const;
+
+    /** \brief returns the hash that identifies a submission */
+    [[nodiscard]] static uint64_t hash(const SubmissionInfo& info);
+
+private:
+    bool contains(const std::vector<uint64_t>& filter, uint64_t hash) const;
+    void rotate(time_t now);
+
+    time_t m_HalfWindow;
+    size_t m_BitCount;
+    int m_HashCount;
+    std::vector<uint64_t> m_CurrentFilter;
+    std::vector<uint64_t> m_PreviousFilter;
+    time_t m_CurrentFilterStart {};
+    std::atomic<uint64_t> m_FilteredCount {};
+    std::mutex m_Mutex;
+};
+
+#endif
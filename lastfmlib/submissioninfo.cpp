@@ -91,6 +91,21 @@ time_t SubmissionInfo::getTimeStarted() const
     return m_TimeStarted;
 }
 
+TrackSource SubmissionInfo::getSource() const
+{
+    return m_Source;
+}
+
+const std::string& SubmissionInfo::getRecommendationKey() const
+{
+    return m_RecommendationKey;
+}
+
+TrackRating SubmissionInfo::getRating() const
+{
+    return m_Rating;
+}
+
 void SubmissionInfo::setSource(TrackSource source, std::string recommendationKey)
 {
     m_Source = source;
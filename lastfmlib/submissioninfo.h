@@ -45,6 +45,12 @@ public:
     [[nodiscard]] std::string getPostData(int index = 0) const;
     /** \brief returns the time track started playing */
     [[nodiscard]] time_t getTimeStarted() const;
+    /** \brief returns the source of the track */
+    [[nodiscard]] TrackSource getSource() const;
+    /** \brief returns the Last.fm recommendation key */
+    [[nodiscard]] const std::string& getRecommendationKey() const;
+    /** \brief returns the rating of the track */
+    [[nodiscard]] TrackRating getRating() const;
 
     /** Set the source of the track
      * \param source the source type
@@ -16,28 +16,91 @@
 
 #include "submissioninfocollection.h"
 
-using namespace std;
+#include <algorithm>
+
+#include "tracepoints.h"
 
-static const size_t MAX_QUEUE_SIZE = 50;
+using namespace std;
 
-void SubmissionInfoCollection::addInfo(const SubmissionInfo& info)
+bool SubmissionInfoCollection::addInfo(const SubmissionInfo& info, time_t timeAdded)
 {
-    if (m_Infos.size() == MAX_QUEUE_SIZE) {
+    if (m_pDedupIndex && !m_pDedupIndex->insert(info, timeAdded)) {
+        return false;
+    }
+
+    if (m_Infos.size() == MAX_SIZE) {
         m_Infos.pop_front();
+        m_TimesAdded.pop_front();
     }
     m_Infos.push_back(info);
+    m_TimesAdded.push_back(timeAdded);
+    m_PostDataValid = false;
+    LASTFMLIB_TRACE(queue__add, m_Infos.size());
+    return true;
+}
+
+void SubmissionInfoCollection::setDedupIndex(std::shared_ptr<SubmissionDedupIndex> index)
+{
+    m_pDedupIndex = std::move(index);
 }
 
 void SubmissionInfoCollection::clear()
 {
     m_Infos.clear();
+    m_TimesAdded.clear();
+    m_PostDataValid = false;
+}
+
+void SubmissionInfoCollection::removeFront(size_t count)
+{
+    count = min(count, m_Infos.size());
+    m_Infos.erase(m_Infos.begin(), m_Infos.begin() + count);
+    m_TimesAdded.erase(m_TimesAdded.begin(), m_TimesAdded.begin() + count);
+    m_PostDataValid = false;
+    LASTFMLIB_TRACE(queue__remove, count, m_Infos.size());
+}
+
+const string& SubmissionInfoCollection::getPostData() const
+{
+    if (!m_PostDataValid) {
+        m_PostData.clear();
+        for (std::deque<SubmissionInfo>::size_type i = 0; i < m_Infos.size(); ++i)
+            m_PostData += m_Infos[i].getPostData(static_cast<int>(i));
+        m_PostDataValid = true;
+    }
+
+    return m_PostData;
 }
 
-string SubmissionInfoCollection::getPostData() const
+size_t SubmissionInfoCollection::size() const
 {
-    string ret;
-    for (std::deque<SubmissionInfo>::size_type i = 0; i < m_Infos.size(); ++i)
-        ret += m_Infos[i].getPostData(static_cast<int>(i));
+    return m_Infos.size();
+}
+
+const SubmissionInfo& SubmissionInfoCollection::getInfo(size_t index) const
+{
+    return m_Infos.at(index);
+}
+
+bool SubmissionInfoCollection::empty() const
+{
+    return m_Infos.empty();
+}
+
+time_t SubmissionInfoCollection::getTimeAdded(size_t index) const
+{
+    return m_TimesAdded.at(index);
+}
+
+bool SubmissionInfoCollection::isFlushRequired(const SubmissionBatchPolicy& policy, time_t now) const
+{
+    if (m_Infos.empty()) {
+        return false;
+    }
+
+    if (m_Infos.size() >= min(policy.maxTracks, MAX_SIZE)) {
+        return true;
+    }
 
-    return ret;
+    return policy.maxAgeInSecs > 0 && now - m_TimesAdded.front() >= policy.maxAgeInSecs;
 }
@@ -17,17 +17,53 @@
 #ifndef SUBMISSION_INFO_COLLECTION_H
 #define SUBMISSION_INFO_COLLECTION_H
 
+#include "submissiondedupindex.h"
 #include "submissioninfo.h"
+#include <ctime>
 #include <deque>
+#include <memory>
+
+/** The SubmissionBatchPolicy struct determines when buffered tracks
+ * are submitted. The default policy submits every track immediately.
+ */
+struct SubmissionBatchPolicy {
+    size_t maxTracks { 1 }; /**< \brief submit once this number of tracks is buffered */
+    time_t maxAgeInSecs { 0 }; /**< \brief submit once the oldest track is buffered this long (0 disables) */
+};
 
 class SubmissionInfoCollection {
 public:
-    void addInfo(const SubmissionInfo& info);
+    /** \brief the maximum number of tracks in one submission, adding more tracks drops the oldest */
+    static constexpr size_t MAX_SIZE = 50;
+
+    /** Add a track to the collection
+     * \param info the track
+     * \param timeAdded the time the track was buffered
+     * \return false if the track was filtered as a duplicate
+     */
+    bool addInfo(const SubmissionInfo& info, time_t timeAdded = time(nullptr));
+    /** Filter tracks that are added with an index of recent submissions
+     * \param index the index to use, nullptr disables the filter
+     */
+    void setDedupIndex(std::shared_ptr<SubmissionDedupIndex> index);
     void clear();
-    [[nodiscard]] std::string getPostData() const;
+    /** \brief removes the oldest tracks from the collection */
+    void removeFront(size_t count);
+    /** \brief returns the postdata of the tracks, it is only generated once until the collection is modified */
+    [[nodiscard]] const std::string& getPostData() const;
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] const SubmissionInfo& getInfo(size_t index) const;
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] time_t getTimeAdded(size_t index) const;
+    [[nodiscard]] bool isFlushRequired(const SubmissionBatchPolicy& policy, time_t now) const;
 
 private:
     std::deque<SubmissionInfo> m_Infos;
+    std::deque<time_t> m_TimesAdded;
+    std::shared_ptr<SubmissionDedupIndex> m_pDedupIndex;
+    mutable std::string m_PostData;
+    mutable bool m_PostDataValid {};
 };
 
 #endif
@@ -0,0 +1,256 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "submissionlog.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "submissionrecord.h"
+#include "utils/log.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// every record starts with the size and the checksum of its payload
+static const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+static const uint32_t MAX_RECORD_SIZE = 64 * 1024;
+
+static void encodeRecord(const SubmissionInfo& info, time_t timeAdded, string& buffer)
+{
+    size_t start = buffer.size();
+    buffer.append(RECORD_HEADER_SIZE, '\0');
+    SubmissionRecord::encode(info, timeAdded, buffer);
+
+    auto size = static_cast<uint32_t>(buffer.size() - start - RECORD_HEADER_SIZE);
+    uint32_t crc = SubmissionRecord::checksum(buffer.data() + start + RECORD_HEADER_SIZE, size);
+    memcpy(&buffer[start], &size, sizeof(size));
+    memcpy(&buffer[start + sizeof(size)], &crc, sizeof(crc));
+}
+
+static bool writeAll(int file, const string& data)
+{
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t rc = write(file, data.data() + written, data.size() - written);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(rc);
+    }
+
+    return true;
+}
+
+static void syncDirectory(const string& path)
+{
+    // the rename is only durable once the directory entry is synced
+    auto separator = path.find_last_of('/');
+    string directory = separator == string::npos ? "." : separator == 0 ? "/" : path.substr(0, separator);
+
+    int file = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (file < 0 || fsync(file) != 0) {
+        Log::error("Failed to sync the directory of the submission log:", directory);
+    }
+    if (file >= 0) {
+        close(file);
+    }
+}
+
+SubmissionLog::SubmissionLog(std::string path, SubmissionLogSyncPolicy policy)
+: m_Path(std::move(path))
+, m_Policy(policy)
+, m_LastSync(steady_clock::now())
+{
+    m_File = open(m_Path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (m_File < 0) {
+        throw logic_error("Failed to open submission log: " + m_Path + " (" + strerror(errno) + ")");
+    }
+}
+
+SubmissionLog::~SubmissionLog()
+{
+    try {
+        sync();
+    } catch (const logic_error& e) {
+        Log::error(e.what());
+    }
+
+    close(m_File);
+}
+
+size_t SubmissionLog::replay(SubmissionInfoCollection& infos)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+
+    string contents;
+    char buffer[64 * 1024];
+    off_t offset = 0;
+    ssize_t bytesRead;
+    while ((bytesRead = pread(m_File, buffer, sizeof(buffer), offset)) > 0) {
+        contents.append(buffer, static_cast<size_t>(bytesRead));
+        offset += bytesRead;
+    }
+
+    size_t position = 0;
+    size_t count = 0;
+    while (contents.size() - position >= RECORD_HEADER_SIZE) {
+        uint32_t size, crc;
+        memcpy(&size, contents.data() + position, sizeof(size));
+        memcpy(&crc, contents.data() + position + sizeof(size), sizeof(crc));
+
+        const char* pPayload = contents.data() + position + RECORD_HEADER_SIZE;
+        if (size > MAX_RECORD_SIZE || size > contents.size() - position - RECORD_HEADER_SIZE
+            || SubmissionRecord::checksum(pPayload, size) != crc) {
+            break;
+        }
+
+        SubmissionInfo info;
+        time_t timeAdded;
+        if (!SubmissionRecord::decode(pPayload, size, info, timeAdded)) {
+            break;
+        }
+
+        infos.addInfo(info, timeAdded);
+        position += RECORD_HEADER_SIZE + size;
+        ++count;
+    }
+
+    if (position < contents.size()) {
+        // the tail was not completely written before a crash
+        Log::info("Submission log: discarding", contents.size() - position, "bytes of damaged records");
+        if (ftruncate(m_File, static_cast<off_t>(position)) != 0) {
+            Log::error("Failed to truncate submission log:", m_Path);
+        }
+    }
+
+    m_RecordCount = count;
+    return count;
+}
+
+void SubmissionLog::append(const SubmissionInfo& info, time_t timeAdded)
+{
+    auto lock = std::unique_lock(m_Mutex);
+
+    m_Buffer.clear();
+    encodeRecord(info, timeAdded, m_Buffer);
+    if (!writeAll(m_File, m_Buffer)) {
+        throw logic_error("Failed to write submission log: " + m_Path + " (" + strerror(errno) + ")");
+    }
+
+    ++m_RecordCount;
+    uint64_t record = ++m_WrittenRecords;
+
+    bool syncRequired = (m_Policy.maxUnsyncedRecords > 0 && record - m_SyncedRecords >= m_Policy.maxUnsyncedRecords)
+        || (m_Policy.maxUnsyncedTime > 0ms && steady_clock::now() - m_LastSync >= m_Policy.maxUnsyncedTime);
+    if (syncRequired) {
+        waitUntilSynced(lock, record);
+    }
+}
+
+void SubmissionLog::sync()
+{
+    auto lock = std::unique_lock(m_Mutex);
+    waitUntilSynced(lock, m_WrittenRecords);
+}
+
+void SubmissionLog::truncate()
+{
+    auto lock = std::scoped_lock(m_Mutex);
+
+    if (ftruncate(m_File, 0) != 0 || fdatasync(m_File) != 0) {
+        throw logic_error("Failed to truncate submission log: " + m_Path + " (" + strerror(errno) + ")");
+    }
+
+    m_RecordCount = 0;
+    m_SyncedRecords = m_WrittenRecords;
+    m_LastSync = steady_clock::now();
+}
+
+void SubmissionLog::rewrite(const SubmissionInfoCollection& infos)
+{
+    auto lock = std::unique_lock(m_Mutex);
+    // the file is replaced, a sync that is in progress has to finish first
+    m_SyncFinished.wait(lock, [this] { return !m_Syncing; });
+
+    m_Buffer.clear();
+    for (size_t i = 0; i < infos.size(); ++i) {
+        encodeRecord(infos.getInfo(i), infos.getTimeAdded(i), m_Buffer);
+    }
+
+    string newPath = m_Path + ".new";
+    int file = open(newPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (file < 0) {
+        throw logic_error("Failed to create submission log: " + newPath + " (" + strerror(errno) + ")");
+    }
+
+    if (!writeAll(file, m_Buffer) || fdatasync(file) != 0 || rename(newPath.c_str(), m_Path.c_str()) != 0) {
+        string error = strerror(errno);
+        close(file);
+        unlink(newPath.c_str());
+        throw logic_error("Failed to rewrite submission log: " + m_Path + " (" + error + ")");
+    }
+    syncDirectory(m_Path);
+
+    close(m_File);
+    m_File = file;
+    m_RecordCount = infos.size();
+    m_SyncedRecords = m_WrittenRecords;
+    m_LastSync = steady_clock::now();
+}
+
+size_t SubmissionLog::size() const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    return m_RecordCount;
+}
+
+void SubmissionLog::waitUntilSynced(std::unique_lock<std::mutex>& lock, uint64_t record)
+{
+    while (m_SyncedRecords < record) {
+        if (m_Syncing) {
+            // another appender is syncing, its sync might cover our record as well
+            m_SyncFinished.wait(lock);
+            continue;
+        }
+
+        m_Syncing = true;
+        uint64_t target = m_WrittenRecords;
+
+        lock.unlock();
+        int rc = fdatasync(m_File);
+        lock.lock();
+
+        m_Syncing = false;
+        if (rc == 0) {
+            m_SyncedRecords = max(m_SyncedRecords, target);
+            m_LastSync = steady_clock::now();
+        }
+        m_SyncFinished.notify_all();
+
+        if (rc != 0) {
+            throw logic_error("Failed to sync submission log: " + m_Path + " (" + strerror(errno) + ")");
+        }
+    }
+}
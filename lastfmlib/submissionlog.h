@@ -0,0 +1,117 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file submissionlog.h
+ * @brief Contains the SubmissionLog class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef SUBMISSION_LOG_H
+#define SUBMISSION_LOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "submissioninfocollection.h"
+
+/** The SubmissionLogSyncPolicy struct determines when appended records
+ * are flushed to disk. The default policy syncs every append.
+ */
+struct SubmissionLogSyncPolicy {
+    size_t maxUnsyncedRecords { 1 }; /**< \brief sync once this number of records is not synced yet (0 disables) */
+    std::chrono::milliseconds maxUnsyncedTime { 0 }; /**< \brief sync when appending once the last sync is this long ago (0 disables) */
+};
+
+/** The SubmissionLog class is an append-only write-ahead log of the
+ * buffered submissions, so tracks that were not acknowledged by the
+ * server survive a crash or restart. Every record is prefixed with its
+ * size and checksum, a partially written record at the end of the log is
+ * discarded on replay. Appenders that need a sync at the same time share
+ * a single fsync (group commit). Acknowledged submissions are removed by
+ * writing the remaining ones to a new file that replaces the log, so the
+ * log is complete at any time.
+ */
+class SubmissionLog {
+public:
+    /** Constructor, opens the log
+     * \param path the location of the log file, it is created when needed
+     * \param policy determines how often the log is synced
+     * \exception std::logic_error when the log could not be opened
+     */
+    explicit SubmissionLog(std::string path, SubmissionLogSyncPolicy policy = {});
+    /** Destructor, syncs and closes the log */
+    ~SubmissionLog();
+
+    SubmissionLog(const SubmissionLog&) = delete;
+    SubmissionLog& operator=(const SubmissionLog&) = delete;
+
+    /** Read the submissions in the log, a damaged tail is truncated
+     * \param infos receives the submissions
+     * \return the number of submissions read
+     */
+    size_t replay(SubmissionInfoCollection& infos);
+
+    /** Append a submission to the log, returns when the sync policy is satisfied
+     * \param info the submission
+     * \param timeAdded the time the submission was buffered
+     * \exception std::logic_error when the log could not be written
+     */
+    void append(const SubmissionInfo& info, time_t timeAdded);
+
+    /** Flush all appended records to disk
+     * \exception std::logic_error when the log could not be synced
+     */
+    void sync();
+
+    /** Remove all records from the log, call this when the server
+     * acknowledged all submissions in the log
+     * \exception std::logic_error when the log could not be truncated
+     */
+    void truncate();
+
+    /** Replace the contents of the log with a set of submissions, call
+     * this when the server acknowledged a part of the submissions. The new
+     * log is synced and renamed over the old one, a crash leaves either
+     * the old or the new log.
+     * \param infos the submissions that remain
+     * \exception std::logic_error when the log could not be replaced, the old log is kept then
+     */
+    void rewrite(const SubmissionInfoCollection& infos);
+
+    /** \brief returns the number of records in the log */
+    [[nodiscard]] size_t size() const;
+
+private:
+    void waitUntilSynced(std::unique_lock<std::mutex>& lock, uint64_t record);
+
+    std::string m_Path;
+    SubmissionLogSyncPolicy m_Policy;
+    int m_File { -1 };
+    std::string m_Buffer;
+    size_t m_RecordCount {};
+    uint64_t m_WrittenRecords {};
+    uint64_t m_SyncedRecords {};
+    bool m_Syncing {};
+    std::chrono::steady_clock::time_point m_LastSync;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_SyncFinished;
+};
+
+#endif
@@ -0,0 +1,167 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "submissionrecord.h"
+
+#include <array>
+
+using namespace std;
+
+// increment when the layout of a record changes
+static const uint8_t RECORD_VERSION = 1;
+
+namespace {
+void putNumber(string& buffer, int64_t value)
+{
+    // zigzag encoding keeps small negative numbers (e.g. unknown track length) short
+    auto number = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    while (number >= 0x80) {
+        buffer += static_cast<char>((number & 0x7F) | 0x80);
+        number >>= 7;
+    }
+    buffer += static_cast<char>(number);
+}
+
+void putString(string& buffer, const string& value)
+{
+    putNumber(buffer, static_cast<int64_t>(value.size()));
+    buffer += value;
+}
+
+class Reader {
+public:
+    Reader(const char* data, size_t size)
+    : m_pData(data)
+    , m_pEnd(data + size)
+    {
+    }
+
+    bool getNumber(int64_t& value)
+    {
+        uint64_t number = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (m_pData == m_pEnd) {
+                return false;
+            }
+
+            auto byte = static_cast<uint8_t>(*m_pData++);
+            number |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                value = static_cast<int64_t>(number >> 1) ^ -static_cast<int64_t>(number & 1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool getString(string& value)
+    {
+        int64_t size;
+        if (!getNumber(size) || size < 0 || size > m_pEnd - m_pData) {
+            return false;
+        }
+
+        value.assign(m_pData, static_cast<size_t>(size));
+        m_pData += size;
+        return true;
+    }
+
+    bool atEnd() const
+    {
+        return m_pData == m_pEnd;
+    }
+
+private:
+    const char* m_pData;
+    const char* m_pEnd;
+};
+
+array<uint32_t, 256> createCrcTable()
+{
+    array<uint32_t, 256> table {};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+} // namespace
+
+namespace SubmissionRecord {
+void encode(const SubmissionInfo& info, time_t timeAdded, string& buffer)
+{
+    buffer += static_cast<char>(RECORD_VERSION);
+    putNumber(buffer, timeAdded);
+    putNumber(buffer, info.getTimeStarted());
+    putNumber(buffer, info.getTrackLength());
+    putNumber(buffer, info.getTrackNr());
+    putNumber(buffer, info.getSource());
+    putNumber(buffer, info.getRating());
+    putString(buffer, info.getArtist());
+    putString(buffer, info.getTrack());
+    putString(buffer, info.getAlbum());
+    putString(buffer, info.getMusicBrainzId());
+    putString(buffer, info.getRecommendationKey());
+}
+
+bool decode(const char* data, size_t size, SubmissionInfo& info, time_t& timeAdded)
+{
+    if (size == 0 || static_cast<uint8_t>(data[0]) != RECORD_VERSION) {
+        return false;
+    }
+
+    Reader reader(data + 1, size - 1);
+    int64_t added, timeStarted, trackLength, trackNr, source, rating;
+    string artist, track, album, musicBrainzId, recommendationKey;
+    if (!reader.getNumber(added) || !reader.getNumber(timeStarted)
+        || !reader.getNumber(trackLength) || !reader.getNumber(trackNr)
+        || !reader.getNumber(source) || !reader.getNumber(rating)
+        || !reader.getString(artist) || !reader.getString(track)
+        || !reader.getString(album) || !reader.getString(musicBrainzId)
+        || !reader.getString(recommendationKey) || !reader.atEnd()) {
+        return false;
+    }
+
+    if (source < UserChosen || source > UnknownSource || rating < Love || rating > NoRating) {
+        return false;
+    }
+
+    info = SubmissionInfo(artist, track, static_cast<time_t>(timeStarted));
+    info.setAlbum(album);
+    info.setTrackLength(static_cast<int>(trackLength));
+    info.setTrackNr(static_cast<int>(trackNr));
+    info.setMusicBrainzId(musicBrainzId);
+    info.setSource(static_cast<TrackSource>(source), recommendationKey);
+    info.setRating(static_cast<TrackRating>(rating));
+    timeAdded = static_cast<time_t>(added);
+    return true;
+}
+
+uint32_t checksum(const char* data, size_t size)
+{
+    static const array<uint32_t, 256> table = createCrcTable();
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+}
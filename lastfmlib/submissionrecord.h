@@ -0,0 +1,61 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file submissionrecord.h
+ * @brief Contains the binary encoding of submissions
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef SUBMISSION_RECORD_H
+#define SUBMISSION_RECORD_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+#include "submissioninfo.h"
+
+/** The SubmissionRecord namespace contains the compact binary encoding
+ * that is used to store submissions on disk. Integers are stored as
+ * variable length numbers and strings are prefixed with their length.
+ */
+namespace SubmissionRecord {
+/** Append the encoding of a submission to a buffer
+ * \param info the submission to encode
+ * \param timeAdded the time the submission was buffered
+ * \param buffer the encoded record is appended to this buffer
+ */
+void encode(const SubmissionInfo& info, time_t timeAdded, std::string& buffer);
+
+/** Decode a submission
+ * \param data the encoded record
+ * \param size the size of the encoded record
+ * \param info receives the submission
+ * \param timeAdded receives the time the submission was buffered
+ * \return false if the data is not a valid record
+ */
+bool decode(const char* data, size_t size, SubmissionInfo& info, time_t& timeAdded);
+
+/** Calculate the CRC-32 checksum of a block of data
+ * \param data the data
+ * \param size the size of the data
+ * \return the checksum
+ */
+uint32_t checksum(const char* data, size_t size);
+}
+
+#endif
@@ -0,0 +1,447 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "submissionspool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "submissionrecord.h"
+#include "utils/log.h"
+
+using namespace std;
+
+static const char SPOOL_MAGIC[8] = { 'L', 'F', 'M', 'S', 'P', 'O', 'O', 'L' };
+// version 1 spools only contain single slot entries and version 2 spools have
+// no submitted entries, both are read the same way
+static const uint32_t SPOOL_VERSION = 3;
+static const uint32_t MIN_SPOOL_VERSION = 1;
+// the header occupies the first page, the slots follow
+static const size_t HEADER_SIZE = 4096;
+static const size_t PAGE_SIZE = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+// enough for the pages of a pipelined drain and the pages of a reader of the whole spool
+static const size_t MAX_CURSORS = 64;
+
+struct SubmissionSpool::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotSize;
+    uint64_t capacity;
+    uint64_t head; /**< sequence number of the oldest entry */
+    uint64_t tail; /**< sequence number of the next entry */
+};
+
+// set in the size of an entry that was submitted before the entries in front of it were removed
+static const uint32_t SUBMITTED_FLAG = 0x80000000;
+
+struct SubmissionSpool::SlotHeader {
+    uint64_t sequence; /**< sequence number + 1, so an empty slot never matches */
+    uint32_t size; /**< size of the record, which continues in the next slots when needed, and the flags */
+    uint32_t crc;
+};
+
+SubmissionSpool::SubmissionSpool(std::string path, uint64_t capacity, uint32_t slotSize)
+: m_Path(std::move(path))
+{
+    if (capacity == 0 || slotSize < sizeof(SlotHeader) + 32 || slotSize % 8 != 0) {
+        throw logic_error("Invalid submission spool dimensions");
+    }
+
+    m_File = open(m_Path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (m_File < 0) {
+        throw logic_error("Failed to open submission spool: " + m_Path + " (" + strerror(errno) + ")");
+    }
+
+    try {
+        create(capacity, slotSize);
+    } catch (const logic_error&) {
+        if (m_pData) {
+            munmap(m_pData, m_Size);
+        }
+        close(m_File);
+        throw;
+    }
+
+    recoverTail();
+}
+
+SubmissionSpool::~SubmissionSpool()
+{
+    sync();
+    munmap(m_pData, m_Size);
+    close(m_File);
+}
+
+void SubmissionSpool::create(uint64_t capacity, uint32_t slotSize)
+{
+    struct stat fileInfo;
+    if (fstat(m_File, &fileInfo) != 0) {
+        throw logic_error("Failed to open submission spool: " + m_Path + " (" + strerror(errno) + ")");
+    }
+
+    bool newSpool = fileInfo.st_size == 0;
+    if (newSpool) {
+        // the file is sparse, disk space is only used for slots that were written
+        m_Size = HEADER_SIZE + capacity * slotSize;
+        if (ftruncate(m_File, static_cast<off_t>(m_Size)) != 0) {
+            throw logic_error("Failed to create submission spool: " + m_Path + " (" + strerror(errno) + ")");
+        }
+    } else {
+        m_Size = static_cast<size_t>(fileInfo.st_size);
+    }
+
+    void* pData = mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+    if (pData == MAP_FAILED) {
+        throw logic_error("Failed to map submission spool: " + m_Path + " (" + strerror(errno) + ")");
+    }
+    m_pData = static_cast<char*>(pData);
+    m_pHeader = reinterpret_cast<Header*>(m_pData);
+
+    if (newSpool) {
+        memcpy(m_pHeader->magic, SPOOL_MAGIC, sizeof(SPOOL_MAGIC));
+        m_pHeader->version = SPOOL_VERSION;
+        m_pHeader->slotSize = slotSize;
+        m_pHeader->capacity = capacity;
+        m_pHeader->head = 0;
+        m_pHeader->tail = 0;
+        return;
+    }
+
+    if (m_Size < HEADER_SIZE || memcmp(m_pHeader->magic, SPOOL_MAGIC, sizeof(SPOOL_MAGIC)) != 0
+        || m_pHeader->version < MIN_SPOOL_VERSION || m_pHeader->version > SPOOL_VERSION
+        || m_Size != HEADER_SIZE + m_pHeader->capacity * m_pHeader->slotSize) {
+        throw logic_error("Invalid submission spool: " + m_Path);
+    }
+    m_pHeader->version = SPOOL_VERSION;
+
+    if (m_pHeader->capacity != capacity || m_pHeader->slotSize != slotSize) {
+        Log::info("Submission spool: keeping the dimensions of the existing spool");
+    }
+}
+
+void SubmissionSpool::recoverTail()
+{
+    if (m_pHeader->tail < m_pHeader->head || m_pHeader->tail - m_pHeader->head > m_pHeader->capacity) {
+        Log::error("Submission spool: invalid head and tail, discarding the contents");
+        m_pHeader->tail = m_pHeader->head;
+    }
+
+    // the tail is only synced after the slots, but slots that were never written
+    // (e.g. a spool copied during a sync) are not trusted, the tail is moved back
+    // to the end of the last valid entry
+    uint64_t validTail = m_pHeader->head;
+    uint64_t entryCount = 0;
+    string buffer;
+    const char* pRecord;
+    uint32_t size;
+    for (uint64_t sequence = m_pHeader->head; sequence < m_pHeader->tail; sequence = nextEntry(sequence)) {
+        ++entryCount;
+        if (readEntry(sequence, m_pHeader->tail, buffer, pRecord, size)) {
+            validTail = sequence + getSlotCount(size);
+            m_EntryCount = entryCount;
+        }
+    }
+
+    if (validTail < m_pHeader->tail) {
+        Log::error("Submission spool: discarding", m_pHeader->tail - validTail, "slots that were not written");
+        m_pHeader->tail = validTail;
+    }
+
+    // entries written before a crash whose tail update was lost
+    uint64_t recovered = 0;
+    while (m_pHeader->tail - m_pHeader->head < m_pHeader->capacity
+        && readEntry(m_pHeader->tail, m_pHeader->head + m_pHeader->capacity, buffer, pRecord, size)) {
+        m_pHeader->tail += getSlotCount(size);
+        ++recovered;
+    }
+
+    if (recovered > 0) {
+        Log::info("Submission spool: recovered", recovered, "entries");
+    }
+
+    m_EntryCount += recovered;
+    m_SyncedTail = m_pHeader->tail;
+}
+
+bool SubmissionSpool::enqueue(const SubmissionInfo& info, time_t timeAdded)
+{
+    string record;
+    SubmissionRecord::encode(info, timeAdded, record);
+
+    try {
+        return enqueueRecord(record);
+    } catch (const logic_error&) {
+        throw logic_error("Submission does not fit in the spool: " + info.getArtist() + " - " + info.getTrack());
+    }
+}
+
+bool SubmissionSpool::enqueueRecord(const std::string& record)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    uint64_t slots = getSlotCount(record.size());
+    if (record.size() > MAX_RECORD_SIZE || slots > m_pHeader->capacity) {
+        throw logic_error("Submission does not fit in the spool");
+    }
+
+    uint64_t sequence = m_pHeader->tail;
+    if (m_pHeader->capacity - (sequence - m_pHeader->head) < slots) {
+        return false;
+    }
+
+    writeEntry(sequence, record);
+    m_pHeader->tail = sequence + slots;
+    ++m_EntryCount;
+    return true;
+}
+
+size_t SubmissionSpool::readPage(size_t offset, SubmissionInfoCollection& page, size_t maxEntries) const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+
+    uint64_t sequence = findEntry(offset);
+    size_t count = 0;
+    string buffer;
+    for (; sequence < m_pHeader->tail && count < maxEntries; sequence = nextEntry(sequence), ++count) {
+        SubmissionInfo info;
+        time_t timeAdded;
+        const char* pRecord;
+        uint32_t size;
+
+        if (isSubmitted(sequence)) {
+            continue;
+        }
+
+        if (!readEntry(sequence, m_pHeader->tail, buffer, pRecord, size) || !SubmissionRecord::decode(pRecord, size, info, timeAdded)) {
+            Log::error("Submission spool: skipping damaged entry", sequence);
+            continue;
+        }
+
+        page.addInfo(info, timeAdded);
+    }
+
+    // the next page and the removal of this page start where this page ended
+    addCursor(m_HeadIndex + offset + count, sequence);
+
+    return count;
+}
+
+void SubmissionSpool::remove(size_t count)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    count = min<size_t>(count, m_EntryCount);
+    m_pHeader->head = findEntry(count);
+    m_HeadIndex += count;
+    m_EntryCount -= count;
+
+    while (!m_Cursors.empty() && m_Cursors.front().first < m_HeadIndex) {
+        m_Cursors.pop_front();
+    }
+}
+
+void SubmissionSpool::markSubmitted(size_t offset, size_t count)
+{
+    uint64_t first;
+    uint64_t last;
+    {
+        auto lock = std::scoped_lock(m_Mutex);
+        first = findEntry(offset);
+        last = first;
+        for (size_t i = 0; i < count && last < m_pHeader->tail; ++i) {
+            SlotHeader slotHeader;
+            memcpy(&slotHeader, getSlot(last), sizeof(slotHeader));
+            if (slotHeader.sequence == last + 1) {
+                slotHeader.size |= SUBMITTED_FLAG;
+                memcpy(getSlot(last), &slotHeader, sizeof(slotHeader));
+            }
+            last = nextEntry(last);
+        }
+    }
+
+    // marking entries is rare, so it is synced at once
+    syncSlots(first, last);
+}
+
+void SubmissionSpool::sync()
+{
+    uint64_t first;
+    uint64_t last;
+    {
+        auto lock = std::scoped_lock(m_Mutex);
+        // slots that were removed since they were written don't have to be flushed
+        first = max(m_SyncedTail, m_pHeader->head);
+        last = m_pHeader->tail;
+        m_SyncedTail = last;
+    }
+
+    // the slots are on disk before the tail that points to them
+    syncSlots(first, last);
+    syncRange(0, sizeof(Header));
+}
+
+size_t SubmissionSpool::size() const
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    return static_cast<size_t>(m_EntryCount);
+}
+
+bool SubmissionSpool::empty() const
+{
+    return size() == 0;
+}
+
+uint64_t SubmissionSpool::capacity() const
+{
+    return m_pHeader->capacity;
+}
+
+char* SubmissionSpool::getSlot(uint64_t sequence) const
+{
+    return m_pData + HEADER_SIZE + (sequence % m_pHeader->capacity) * m_pHeader->slotSize;
+}
+
+uint64_t SubmissionSpool::getSlotCount(uint64_t recordSize) const
+{
+    return (sizeof(SlotHeader) + recordSize + m_pHeader->slotSize - 1) / m_pHeader->slotSize;
+}
+
+void SubmissionSpool::writeEntry(uint64_t sequence, const std::string& record)
+{
+    // the continuation slots are written first, the header of the first slot makes the entry valid
+    size_t firstChunk = min<size_t>(record.size(), m_pHeader->slotSize - sizeof(SlotHeader));
+    for (size_t position = firstChunk, slot = 1; position < record.size(); ++slot) {
+        size_t chunk = min<size_t>(record.size() - position, m_pHeader->slotSize);
+        memcpy(getSlot(sequence + slot), record.data() + position, chunk);
+        position += chunk;
+    }
+
+    char* pSlot = getSlot(sequence);
+    memcpy(pSlot + sizeof(SlotHeader), record.data(), firstChunk);
+
+    SlotHeader slotHeader { sequence + 1, static_cast<uint32_t>(record.size()), SubmissionRecord::checksum(record.data(), record.size()) };
+    memcpy(pSlot, &slotHeader, sizeof(slotHeader));
+}
+
+bool SubmissionSpool::readEntry(uint64_t sequence, uint64_t end, std::string& buffer, const char*& pRecord, uint32_t& size) const
+{
+    const char* pSlot = getSlot(sequence);
+    SlotHeader slotHeader;
+    memcpy(&slotHeader, pSlot, sizeof(slotHeader));
+    slotHeader.size &= ~SUBMITTED_FLAG;
+
+    if (slotHeader.sequence != sequence + 1 || slotHeader.size > MAX_RECORD_SIZE || getSlotCount(slotHeader.size) > end - sequence) {
+        return false;
+    }
+
+    size_t firstChunk = min<size_t>(slotHeader.size, m_pHeader->slotSize - sizeof(SlotHeader));
+    if (firstChunk == slotHeader.size) {
+        pRecord = pSlot + sizeof(SlotHeader);
+    } else {
+        // the slots of an entry can wrap around the end of the ring, so they are copied
+        buffer.assign(pSlot + sizeof(SlotHeader), firstChunk);
+        for (uint64_t slot = 1; buffer.size() < slotHeader.size; ++slot) {
+            buffer.append(getSlot(sequence + slot), min<size_t>(slotHeader.size - buffer.size(), m_pHeader->slotSize));
+        }
+        pRecord = buffer.data();
+    }
+
+    size = slotHeader.size;
+    return SubmissionRecord::checksum(pRecord, size) == slotHeader.crc;
+}
+
+uint64_t SubmissionSpool::findEntry(size_t offset) const
+{
+    // the walk starts at the closest cursor before the entry, or at the head
+    uint64_t index = m_HeadIndex;
+    uint64_t sequence = m_pHeader->head;
+    auto cursor = upper_bound(m_Cursors.begin(), m_Cursors.end(), make_pair(m_HeadIndex + offset, UINT64_MAX));
+    if (cursor != m_Cursors.begin()) {
+        --cursor;
+        index = cursor->first;
+        sequence = cursor->second;
+    }
+
+    for (; index < m_HeadIndex + offset && sequence < m_pHeader->tail; ++index) {
+        sequence = nextEntry(sequence);
+    }
+    return sequence;
+}
+
+void SubmissionSpool::addCursor(uint64_t index, uint64_t sequence) const
+{
+    auto cursor = lower_bound(m_Cursors.begin(), m_Cursors.end(), make_pair(index, uint64_t(0)));
+    if (cursor != m_Cursors.end() && cursor->first == index) {
+        return;
+    }
+
+    m_Cursors.emplace(cursor, index, sequence);
+    if (m_Cursors.size() > MAX_CURSORS) {
+        m_Cursors.pop_front();
+    }
+}
+
+uint64_t SubmissionSpool::nextEntry(uint64_t sequence) const
+{
+    SlotHeader slotHeader;
+    memcpy(&slotHeader, getSlot(sequence), sizeof(slotHeader));
+    slotHeader.size &= ~SUBMITTED_FLAG;
+
+    // a slot with a damaged header is skipped on its own
+    uint64_t slots = 1;
+    if (slotHeader.sequence == sequence + 1 && slotHeader.size <= MAX_RECORD_SIZE) {
+        slots = getSlotCount(slotHeader.size);
+    }
+
+    return min(sequence + slots, m_pHeader->tail);
+}
+
+bool SubmissionSpool::isSubmitted(uint64_t sequence) const
+{
+    SlotHeader slotHeader;
+    memcpy(&slotHeader, getSlot(sequence), sizeof(slotHeader));
+    return slotHeader.sequence == sequence + 1 && (slotHeader.size & SUBMITTED_FLAG) != 0;
+}
+
+void SubmissionSpool::syncSlots(uint64_t first, uint64_t last) const
+{
+    if (first >= last) {
+        return;
+    }
+
+    uint64_t capacity = m_pHeader->capacity;
+    uint64_t firstSlot = first % capacity;
+    uint64_t slots = min(last - first, capacity);
+    uint64_t slotsBeforeEnd = min(slots, capacity - firstSlot);
+    syncRange(HEADER_SIZE + firstSlot * m_pHeader->slotSize, slotsBeforeEnd * m_pHeader->slotSize);
+    if (slots > slotsBeforeEnd) {
+        // the slots wrap around the end of the ring
+        syncRange(HEADER_SIZE, (slots - slotsBeforeEnd) * m_pHeader->slotSize);
+    }
+}
+
+void SubmissionSpool::syncRange(size_t offset, size_t size) const
+{
+    // msync needs a page aligned address
+    size_t alignedOffset = offset - offset % PAGE_SIZE;
+    if (msync(m_pData + alignedOffset, size + offset - alignedOffset, MS_SYNC) != 0) {
+        Log::error("Failed to sync submission spool:", m_Path);
+    }
+}
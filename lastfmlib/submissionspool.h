@@ -0,0 +1,151 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file submissionspool.h
+ * @brief Contains the SubmissionSpool class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef SUBMISSION_SPOOL_H
+#define SUBMISSION_SPOOL_H
+
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "submissioninfocollection.h"
+
+/** The SubmissionSpool class is a persistent queue of submissions for
+ * devices that are offline for a long time. The spool is a memory-mapped
+ * file with a fixed number of fixed-size slots that is used as a ring
+ * buffer, so adding and removing submissions takes constant time. A
+ * submission that does not fit in one slot occupies consecutive slots.
+ *
+ * The first slot of every submission contains its sequence number, size
+ * and checksum. The head and tail are only advanced after the slots were
+ * written and are synced after them, when the spool is opened slots that
+ * were written after the last tail update are recovered and damaged slots
+ * are skipped when reading. Entries that were submitted while entries in
+ * front of them stay in the spool are marked, so they are not read again.
+ */
+class SubmissionSpool {
+public:
+    static constexpr uint64_t DEFAULT_CAPACITY = 1024 * 1024; /**< \brief the default number of slots */
+    static constexpr uint32_t DEFAULT_SLOT_SIZE = 256; /**< \brief the default size of a slot in bytes */
+    static constexpr uint32_t MAX_RECORD_SIZE = 64 * 1024; /**< \brief the maximum size of an encoded submission */
+
+    /** Constructor, opens the spool file or creates it when it does not exist.
+     * The capacity and slot size of an existing spool are kept.
+     * \param path the location of the spool file
+     * \param capacity the number of submissions the spool can hold
+     * \param slotSize the size of a slot, larger submissions take several slots
+     * \exception std::logic_error when the spool could not be opened
+     */
+    explicit SubmissionSpool(std::string path, uint64_t capacity = DEFAULT_CAPACITY, uint32_t slotSize = DEFAULT_SLOT_SIZE);
+    /** Destructor, syncs and unmaps the spool */
+    ~SubmissionSpool();
+
+    SubmissionSpool(const SubmissionSpool&) = delete;
+    SubmissionSpool& operator=(const SubmissionSpool&) = delete;
+
+    /** Add a submission at the end of the spool
+     * \param info the submission
+     * \param timeAdded the time the submission was buffered
+     * \return false if the spool is full
+     * \exception std::logic_error when the encoded submission is larger than
+     * MAX_RECORD_SIZE or than the whole spool
+     */
+    bool enqueue(const SubmissionInfo& info, time_t timeAdded);
+
+    /** Add a submission that was already encoded at the end of the spool
+     * \param record the submission encoded with SubmissionRecord::encode()
+     * \return false if the spool is full
+     * \exception std::logic_error when the record is larger than
+     * MAX_RECORD_SIZE or than the whole spool
+     */
+    bool enqueueRecord(const std::string& record);
+
+    /** Read a page of submissions without removing them. The spool
+     * remembers where the recent pages ended, so reading the next page and
+     * removing the pages that were read don't walk the entries before them.
+     * \param offset the number of entries to skip from the start of the spool
+     * \param page receives the submissions
+     * \param maxEntries the maximum number of entries to read
+     * \return the number of entries that were read, damaged and submitted
+     * entries are included in this number but not added to the page
+     */
+    size_t readPage(size_t offset, SubmissionInfoCollection& page, size_t maxEntries = SubmissionInfoCollection::MAX_SIZE) const;
+
+    /** Remove entries from the start of the spool
+     * \param count the number of entries to remove
+     */
+    void remove(size_t count);
+
+    /** Mark entries as submitted, they are skipped by readPage() and are
+     * removed with the entries in front of them. The marks are synced to
+     * disk at once.
+     * \param offset the number of entries to skip from the start of the spool
+     * \param count the number of entries to mark
+     */
+    void markSubmitted(size_t offset, size_t count);
+
+    /** Flush the slots written since the last sync and the head and tail to disk */
+    void sync();
+
+    /** \brief returns the number of entries in the spool */
+    [[nodiscard]] size_t size() const;
+    /** \brief returns true if the spool contains no entries */
+    [[nodiscard]] bool empty() const;
+    /** \brief returns the maximum number of entries in the spool */
+    [[nodiscard]] uint64_t capacity() const;
+
+private:
+    struct Header;
+    struct SlotHeader;
+
+    void create(uint64_t capacity, uint32_t slotSize);
+    void recoverTail();
+    void writeEntry(uint64_t sequence, const std::string& record);
+    bool readEntry(uint64_t sequence, uint64_t end, std::string& buffer, const char*& pRecord, uint32_t& size) const;
+    [[nodiscard]] uint64_t findEntry(size_t offset) const;
+    void addCursor(uint64_t index, uint64_t sequence) const;
+    [[nodiscard]] uint64_t nextEntry(uint64_t sequence) const;
+    [[nodiscard]] uint64_t getSlotCount(uint64_t recordSize) const;
+    [[nodiscard]] char* getSlot(uint64_t sequence) const;
+    [[nodiscard]] bool isSubmitted(uint64_t sequence) const;
+    void syncSlots(uint64_t first, uint64_t last) const;
+    void syncRange(size_t offset, size_t size) const;
+
+    std::string m_Path;
+    int m_File { -1 };
+    char* m_pData {};
+    size_t m_Size {};
+    Header* m_pHeader {};
+    uint64_t m_EntryCount {};
+    uint64_t m_SyncedTail {};
+    // the index of the head entry since the spool was opened
+    uint64_t m_HeadIndex {};
+    // index and sequence number of the entries after the pages that were read,
+    // so reading the next page and removing a page that was read don't rescan the spool
+    mutable std::deque<std::pair<uint64_t, uint64_t>> m_Cursors;
+    mutable std::mutex m_Mutex;
+};
+
+#endif
@@ -0,0 +1,110 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "timerwheel.h"
+
+#include <algorithm>
+
+using namespace std;
+
+static const uint64_t BITS_PER_LEVEL = 6;
+static const uint64_t SLOT_MASK = TimerWheel::SLOTS_PER_LEVEL - 1;
+
+TimerWheel::TimerId TimerWheel::schedule(uint64_t delayTicks, Callback callback)
+{
+    delayTicks = clamp<uint64_t>(delayTicks, 1, MAX_DELAY_TICKS);
+
+    TimerId id = m_NextId++;
+    insert(Timer { id, m_CurrentTick + delayTicks, std::move(callback) });
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    auto iter = m_Locations.find(id);
+    if (iter == m_Locations.end()) {
+        return false;
+    }
+
+    const Location& location = iter->second;
+    m_Levels[location.level][location.slot].erase(location.it);
+    m_Locations.erase(iter);
+    return true;
+}
+
+vector<TimerWheel::ExpiredTimer> TimerWheel::advance(uint64_t ticks)
+{
+    vector<ExpiredTimer> expired;
+
+    for (uint64_t i = 0; i < ticks; ++i) {
+        ++m_CurrentTick;
+
+        // when a level wraps around, the next slot of the level above
+        // is redistributed over the lower levels
+        for (size_t level = 1; level < LEVELS; ++level) {
+            if (((m_CurrentTick >> (BITS_PER_LEVEL * (level - 1))) & SLOT_MASK) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        Slot& slot = m_Levels[0][m_CurrentTick & SLOT_MASK];
+        for (auto& timer : slot) {
+            m_Locations.erase(timer.id);
+            expired.push_back(ExpiredTimer { timer.id, std::move(timer.callback) });
+        }
+        slot.clear();
+    }
+
+    return expired;
+}
+
+uint64_t TimerWheel::getCurrentTick() const
+{
+    return m_CurrentTick;
+}
+
+size_t TimerWheel::size() const
+{
+    return m_Locations.size();
+}
+
+void TimerWheel::insert(Timer timer)
+{
+    uint64_t delta = timer.expiry - m_CurrentTick;
+
+    size_t level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (BITS_PER_LEVEL * (level + 1)))) {
+        ++level;
+    }
+
+    size_t slotIndex = (timer.expiry >> (BITS_PER_LEVEL * level)) & SLOT_MASK;
+    Slot& slot = m_Levels[level][slotIndex];
+    TimerId id = timer.id;
+    slot.push_back(std::move(timer));
+    m_Locations[id] = Location { level, slotIndex, std::prev(slot.end()) };
+}
+
+void TimerWheel::cascade(size_t level)
+{
+    size_t slotIndex = (m_CurrentTick >> (BITS_PER_LEVEL * level)) & SLOT_MASK;
+
+    Slot timers;
+    timers.swap(m_Levels[level][slotIndex]);
+    for (auto& timer : timers) {
+        insert(std::move(timer));
+    }
+}
@@ -0,0 +1,105 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file timerwheel.h
+ * @brief Contains the TimerWheel class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/** The TimerWheel class is a hierarchical timing wheel. Scheduling and
+ * cancelling a timer are O(1), advancing the wheel by one tick only
+ * touches the timers that expire in that tick (and occasionally cascades
+ * one slot of a higher level). The wheel itself is not thread safe and
+ * does not keep time, the owner decides how long a tick lasts.
+ */
+class TimerWheel {
+public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    /** \brief An expired timer, returned by advance() */
+    struct ExpiredTimer {
+        TimerId id; /**< \brief the id returned by schedule() */
+        Callback callback; /**< \brief the callback of the timer */
+    };
+
+    /** \brief Number of slots on each level of the wheel */
+    static constexpr uint64_t SLOTS_PER_LEVEL = 64;
+    /** \brief Number of levels of the wheel */
+    static constexpr size_t LEVELS = 4;
+    /** \brief Longest delay that can be scheduled, longer delays are clamped */
+    static constexpr uint64_t MAX_DELAY_TICKS = SLOTS_PER_LEVEL * SLOTS_PER_LEVEL * SLOTS_PER_LEVEL * SLOTS_PER_LEVEL - 1;
+
+    /** Schedule a timer
+     * \param delayTicks the number of ticks after which the timer expires (minimum 1)
+     * \param callback the function that is returned when the timer expires
+     * \return the id of the timer that can be used to cancel it
+     */
+    TimerId schedule(uint64_t delayTicks, Callback callback);
+
+    /** Cancel a timer
+     * \param id the id of the timer
+     * \return false if the timer was unknown or already expired
+     */
+    bool cancel(TimerId id);
+
+    /** Advance the wheel
+     * \param ticks the number of ticks to advance
+     * \return the timers that expired, in order of expiry
+     */
+    std::vector<ExpiredTimer> advance(uint64_t ticks = 1);
+
+    /** \brief returns the number of ticks the wheel has advanced */
+    [[nodiscard]] uint64_t getCurrentTick() const;
+    /** \brief returns the number of pending timers */
+    [[nodiscard]] size_t size() const;
+
+private:
+    struct Timer {
+        TimerId id;
+        uint64_t expiry;
+        Callback callback;
+    };
+
+    using Slot = std::list<Timer>;
+
+    struct Location {
+        size_t level;
+        size_t slot;
+        Slot::iterator it;
+    };
+
+    void insert(Timer timer);
+    void cascade(size_t level);
+
+    std::array<std::array<Slot, SLOTS_PER_LEVEL>, LEVELS> m_Levels;
+    std::unordered_map<TimerId, Location> m_Locations;
+    uint64_t m_CurrentTick {};
+    TimerId m_NextId { 1 };
+};
+
+#endif
@@ -0,0 +1,84 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "tokenbucket.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+TokenBucket::TokenBucket(double tokensPerSecond, double burst)
+: m_TokensPerSecond(tokensPerSecond)
+, m_Burst(max(burst, 1.0))
+, m_Tokens(m_Burst)
+, m_LastRefill(steady_clock::now())
+{
+}
+
+void TokenBucket::setRate(double tokensPerSecond, double burst)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    refill(steady_clock::now());
+    m_TokensPerSecond = tokensPerSecond;
+    m_Burst = max(burst, 1.0);
+    m_Tokens = min(m_Tokens, m_Burst);
+}
+
+steady_clock::duration TokenBucket::reserve()
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    if (m_TokensPerSecond <= 0) {
+        return steady_clock::duration::zero();
+    }
+
+    refill(steady_clock::now());
+    m_Tokens -= 1.0;
+    if (m_Tokens >= 0) {
+        return steady_clock::duration::zero();
+    }
+
+    // the token is borrowed from the future, the debt is paid off at the refill rate
+    return duration_cast<steady_clock::duration>(duration<double>(-m_Tokens / m_TokensPerSecond));
+}
+
+void TokenBucket::cancel()
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    if (m_TokensPerSecond <= 0) {
+        return;
+    }
+
+    refill(steady_clock::now());
+    m_Tokens = min(m_Burst, m_Tokens + 1.0);
+}
+
+steady_clock::duration TokenBucket::acquire()
+{
+    auto wait = reserve();
+    if (wait > steady_clock::duration::zero()) {
+        this_thread::sleep_for(wait);
+    }
+    return wait;
+}
+
+void TokenBucket::refill(steady_clock::time_point now)
+{
+    duration<double> elapsed = now - m_LastRefill;
+    m_LastRefill = now;
+    m_Tokens = min(m_Burst, m_Tokens + elapsed.count() * m_TokensPerSecond);
+}
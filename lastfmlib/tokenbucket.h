@@ -0,0 +1,73 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file tokenbucket.h
+ * @brief Contains the TokenBucket class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <chrono>
+#include <mutex>
+
+/** The TokenBucket class limits the rate of events. Tokens are added at a
+ * fixed rate up to the burst size, every event takes one token. Tokens
+ * are reserved in advance so callers are served in the order they
+ * arrive instead of being rejected.
+ */
+class TokenBucket {
+public:
+    /** Constructor
+     * \param tokensPerSecond the sustained rate, 0 disables the limit
+     * \param burst the maximum number of tokens that can be saved up
+     */
+    TokenBucket(double tokensPerSecond, double burst);
+
+    /** Change the rate of the bucket
+     * \param tokensPerSecond the sustained rate, 0 disables the limit
+     * \param burst the maximum number of tokens that can be saved up
+     */
+    void setRate(double tokensPerSecond, double burst);
+
+    /** Take a token, if none is available the token is taken in advance
+     * \return the time the caller has to wait before the token can be used
+     */
+    std::chrono::steady_clock::duration reserve();
+
+    /** Give back a reserved token that was not used, e.g. because the
+     * caller stopped waiting for it
+     */
+    void cancel();
+
+    /** Take a token and sleep until it can be used
+     * \return the time that was waited
+     */
+    std::chrono::steady_clock::duration acquire();
+
+private:
+    void refill(std::chrono::steady_clock::time_point now);
+
+    double m_TokensPerSecond;
+    double m_Burst;
+    double m_Tokens;
+    std::chrono::steady_clock::time_point m_LastRefill;
+    std::mutex m_Mutex;
+};
+
+#endif
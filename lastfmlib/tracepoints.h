@@ -0,0 +1,52 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file tracepoints.h
+ * @brief Contains the static tracepoints of lastfmlib
+ * @author Dirk Vanden Boer
+ *
+ * The tracepoints are USDT probes of the lastfmlib provider, they are
+ * compiled in when the library is configured with -Dusdt=enabled. An
+ * unattached probe is a nop instruction and its arguments are only read
+ * by an attached tracer, e.g.
+ * bpftrace -e 'usdt:/usr/lib/liblastfmlib.so:lastfmlib:request__done { @[arg0, arg1] = hist(arg2); }'
+ *
+ * Probes and their arguments:
+ * - request__start(endpoint, tracks): a handshake (0), Now Playing (1) or submission (2) request is started
+ * - request__done(endpoint, status, latency in us, tracks): the request finished with a FlightStatus
+ * - http__start(url, body bytes): UrlClient starts a GET (no body) or POST
+ * - http__done(url, curl result code, response bytes)
+ * - queue__add(buffered tracks): a track was added to a SubmissionInfoCollection
+ * - queue__remove(removed tracks, buffered tracks)
+ * - scrobbler__authenticated(0 or 1): the scrobbler gained or lost its session
+ * - scrobbler__started(artist, track), scrobbler__finished(), scrobbler__paused(0 or 1): player events
+ * - scrobbler__buffered(buffered tracks): the number of tracks waiting to be submitted changed
+ */
+
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+#ifdef LASTFMLIB_ENABLE_USDT
+#include <sys/sdt.h>
+
+#define LASTFMLIB_TRACE(...) STAP_PROBEV(lastfmlib, __VA_ARGS__)
+#else
+// the arguments are not evaluated
+#define LASTFMLIB_TRACE(...) static_cast<void>(0)
+#endif
+
+#endif
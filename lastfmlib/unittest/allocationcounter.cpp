@@ -0,0 +1,128 @@
+#include "allocationcounter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <curl/curl.h>
+#include <new>
+
+namespace {
+struct ThreadAllocations {
+    bool active;
+    uint64_t count;
+    uint64_t bytes;
+};
+
+// constant initialized, so it can be used inside malloc
+thread_local ThreadAllocations g_Allocations = { false, 0, 0 };
+
+void countAllocation(size_t size)
+{
+    if (g_Allocations.active) {
+        ++g_Allocations.count;
+        g_Allocations.bytes += size;
+    }
+}
+} // namespace
+
+#ifdef __GLIBC__
+// glibc allows replacing malloc, operator new of libstdc++ ends up here as well
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pData, size_t size);
+void __libc_free(void* pData);
+
+void* malloc(size_t size)
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pData, size_t size)
+{
+    countAllocation(size);
+    return __libc_realloc(pData, size);
+}
+
+void free(void* pData)
+{
+    __libc_free(pData);
+}
+}
+
+namespace {
+char* uncountedStrdup(const char* pString)
+{
+    size_t size = strlen(pString) + 1;
+    auto* pCopy = static_cast<char*>(__libc_malloc(size));
+    if (pCopy) {
+        memcpy(pCopy, pString, size);
+    }
+    return pCopy;
+}
+
+// libcurl allocates through the uncounted glibc functions, so only the
+// allocations of lastfmlib are counted. The initialization stays active for
+// the lifetime of the allocation tests, the curl_global_init calls of UrlClient
+// only increment its reference count.
+struct UncountedCurlAllocations {
+    UncountedCurlAllocations()
+    {
+        curl_global_init_mem(CURL_GLOBAL_ALL, __libc_malloc, __libc_free, __libc_realloc, uncountedStrdup, __libc_calloc);
+    }
+
+    ~UncountedCurlAllocations()
+    {
+        curl_global_cleanup();
+    }
+};
+
+UncountedCurlAllocations g_UncountedCurlAllocations;
+} // namespace
+#else
+void* operator new(size_t size)
+{
+    countAllocation(size);
+    if (void* pData = std::malloc(size)) {
+        return pData;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pData) noexcept
+{
+    std::free(pData);
+}
+
+void operator delete(void* pData, size_t) noexcept
+{
+    std::free(pData);
+}
+#endif
+
+AllocationCounter::AllocationCounter()
+{
+    g_Allocations = { true, 0, 0 };
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    g_Allocations.active = false;
+}
+
+uint64_t AllocationCounter::getCount() const
+{
+    return g_Allocations.count;
+}
+
+uint64_t AllocationCounter::getBytes() const
+{
+    return g_Allocations.bytes;
+}
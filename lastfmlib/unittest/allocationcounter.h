@@ -0,0 +1,25 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/** Counts the heap allocations (malloc, calloc, realloc and operator new)
+ * made by the current thread while the counter exists. Allocations of
+ * other threads, e.g. the stand-in server, and the allocations of libcurl
+ * are not counted. On glibc malloc is replaced, other C libraries only
+ * count operator new. The replacement applies to the whole process, so the
+ * counter is only linked into the allocation test executable.
+ */
+class AllocationCounter {
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+    AllocationCounter(const AllocationCounter&) = delete;
+    AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+    uint64_t getCount() const;
+    uint64_t getBytes() const;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include "allocationcounter.h"
+#include "lastfmlib/lastfmclient.h"
+#include "lastfmlib/lastfmscrobbler.h"
+#include "lastfmlib/nowplayinginfo.h"
+#include "lastfmlib/submissioninfo.h"
+#include "lastfmlib/submissioninfocollection.h"
+#include "scrobbleserverstub.h"
+
+#include <chrono>
+#include <ctime>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+// Upper bounds of the heap allocations of the hot paths. Only the allocations
+// of lastfmlib are counted, libcurl allocates through uncounted functions (see
+// allocationcounter.cpp). The bounds have a little headroom over the numbers
+// measured with glibc and libstdc++, the request and scrobble cycle bounds
+// include the allocations of the libstdc++ containers and streams. Other C
+// libraries only count operator new, so the tests are skipped there. Lower
+// the bounds when an optimization reduces the allocations. The measured
+// number is reported as the "allocations" property of the test.
+static const uint64_t NOW_PLAYING_POST_DATA_ALLOCATIONS = 2;
+static const uint64_t COLLECTION_POST_DATA_ALLOCATIONS = 110; // 50 tracks
+static const uint64_t REQUEST_ALLOCATIONS = 8; // the request and response handling of LastFmClient
+static const uint64_t SCROBBLE_CYCLE_ALLOCATIONS = 30; // a submission and a Now Playing request
+
+static void expectAllocationsAtMost(uint64_t bound, const AllocationCounter& counter)
+{
+    uint64_t count = counter.getCount();
+    testing::Test::RecordProperty("allocations", static_cast<int>(count));
+    EXPECT_LE(count, bound);
+}
+
+class AllocationTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+#ifndef __GLIBC__
+        GTEST_SKIP() << "The allocation bounds assume the malloc replacement of glibc";
+#endif
+    }
+};
+
+static SubmissionInfo createSubmissionInfo(int index, time_t timeStarted)
+{
+    SubmissionInfo info("Sigur Rós", "Track " + to_string(index), timeStarted);
+    info.setAlbum("Takk...");
+    info.setTrackLength(268);
+    info.setTrackNr(index + 1);
+    return info;
+}
+
+TEST_F(AllocationTest, CounterSeesAllocations)
+{
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    string text;
+    {
+        AllocationCounter counter;
+        text.assign(100, 'x');
+        count = counter.getCount();
+        bytes = counter.getBytes();
+    }
+
+    EXPECT_EQ(100u, text.size());
+    EXPECT_EQ(1u, count);
+    EXPECT_LE(101u, bytes);
+}
+
+TEST_F(AllocationTest, NowPlayingInfoPostData)
+{
+    NowPlayingInfo info("Sigur Rós", "Hoppípolla");
+    info.setAlbum("Takk...");
+    info.setTrackLength(268);
+    info.setTrackNr(2);
+
+    AllocationCounter counter;
+    string postData = info.getPostData();
+    expectAllocationsAtMost(NOW_PLAYING_POST_DATA_ALLOCATIONS, counter);
+    EXPECT_FALSE(postData.empty());
+}
+
+TEST_F(AllocationTest, SubmissionInfoCollectionPostData)
+{
+    SubmissionInfoCollection collection;
+    for (int i = 0; i < 50; ++i) {
+        collection.addInfo(createSubmissionInfo(i, time(nullptr) - 300 * (50 - i)), time(nullptr));
+    }
+
+    AllocationCounter counter;
+    const string& postData = collection.getPostData();
+    expectAllocationsAtMost(COLLECTION_POST_DATA_ALLOCATIONS, counter);
+    EXPECT_FALSE(postData.empty());
+}
+
+TEST_F(AllocationTest, LastFmClientRequests)
+{
+    ScrobbleServerStub server;
+
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+    client.handshake("user", "pass");
+    // the first requests initialize the metrics
+    NowPlayingInfo info("Artist", "Track");
+    client.nowPlaying(info);
+    SubmissionInfo track = createSubmissionInfo(0, time(nullptr) - 300);
+    client.submit(track);
+
+    {
+        AllocationCounter counter;
+        client.nowPlaying(info);
+        expectAllocationsAtMost(REQUEST_ALLOCATIONS, counter);
+    }
+    {
+        AllocationCounter counter;
+        client.submit(track);
+        expectAllocationsAtMost(REQUEST_ALLOCATIONS, counter);
+    }
+    EXPECT_EQ(2, server.m_SubmittedTracks);
+}
+
+TEST_F(AllocationTest, ScrobbleCycle)
+{
+    ScrobbleServerStub server;
+
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.authenticate();
+
+    // the previous track was played long enough, so every track change submits it
+    scrobbler.startedPlaying(createSubmissionInfo(0, time(nullptr) - 300));
+    scrobbler.startedPlaying(createSubmissionInfo(1, time(nullptr) - 300));
+    ASSERT_EQ(1, server.m_SubmittedTracks);
+
+    SubmissionInfo next = createSubmissionInfo(2, time(nullptr) - 300);
+    {
+        AllocationCounter counter;
+        scrobbler.startedPlaying(next);
+        expectAllocationsAtMost(SCROBBLE_CYCLE_ALLOCATIONS, counter);
+    }
+    EXPECT_EQ(2, server.m_SubmittedTracks);
+    EXPECT_EQ(3, server.m_NowPlayingRequests);
+}
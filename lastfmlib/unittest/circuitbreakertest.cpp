@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/circuitbreaker.h"
+#include "lastfmlib/lastfmclient.h"
+#include "lastfmlib/nowplayinginfo.h"
+#include "scrobbleserverstub.h"
+
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+TEST(CircuitBreakerTest, OpensAfterConsecutiveFailures)
+{
+    CircuitBreaker circuit({ 3, 50ms });
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_TRUE(circuit.allowRequest());
+        circuit.recordFailure();
+    }
+
+    // a success resets the failure count
+    EXPECT_TRUE(circuit.allowRequest());
+    circuit.recordSuccess();
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(CircuitBreaker::State::Closed, circuit.getState());
+        EXPECT_TRUE(circuit.allowRequest());
+        circuit.recordFailure();
+    }
+
+    EXPECT_EQ(CircuitBreaker::State::Open, circuit.getState());
+    EXPECT_FALSE(circuit.allowRequest());
+    EXPECT_EQ(1u, circuit.getRejectedCount());
+}
+
+TEST(CircuitBreakerTest, SingleProbe)
+{
+    CircuitBreaker circuit({ 1, 50ms });
+    EXPECT_TRUE(circuit.allowRequest());
+    circuit.recordFailure();
+    EXPECT_FALSE(circuit.allowRequest());
+
+    this_thread::sleep_for(60ms);
+    EXPECT_TRUE(circuit.allowRequest());
+    EXPECT_EQ(CircuitBreaker::State::HalfOpen, circuit.getState());
+    EXPECT_FALSE(circuit.allowRequest());
+
+    // a failed probe opens the circuit for another period
+    circuit.recordFailure();
+    EXPECT_EQ(CircuitBreaker::State::Open, circuit.getState());
+    EXPECT_FALSE(circuit.allowRequest());
+
+    this_thread::sleep_for(60ms);
+    EXPECT_TRUE(circuit.allowRequest());
+    circuit.recordSuccess();
+    EXPECT_EQ(CircuitBreaker::State::Closed, circuit.getState());
+    EXPECT_TRUE(circuit.allowRequest());
+}
+
+TEST(CircuitBreakerTest, Disabled)
+{
+    CircuitBreaker circuit({ 0, 50ms });
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(circuit.allowRequest());
+        circuit.recordFailure();
+    }
+    EXPECT_EQ(CircuitBreaker::State::Closed, circuit.getState());
+}
+
+TEST(CircuitBreakerTest, ClientFailsFast)
+{
+    ScrobbleServerStub server;
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+    client.setCircuitBreakerPolicy({ 2, 100ms });
+    client.handshake("user", "pass");
+
+    server.setOnline(false);
+    NowPlayingInfo info("Artist", "Track");
+    EXPECT_THROW(client.nowPlaying(info), ConnectionError);
+    EXPECT_THROW(client.nowPlaying(info), ConnectionError);
+    EXPECT_EQ(CircuitBreaker::State::Open, client.getCircuitState(LastFmClient::Endpoint::NowPlaying));
+    EXPECT_EQ(CircuitBreaker::State::Closed, client.getCircuitState(LastFmClient::Endpoint::Submission));
+
+    server.setOnline(true);
+    EXPECT_THROW(client.nowPlaying(info), ConnectionError);
+    EXPECT_EQ(0, server.m_NowPlayingRequests);
+    EXPECT_EQ(1u, client.getCircuitRejectedCount());
+
+    this_thread::sleep_for(120ms);
+    client.nowPlaying(info);
+    EXPECT_EQ(1, server.m_NowPlayingRequests);
+    EXPECT_EQ(CircuitBreaker::State::Closed, client.getCircuitState(LastFmClient::Endpoint::NowPlaying));
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/flightrecorder.h"
+#include "lastfmlib/lastfmclient.h"
+#include "lastfmlib/nowplayinginfo.h"
+#include "scrobbleserverstub.h"
+
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+TEST(FlightRecorderTest, KeepsMostRecentRecords)
+{
+    FlightRecorder recorder(3);
+    EXPECT_TRUE(recorder.getRecords().empty());
+
+    for (size_t i = 1; i <= 5; ++i) {
+        recorder.setQueueDepth(i * 10);
+        recorder.record(FlightEvent::Submission, FlightStatus::Ok, milliseconds(i), i);
+    }
+
+    auto records = recorder.getRecords();
+    ASSERT_EQ(3u, records.size());
+    EXPECT_EQ(3u, records[0].tracks);
+    EXPECT_EQ(4u, records[1].tracks);
+    EXPECT_EQ(5u, records[2].tracks);
+    EXPECT_EQ(50u, records[2].queueDepth);
+    EXPECT_EQ(5000u, records[2].latency);
+    // the timestamp is the start of the request
+    EXPECT_LE(records[0].timestamp + records[0].latency, records[2].timestamp + records[2].latency);
+}
+
+TEST(FlightRecorderTest, DumpOnRequest)
+{
+    FlightRecorder recorder;
+    recorder.record(FlightEvent::NowPlaying, FlightStatus::Ok, milliseconds(12), 1);
+
+    vector<FlightDumpReason> reasons;
+    size_t dumpedRecords = 0;
+    recorder.setDumpHandler([&](FlightDumpReason reason, const vector<FlightRecord>& records) {
+        reasons.push_back(reason);
+        dumpedRecords = records.size();
+    });
+
+    recorder.dump();
+    ASSERT_EQ(1u, reasons.size());
+    EXPECT_EQ(FlightDumpReason::Requested, reasons[0]);
+    EXPECT_EQ(1u, dumpedRecords);
+
+    string line = FlightRecorder::toString(recorder.getRecords()[0]);
+    EXPECT_NE(string::npos, line.find("nowplaying OK latency 12.0 ms tracks 1"));
+}
+
+TEST(FlightRecorderTest, AutomaticDumps)
+{
+    FlightRecorder recorder;
+    vector<FlightDumpReason> reasons;
+    recorder.setDumpHandler([&](FlightDumpReason reason, const vector<FlightRecord>&) { reasons.push_back(reason); });
+
+    // a single invalid session is normal, the new session is rejected as well
+    recorder.record(FlightEvent::Submission, FlightStatus::BadSession);
+    EXPECT_TRUE(reasons.empty());
+    recorder.record(FlightEvent::Handshake, FlightStatus::Ok);
+    recorder.record(FlightEvent::Submission, FlightStatus::BadSession);
+    ASSERT_EQ(1u, reasons.size());
+    EXPECT_EQ(FlightDumpReason::RepeatedBadSession, reasons[0]);
+
+    // automatic dumps are limited to one per minute
+    recorder.record(FlightEvent::TrackDropped, FlightStatus::Failed);
+    EXPECT_EQ(1u, reasons.size());
+
+    FlightRecorder other;
+    other.setDumpHandler([&](FlightDumpReason reason, const vector<FlightRecord>&) { reasons.push_back(reason); });
+    other.record(FlightEvent::Handshake, FlightStatus::ConnectionError);
+    ASSERT_EQ(2u, reasons.size());
+    EXPECT_EQ(FlightDumpReason::HardFailure, reasons[1]);
+}
+
+TEST(FlightRecorderTest, RecordsClientRequests)
+{
+    ScrobbleServerStub server;
+
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+
+    vector<FlightDumpReason> reasons;
+    client.getFlightRecorder().setDumpHandler([&](FlightDumpReason reason, const vector<FlightRecord>&) { reasons.push_back(reason); });
+
+    client.handshake("user", "pass");
+    client.nowPlaying(NowPlayingInfo("Artist", "Track"));
+    server.invalidateSessions();
+    EXPECT_THROW(client.nowPlaying(NowPlayingInfo("Artist", "Track")), BadSessionError);
+    EXPECT_THROW(client.nowPlaying(NowPlayingInfo("Artist", "Track")), BadSessionError);
+
+    auto records = client.getFlightRecorder().getRecords();
+    ASSERT_EQ(4u, records.size());
+    EXPECT_EQ(FlightEvent::Handshake, records[0].event);
+    EXPECT_EQ(FlightStatus::Ok, records[0].status);
+    EXPECT_EQ(FlightEvent::NowPlaying, records[1].event);
+    EXPECT_EQ(FlightStatus::Ok, records[1].status);
+    EXPECT_EQ(FlightStatus::BadSession, records[2].status);
+    EXPECT_EQ(FlightStatus::BadSession, records[3].status);
+
+    ASSERT_EQ(1u, reasons.size());
+    EXPECT_EQ(FlightDumpReason::RepeatedBadSession, reasons[0]);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/handshakeadmission.h"
+#include "lastfmlib/lastfmclient.h"
+#include "scrobbleserverstub.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+TEST(HandshakeAdmissionTest, AdmittedInOrder)
+{
+    HandshakeAdmission admission(1, 0, 1);
+    admission.acquire();
+
+    mutex orderMutex;
+    vector<int> order;
+    vector<thread> threads;
+    for (int i = 0; i < 5; ++i) {
+        threads.emplace_back([&, i] {
+            HandshakeAdmission::Ticket ticket(admission);
+            auto lock = std::scoped_lock(orderMutex);
+            order.push_back(i);
+        });
+
+        while (admission.getQueueLength() != static_cast<uint64_t>(i + 1)) {
+            this_thread::yield();
+        }
+    }
+
+    admission.release();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(vector<int>({ 0, 1, 2, 3, 4 }), order);
+}
+
+TEST(HandshakeAdmissionTest, RateLimited)
+{
+    HandshakeAdmission admission(10, 50, 1);
+
+    auto start = steady_clock::now();
+    for (int i = 0; i < 6; ++i) {
+        HandshakeAdmission::Ticket ticket(admission);
+    }
+
+    EXPECT_GE(steady_clock::now() - start, milliseconds(90));
+}
+
+TEST(HandshakeAdmissionTest, CancelledWhileWaiting)
+{
+    // the first handshake takes the only token of the next second
+    HandshakeAdmission admission(1, 1, 1);
+    admission.acquire();
+    admission.release();
+
+    std::atomic<bool> cancelled {};
+    auto isCancelled = [&cancelled] { return cancelled.load(); };
+
+    bool admitted = true;
+    auto start = steady_clock::now();
+    thread waiter([&] { admitted = admission.acquire(isCancelled); });
+    while (admission.getQueueLength() != 1) {
+        this_thread::yield();
+    }
+
+    this_thread::sleep_for(milliseconds(50));
+    cancelled = true;
+    admission.interrupt();
+    waiter.join();
+
+    EXPECT_FALSE(admitted);
+    EXPECT_LT(steady_clock::now() - start, milliseconds(500));
+    EXPECT_EQ(0u, admission.getQueueLength());
+
+    // the cancelled session left the queue, the next one is admitted
+    admission.configure(1, 0, 1);
+    HandshakeAdmission::Ticket ticket(admission);
+}
+
+TEST(HandshakeAdmissionTest, CancelledWhileWaitingForSlot)
+{
+    HandshakeAdmission admission(1, 0, 1);
+    admission.acquire();
+
+    std::atomic<bool> cancelled {};
+    thread waiter([&] {
+        EXPECT_THROW(HandshakeAdmission::Ticket(admission, [&cancelled] { return cancelled.load(); }), ConnectionError);
+    });
+    while (admission.getQueueLength() != 1) {
+        this_thread::yield();
+    }
+
+    cancelled = true;
+    admission.interrupt();
+    waiter.join();
+
+    EXPECT_EQ(0u, admission.getQueueLength());
+    admission.release();
+}
+
+// All sessions retry while the server is offline and reconnect at the same
+// moment when it comes back, the server refuses handshakes when too many
+// of them run concurrently. Returns the time from the end of the outage
+// until all sessions are connected.
+static milliseconds simulateOutageRecovery(ScrobbleServerStub& server, HandshakeAdmission& admission, int sessions)
+{
+    server.setOnline(false);
+
+    vector<thread> threads;
+    for (int i = 0; i < sessions; ++i) {
+        threads.emplace_back([&, i] {
+            LastFmClient client;
+            client.setHandshakeUrl(server.getHandshakeUrl());
+
+            for (;;) {
+                try {
+                    HandshakeAdmission::Ticket ticket(admission);
+                    client.handshake("user" + std::to_string(i), LastFmClient::generatePasswordHash("pass"));
+                    return;
+                } catch (const std::exception&) {
+                    this_thread::sleep_for(milliseconds(50));
+                }
+            }
+        });
+    }
+
+    this_thread::sleep_for(milliseconds(100));
+    auto start = steady_clock::now();
+    server.setOnline(true);
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    return duration_cast<milliseconds>(steady_clock::now() - start);
+}
+
+TEST(HandshakeAdmissionTest, OutageRecovery)
+{
+    const int sessions = 24;
+
+    ScrobbleServerStub server;
+    server.setLatency(milliseconds(20));
+    server.setMaxConcurrentHandshakes(4);
+
+    HandshakeAdmission unlimited(sessions, 0, 1);
+    auto unlimitedTime = simulateOutageRecovery(server, unlimited, sessions);
+    int unlimitedRejections = server.m_RejectedHandshakes;
+
+    server.m_RejectedHandshakes = 0;
+    server.m_MaxObservedConcurrentHandshakes = 0;
+
+    HandshakeAdmission limited(4, 200, 4);
+    auto limitedTime = simulateOutageRecovery(server, limited, sessions);
+
+    RecordProperty("UnlimitedRecoveryMs", static_cast<int>(unlimitedTime.count()));
+    RecordProperty("UnlimitedRejectedHandshakes", unlimitedRejections);
+    RecordProperty("LimitedRecoveryMs", static_cast<int>(limitedTime.count()));
+
+    EXPECT_GT(unlimitedRejections, 0);
+    EXPECT_EQ(0, server.m_RejectedHandshakes);
+    EXPECT_LE(server.m_MaxObservedConcurrentHandshakes, 4);
+    EXPECT_EQ(2 * sessions, server.m_Handshakes);
+}
@@ -20,6 +20,7 @@ void LastFmClientMock::handshake(const std::string& user, const std::string& pas
 void LastFmClientMock::nowPlaying(const NowPlayingInfo& info)
 {
     m_NowPlayingCalled = true;
+    ++m_NowPlayingCount;
     m_LastRecPlayingInfo = info;
 
     if (m_BadSessionError) {
@@ -42,10 +43,18 @@ void LastFmClientMock::submit(const SubmissionInfo& info)
 void LastFmClientMock::submit(const SubmissionInfoCollection& infoCollection)
 {
     m_SubmitCollectionCalled = true;
+    ++m_SubmitCollectionCount;
     m_LastRecSubmitInfoCollection = infoCollection;
 
     if (m_BadSessionError) {
         m_BadSessionError = false;
         throw BadSessionError("");
     }
+
+    for (size_t i = 0; i < infoCollection.size(); ++i) {
+        if (infoCollection.getInfo(i).getArtist() == m_RejectedArtist) {
+            throw logic_error("Failed to submit info: FAILED");
+        }
+    }
+    m_SubmittedTracks += static_cast<int>(infoCollection.size());
 }
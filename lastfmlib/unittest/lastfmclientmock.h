@@ -24,6 +24,10 @@ public:
     bool m_SubmitCalled {};
     bool m_SubmitCollectionCalled {};
     bool m_HandshakeCalled {};
+    int m_NowPlayingCount {};
+    int m_SubmitCollectionCount {};
+    int m_SubmittedTracks {};
+    std::string m_RejectedArtist;
 
     NowPlayingInfo m_LastRecPlayingInfo;
     SubmissionInfo m_LastRecSubmitInfo;
@@ -2,8 +2,14 @@
 
 #include "lastfmlib/lastfmclient.h"
 #include "lastfmlib/lastfmscrobbler.h"
+#include "lastfmlib/nowplayinginfo.h"
+#include "scrobbleserverstub.h"
+
+#include <atomic>
 #include <ctime>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 
 using std::string;
 
@@ -46,3 +52,66 @@ TEST(LastFmClientTest, LastFmClient)
     //~ //lastFm.nowPlaying(info);
     //~ lastFm.submit(info);
 }
+
+TEST(LastFmClientTest, TransferObserver)
+{
+    ScrobbleServerStub server;
+    server.setLatency(std::chrono::milliseconds(20));
+
+    std::vector<std::pair<LastFmClient::Endpoint, TransferTiming>> transfers;
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+    client.setTransferObserver([&transfers](LastFmClient::Endpoint endpoint, const TransferTiming& timing) {
+        transfers.emplace_back(endpoint, timing);
+    });
+
+    client.handshake("user", "pass");
+    client.nowPlaying(NowPlayingInfo("Artist", "Track"));
+
+    ASSERT_EQ(2u, transfers.size());
+    EXPECT_EQ(LastFmClient::Endpoint::Handshake, transfers[0].first);
+    EXPECT_EQ(LastFmClient::Endpoint::NowPlaying, transfers[1].first);
+
+    const TransferTiming& timing = transfers[1].second;
+    EXPECT_LE(timing.nameLookup, timing.connect);
+    EXPECT_LE(timing.connect, timing.startTransfer);
+    EXPECT_LE(timing.startTransfer, timing.total);
+    EXPECT_GE(timing.startTransfer, std::chrono::milliseconds(20));
+    EXPECT_EQ(std::chrono::microseconds(0), timing.appConnect);
+    EXPECT_GT(timing.bytesSent, 0u);
+    EXPECT_GT(timing.bytesReceived, 0u);
+
+    // failed requests that reached curl are reported as well
+    server.setOnline(false);
+    EXPECT_THROW(client.nowPlaying(NowPlayingInfo("Artist", "Track")), ConnectionError);
+    EXPECT_EQ(3u, transfers.size());
+}
+
+TEST(LastFmClientTest, SessionReplacedDuringRequests)
+{
+    ScrobbleServerStub server;
+
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+    client.handshake("user", "pass");
+
+    // the session is replaced while the requests read it
+    LastFmSession session = client.getSession();
+    std::atomic<bool> done {};
+    std::thread authThread([&] {
+        while (!done) {
+            client.setSession(session);
+        }
+    });
+
+    SubmissionInfo info("Artist", "Track", time(nullptr) - 300);
+    info.setTrackLength(200);
+    for (int i = 0; i < 20; ++i) {
+        client.submit(info);
+    }
+    done = true;
+    authThread.join();
+
+    EXPECT_EQ(20, server.m_SubmittedTracks);
+    EXPECT_EQ(session.sessionId, client.getSession().sessionId);
+}
@@ -1,9 +1,14 @@
 #include <gtest/gtest.h>
 
 #include "lastfmclientmock.h"
+#include "lastfmlib/handshakeadmission.h"
 #include "lastfmlib/lastfmscrobbler.h"
+#include "scrobbleserverstub.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <ctime>
+#include <fstream>
 #include <iostream>
 #include <unistd.h>
 
@@ -121,3 +126,817 @@ TEST(LastFmScrobblerTest, LastFmScrobblerBadSession)
     EXPECT_TRUE(scrobbler.pMock->m_SubmitCollectionCalled);
     EXPECT_TRUE(scrobbler.pMock->m_HandshakeCalled);
 }
+
+TEST(LastFmScrobblerTest, LastFmScrobblerDuplicateNowPlaying)
+{
+    LastFmScrobblerTester scrobbler(true);
+    scrobbler.setNowPlayingDuplicateTtl(60s);
+
+    SubmissionInfo info1("Artist1", "Track1");
+    SubmissionInfo info2("Artist2", "Track2");
+
+    scrobbler.startedPlaying(info1);
+    scrobbler.startedPlaying(info1);
+    EXPECT_EQ(1, scrobbler.pMock->m_NowPlayingCount);
+
+    scrobbler.startedPlaying(info2);
+    EXPECT_EQ(2, scrobbler.pMock->m_NowPlayingCount);
+    EXPECT_EQ("Artist2", scrobbler.pMock->m_LastRecPlayingInfo.getArtist());
+
+    ScrobblerStatistics stats = scrobbler.getStatistics();
+    EXPECT_EQ(2u, stats.nowPlayingSent);
+    EXPECT_EQ(1u, stats.nowPlayingSuppressed);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerNowPlayingCoalesced)
+{
+    LastFmScrobblerTester scrobbler(false);
+    scrobbler.setNowPlayingDebounce(500ms);
+    scrobbler.authenticate();
+    scrobbler.waitForAuthenticationFinish();
+
+    SubmissionInfo info1("Artist1", "Track1");
+    SubmissionInfo info2("Artist2", "Track2");
+    SubmissionInfo info3("Artist3", "Track3");
+
+    scrobbler.startedPlaying(info1);
+    scrobbler.startedPlaying(info2);
+    scrobbler.startedPlaying(info3);
+    scrobbler.waitForSendInfoFinish();
+
+    EXPECT_EQ(1, scrobbler.pMock->m_NowPlayingCount);
+    EXPECT_EQ("Artist3", scrobbler.pMock->m_LastRecPlayingInfo.getArtist());
+
+    ScrobblerStatistics stats = scrobbler.getStatistics();
+    EXPECT_EQ(1u, stats.nowPlayingSent);
+    EXPECT_EQ(2u, stats.nowPlayingSuppressed);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerBatchedSubmission)
+{
+    LastFmScrobblerTester scrobbler(true);
+    scrobbler.setCommitOnlyMode(true);
+
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 3;
+    scrobbler.setBatchPolicy(policy);
+
+    SubmissionInfo info("Artist", "Track");
+    info.setTrackLength(100);
+
+    scrobbler.startedPlaying(info);
+    for (int i = 0; i < 2; ++i) {
+        scrobbler.setTrackPlayTime(100);
+        scrobbler.startedPlaying(info);
+        EXPECT_FALSE(scrobbler.pMock->m_SubmitCollectionCalled);
+    }
+
+    scrobbler.setTrackPlayTime(100);
+    scrobbler.startedPlaying(info);
+    EXPECT_TRUE(scrobbler.pMock->m_SubmitCollectionCalled);
+    EXPECT_EQ(3u, scrobbler.pMock->m_LastRecSubmitInfoCollection.size());
+
+    scrobbler.pMock->m_SubmitCollectionCalled = false;
+    scrobbler.setTrackPlayTime(100);
+    scrobbler.startedPlaying(info);
+    EXPECT_FALSE(scrobbler.pMock->m_SubmitCollectionCalled);
+
+    scrobbler.flush();
+    EXPECT_TRUE(scrobbler.pMock->m_SubmitCollectionCalled);
+    EXPECT_EQ(1u, scrobbler.pMock->m_LastRecSubmitInfoCollection.size());
+
+    ScrobblerStatistics stats = scrobbler.getStatistics();
+    EXPECT_EQ(2u, stats.submissionRequests);
+    EXPECT_EQ(4u, stats.tracksSubmitted);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerBatchAgeDeadline)
+{
+    ScrobbleServerStub server;
+
+    LastFmScrobbler scrobbler("user", "pass", false, false);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setCommitOnlyMode(true);
+
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 10;
+    policy.maxAgeInSecs = 1;
+    scrobbler.setBatchPolicy(policy);
+
+    // the player stops after a single track, the batch is submitted once it is old enough
+    SubmissionInfo info("Artist", "Track", time(nullptr) - 300);
+    info.setTrackLength(100);
+    scrobbler.startedPlaying(info);
+    scrobbler.finishedPlaying();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(0, server.m_SubmissionRequests);
+
+    for (int i = 0; i < 300 && server.m_SubmissionRequests == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(1, server.m_SubmissionRequests);
+    EXPECT_EQ(1, server.m_SubmittedTracks);
+
+    EXPECT_TRUE(scrobbler.shutdown(std::chrono::seconds(1)).empty());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerSessionCache)
+{
+    string cachePath = testing::TempDir() + "scrobblersessioncache";
+    std::remove(cachePath.c_str());
+
+    ScrobbleServerStub server;
+    SubmissionInfo info("Artist", "Track");
+
+    {
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setSessionCache(cachePath);
+        scrobbler.startedPlaying(info);
+    }
+    EXPECT_EQ(1, server.m_Handshakes);
+    EXPECT_EQ(1, server.m_NowPlayingRequests);
+
+    {
+        // the cached session is used without a handshake
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setSessionCache(cachePath);
+        scrobbler.startedPlaying(info);
+    }
+    EXPECT_EQ(1, server.m_Handshakes);
+    EXPECT_EQ(2, server.m_NowPlayingRequests);
+
+    server.invalidateSessions();
+    {
+        // the rejected session is replaced by a new handshake
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setSessionCache(cachePath);
+        scrobbler.startedPlaying(info);
+    }
+    EXPECT_EQ(2, server.m_Handshakes);
+    EXPECT_EQ(4, server.m_NowPlayingRequests);
+
+    std::remove(cachePath.c_str());
+}
+
+static void bufferTracks(LastFmScrobbler& scrobbler, int count)
+{
+    // tracks that started 5 minutes ago were played long enough to be committed
+    SubmissionInfo info("Artist", "Track", time(nullptr) - 300);
+    info.setTrackLength(100);
+
+    for (int i = 0; i <= count; ++i) {
+        scrobbler.startedPlaying(info);
+    }
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerShutdownFlushes)
+{
+    ScrobbleServerStub server;
+
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setCommitOnlyMode(true);
+
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 10;
+    scrobbler.setBatchPolicy(policy);
+
+    bufferTracks(scrobbler, 2);
+    EXPECT_EQ(0, server.m_SubmissionRequests);
+
+    EXPECT_TRUE(scrobbler.shutdown(5s).empty());
+    EXPECT_EQ(1, server.m_SubmissionRequests);
+    EXPECT_EQ(2, server.m_SubmittedTracks);
+
+    // the scrobbler ignores everything after the shutdown
+    bufferTracks(scrobbler, 2);
+    scrobbler.flush();
+    EXPECT_EQ(1, server.m_SubmissionRequests);
+    EXPECT_EQ(1, server.m_Handshakes);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerShutdownDeadline)
+{
+    ScrobbleServerStub server;
+
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setCommitOnlyMode(true);
+
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 10;
+    scrobbler.setBatchPolicy(policy);
+
+    std::vector<SubmissionInfo> handledTracks;
+    scrobbler.setUnsentTracksHandler([&](const std::vector<SubmissionInfo>& tracks) { handledTracks = tracks; });
+
+    bufferTracks(scrobbler, 2);
+    server.setLatency(3s);
+
+    auto start = std::chrono::steady_clock::now();
+    auto unsentTracks = scrobbler.shutdown(300ms);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 2s);
+
+    ASSERT_EQ(2u, unsentTracks.size());
+    EXPECT_EQ("Track", unsentTracks[0].getTrack());
+    EXPECT_EQ(2u, handledTracks.size());
+    EXPECT_EQ(0, server.m_SubmittedTracks);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerShutdownAbortsRequest)
+{
+    ScrobbleServerStub server;
+    server.setLatency(3s);
+
+    LastFmScrobbler scrobbler("user", "pass", false, false);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+
+    // the handshake is still in progress when the shutdown starts
+    scrobbler.startedPlaying(SubmissionInfo("Artist", "Track"));
+    std::this_thread::sleep_for(100ms);
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(scrobbler.shutdown(200ms).empty());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 2500ms);
+    EXPECT_EQ(0, server.m_NowPlayingRequests);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerShutdownAbortsAdmissionWait)
+{
+    ScrobbleServerStub server;
+
+    // the only token is taken, the next handshake has to wait 2 seconds for admission
+    HandshakeAdmission& admission = HandshakeAdmission::instance();
+    admission.configure(HandshakeAdmission::DEFAULT_MAX_CONCURRENT, 0.5, 1);
+    admission.acquire();
+    admission.release();
+
+    LastFmScrobbler scrobbler("user", "pass", false, false);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.startedPlaying(SubmissionInfo("Artist", "Track"));
+    while (admission.getQueueLength() == 0) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    scrobbler.shutdown(200ms);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    EXPECT_EQ(0, server.m_Handshakes);
+    EXPECT_EQ(0u, admission.getQueueLength());
+
+    // the bucket is refilled so the following tests are not delayed
+    admission.configure(HandshakeAdmission::DEFAULT_MAX_CONCURRENT, 1000, HandshakeAdmission::DEFAULT_BURST);
+    std::this_thread::sleep_for(20ms);
+    admission.configure(HandshakeAdmission::DEFAULT_MAX_CONCURRENT, HandshakeAdmission::DEFAULT_RATE, HandshakeAdmission::DEFAULT_BURST);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerSubmissionLog)
+{
+    string logPath = testing::TempDir() + "scrobblersubmissionlog";
+    std::remove(logPath.c_str());
+
+    ScrobbleServerStub server;
+    server.setOnline(false);
+
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 10;
+
+    {
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setCommitOnlyMode(true);
+        scrobbler.setBatchPolicy(policy);
+        scrobbler.setSubmissionLog(logPath);
+        bufferTracks(scrobbler, 2);
+        EXPECT_EQ(2u, scrobbler.shutdown(1s).size());
+    }
+
+    server.setOnline(true);
+    {
+        // the tracks of the previous run are restored from the log
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setCommitOnlyMode(true);
+        scrobbler.setBatchPolicy(policy);
+        scrobbler.setSubmissionLog(logPath);
+        scrobbler.authenticate();
+        scrobbler.flush();
+    }
+    EXPECT_EQ(2, server.m_SubmittedTracks);
+
+    {
+        SubmissionLog log(logPath);
+        SubmissionInfoCollection infos;
+        EXPECT_EQ(0u, log.replay(infos));
+    }
+
+    std::remove(logPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerSubmissionLogBounded)
+{
+    string logPath = testing::TempDir() + "scrobblersubmissionlogbounded";
+    std::remove(logPath.c_str());
+
+    ScrobbleServerStub server;
+    server.setOnline(false);
+
+    {
+        // the log keeps the same tracks as the buffer during a long outage
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setCommitOnlyMode(true);
+        scrobbler.setSubmissionLog(logPath);
+        bufferTracks(scrobbler, 60);
+        EXPECT_EQ(SubmissionInfoCollection::MAX_SIZE, scrobbler.shutdown(1s).size());
+    }
+
+    SubmissionLog log(logPath);
+    SubmissionInfoCollection infos;
+    EXPECT_EQ(SubmissionInfoCollection::MAX_SIZE, log.replay(infos));
+
+    std::remove(logPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerSubmissionSpool)
+{
+    string spoolPath = testing::TempDir() + "scrobblersubmissionspool";
+    std::remove(spoolPath.c_str());
+
+    ScrobbleServerStub server;
+    server.setOnline(false);
+
+    {
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setCommitOnlyMode(true);
+        scrobbler.setSubmissionSpool(spoolPath, 1000);
+        bufferTracks(scrobbler, 60);
+    }
+
+    server.setOnline(true);
+    {
+        // the spool is not limited to 50 tracks, it is submitted in pages
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setCommitOnlyMode(true);
+        scrobbler.setSubmissionSpool(spoolPath);
+        scrobbler.authenticate();
+        scrobbler.flush();
+    }
+    EXPECT_EQ(2, server.m_SubmissionRequests);
+    EXPECT_EQ(60, server.m_SubmittedTracks);
+    EXPECT_EQ(1, server.m_Handshakes);
+
+    SubmissionSpool spool(spoolPath);
+    EXPECT_TRUE(spool.empty());
+
+    std::remove(spoolPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerImportScrobblerLog)
+{
+    string spoolPath = testing::TempDir() + "scrobblerimportspool";
+    string logPath = testing::TempDir() + "scrobblerimport.scrobbler.log";
+    std::remove(spoolPath.c_str());
+    {
+        std::ofstream file(logPath);
+        file << "#AUDIOSCROBBLER/1.1\n#TZ/UTC\n#CLIENT/Rockbox\n";
+        for (int i = 0; i < 75; ++i) {
+            file << "Artist\tAlbum\tTrack" << i << "\t1\t200\t" << (i % 5 == 0 ? "S" : "L") << "\t" << 1000 + i << "\t\n";
+        }
+        // too large for the spool, it does not abort the import
+        file << string(SubmissionSpool::MAX_RECORD_SIZE, 'a') << "\tAlbum\tTrack\t1\t200\tL\t2000\t\n";
+    }
+
+    ScrobbleServerStub server;
+    {
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        EXPECT_THROW(scrobbler.importScrobblerLog(logPath), std::logic_error);
+
+        scrobbler.setSubmissionSpool(spoolPath);
+        scrobbler.authenticate();
+        auto statistics = scrobbler.importScrobblerLog(logPath);
+        EXPECT_EQ(60u, statistics.imported);
+        EXPECT_EQ(16u, statistics.skipped);
+    }
+    EXPECT_EQ(2, server.m_SubmissionRequests);
+    EXPECT_EQ(60, server.m_SubmittedTracks);
+
+    std::remove(spoolPath.c_str());
+    std::remove(logPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerImportDroppedTracksNotFiltered)
+{
+    string spoolPath = testing::TempDir() + "scrobblerimportdroppedspool";
+    string logPath = testing::TempDir() + "scrobblerimportdropped.scrobbler.log";
+    std::remove(spoolPath.c_str());
+    {
+        std::ofstream file(logPath);
+        file << "#AUDIOSCROBBLER/1.1\n#TZ/UTC\n#CLIENT/Rockbox\n";
+        for (int i = 0; i < 3; ++i) {
+            file << "Artist\tAlbum\tTrack" << i << "\t1\t200\tL\t" << 1000 + i << "\t\n";
+        }
+    }
+
+    ScrobbleServerStub server;
+    {
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setDuplicateFilter(std::chrono::hours(1));
+        scrobbler.setSubmissionSpool(spoolPath, 2);
+
+        // the spool is full, the last track is dropped and not remembered by the filter
+        scrobbler.importScrobblerLog(logPath);
+        EXPECT_EQ(0, server.m_SubmittedTracks);
+
+        scrobbler.authenticate();
+        scrobbler.flush();
+        EXPECT_EQ(2, server.m_SubmittedTracks);
+
+        scrobbler.importScrobblerLog(logPath);
+        EXPECT_EQ(3, server.m_SubmittedTracks);
+        EXPECT_EQ(2u, scrobbler.getStatistics().duplicatesFiltered);
+    }
+
+    std::remove(spoolPath.c_str());
+    std::remove(logPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerPipelinedDrain)
+{
+    string spoolPath = testing::TempDir() + "scrobblerpipelineddrain";
+    std::remove(spoolPath.c_str());
+
+    {
+        SubmissionSpool spool(spoolPath, 1000);
+        SubmissionInfo info("Artist", "Track", time(nullptr));
+        info.setTrackLength(100);
+        for (int i = 0; i < 520; ++i) {
+            spool.enqueue(info, time(nullptr));
+        }
+    }
+
+    ScrobbleServerStub server;
+    server.setLatency(20ms);
+
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setSubmissionSpool(spoolPath);
+    scrobbler.setSubmissionPipelineDepth(4);
+    scrobbler.authenticate();
+
+    // the pages in flight are rejected, the drain starts again after a new handshake
+    server.invalidateSessions();
+    scrobbler.flush();
+
+    EXPECT_EQ(2, server.m_Handshakes);
+    EXPECT_EQ(520, server.m_SubmittedTracks);
+    EXPECT_EQ(520u, scrobbler.getStatistics().tracksSubmitted);
+
+    scrobbler.shutdown(1s);
+    SubmissionSpool spool(spoolPath);
+    EXPECT_TRUE(spool.empty());
+
+    std::remove(spoolPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerPipelinedDrainFailedPage)
+{
+    string spoolPath = testing::TempDir() + "scrobblerpipelineddrain";
+    std::remove(spoolPath.c_str());
+
+    {
+        SubmissionSpool spool(spoolPath, 1000);
+        for (int i = 0; i < 100; ++i) {
+            SubmissionInfo info(i < 50 ? "Bad" : "Artist", "Track" + to_string(i), time(nullptr));
+            info.setTrackLength(100);
+            spool.enqueue(info, time(nullptr));
+        }
+    }
+
+    ScrobbleServerStub server;
+    server.setRejectedArtist("Bad");
+
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setSubmissionSpool(spoolPath);
+    scrobbler.setSubmissionPipelineDepth(2);
+    scrobbler.authenticate();
+
+    // the first page fails, the second page was accepted while the first one was in flight
+    scrobbler.flush();
+    EXPECT_EQ(50, server.m_SubmittedTracks);
+    EXPECT_TRUE(scrobbler.getDeadLetters().empty());
+
+    // only the failed page is submitted again
+    server.setRejectedArtist("");
+    scrobbler.flush();
+    EXPECT_EQ(100, server.m_SubmittedTracks);
+    EXPECT_EQ(100u, scrobbler.getStatistics().tracksSubmitted);
+
+    scrobbler.shutdown(1s);
+    SubmissionSpool spool(spoolPath);
+    EXPECT_TRUE(spool.empty());
+
+    std::remove(spoolPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerShutdownStopsDrain)
+{
+    string spoolPath = testing::TempDir() + "scrobblershutdowndrain";
+    std::remove(spoolPath.c_str());
+
+    {
+        SubmissionSpool spool(spoolPath, 4000);
+        SubmissionInfo info("Artist", "Track", time(nullptr));
+        info.setTrackLength(100);
+        for (int i = 0; i < 2000; ++i) {
+            spool.enqueue(info, time(nullptr));
+        }
+    }
+
+    ScrobbleServerStub server;
+
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setSubmissionSpool(spoolPath);
+    scrobbler.authenticate();
+    server.setLatency(50ms);
+
+    auto start = std::chrono::steady_clock::now();
+    scrobbler.shutdown(200ms);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 600ms);
+
+    // the pages that were not submitted before the deadline stay in the spool
+    SubmissionSpool spool(spoolPath);
+    EXPECT_GE(spool.size(), 2000u - static_cast<size_t>(server.m_SubmittedTracks));
+    EXPECT_GT(spool.size(), 1000u);
+
+    std::remove(spoolPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerDuplicateFilter)
+{
+    LastFmScrobblerTester scrobbler(true);
+    scrobbler.setCommitOnlyMode(true);
+    scrobbler.setDuplicateFilter(std::chrono::hours(1));
+
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 10;
+    scrobbler.setBatchPolicy(policy);
+
+    // the player reports the same track twice
+    SubmissionInfo info("Artist", "Track", time(nullptr) - 300);
+    info.setTrackLength(100);
+    scrobbler.startedPlaying(info);
+    scrobbler.startedPlaying(info);
+    scrobbler.startedPlaying(info);
+    scrobbler.flush();
+
+    EXPECT_TRUE(scrobbler.pMock->m_SubmitCollectionCalled);
+    EXPECT_EQ(1u, scrobbler.pMock->m_LastRecSubmitInfoCollection.size());
+    EXPECT_EQ(1u, scrobbler.getStatistics().duplicatesFiltered);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerRejectedTracks)
+{
+    string logPath = testing::TempDir() + "scrobblerrejectedtracks";
+    std::remove(logPath.c_str());
+    {
+        // a user chosen track without length can't be submitted, it can only be buffered by an older version
+        SubmissionLog log(logPath);
+        for (int i = 0; i <= 16; ++i) {
+            SubmissionInfo info("Artist", i == 5 ? "No length" : "Track", time(nullptr) - 300 + i);
+            if (i != 5) {
+                info.setTrackLength(100);
+            }
+            log.append(info, time(nullptr));
+        }
+    }
+
+    LastFmScrobblerTester scrobbler(true);
+    scrobbler.setCommitOnlyMode(true);
+    scrobbler.setSubmissionLog(logPath);
+    scrobbler.authenticate();
+    scrobbler.flush();
+
+    // the user chosen track without a length is left out of the submission
+    EXPECT_EQ(16, scrobbler.pMock->m_SubmittedTracks);
+    EXPECT_EQ(1, scrobbler.pMock->m_SubmitCollectionCount);
+
+    auto deadLetters = scrobbler.getDeadLetters();
+    ASSERT_EQ(1u, deadLetters.size());
+    EXPECT_EQ("No length", deadLetters[0].getTrack());
+    EXPECT_EQ(1u, scrobbler.getStatistics().tracksRejected);
+
+    // the buffer is no longer blocked
+    scrobbler.pMock->m_SubmitCollectionCount = 0;
+    scrobbler.flush();
+    EXPECT_EQ(0, scrobbler.pMock->m_SubmitCollectionCount);
+
+    scrobbler.clearDeadLetters();
+    EXPECT_TRUE(scrobbler.getDeadLetters().empty());
+
+    std::remove(logPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerServerRejectedTrack)
+{
+    LastFmScrobblerTester scrobbler(true);
+    scrobbler.setCommitOnlyMode(true);
+    scrobbler.pMock->m_RejectedArtist = "Bad";
+
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 20;
+    scrobbler.setBatchPolicy(policy);
+
+    for (int i = 0; i <= 8; ++i) {
+        SubmissionInfo info(i == 5 ? "Bad" : "Artist", "Track" + to_string(i), time(nullptr) - 300);
+        info.setTrackLength(100);
+        scrobbler.startedPlaying(info);
+    }
+    scrobbler.flush();
+
+    // the batch is split until the failing track is isolated, the last track is still playing
+    EXPECT_EQ(7, scrobbler.pMock->m_SubmittedTracks);
+    EXPECT_GE(7, scrobbler.pMock->m_SubmitCollectionCount);
+    auto deadLetters = scrobbler.getDeadLetters();
+    ASSERT_EQ(1u, deadLetters.size());
+    EXPECT_EQ("Track5", deadLetters[0].getTrack());
+    EXPECT_EQ(1u, scrobbler.getStatistics().tracksRejected);
+
+    // the buffer is no longer blocked
+    scrobbler.pMock->m_SubmitCollectionCount = 0;
+    scrobbler.flush();
+    EXPECT_EQ(0, scrobbler.pMock->m_SubmitCollectionCount);
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerFailedSubmissionStaysBuffered)
+{
+    LastFmScrobblerTester scrobbler(true);
+    scrobbler.setCommitOnlyMode(true);
+    scrobbler.pMock->m_RejectedArtist = "Artist";
+
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 20;
+    scrobbler.setBatchPolicy(policy);
+
+    for (int i = 0; i <= 8; ++i) {
+        SubmissionInfo info("Artist", "Track" + to_string(i), time(nullptr) - 300);
+        info.setTrackLength(100);
+        scrobbler.startedPlaying(info);
+    }
+    scrobbler.flush();
+
+    // the server fails every part of the batch, no track is blamed for it
+    EXPECT_EQ(0, scrobbler.pMock->m_SubmittedTracks);
+    EXPECT_GE(8, scrobbler.pMock->m_SubmitCollectionCount);
+    EXPECT_TRUE(scrobbler.getDeadLetters().empty());
+
+    scrobbler.pMock->m_RejectedArtist.clear();
+    scrobbler.flush();
+    EXPECT_EQ(8, scrobbler.pMock->m_SubmittedTracks);
+    EXPECT_EQ(8u, scrobbler.pMock->m_LastRecSubmitInfoCollection.size());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerRejectedSpooledTrack)
+{
+    string spoolPath = testing::TempDir() + "scrobblerrejectedtrack";
+    string deadLetterPath = testing::TempDir() + "scrobblerdeadletters";
+    std::remove(spoolPath.c_str());
+    std::remove(deadLetterPath.c_str());
+
+    {
+        SubmissionSpool spool(spoolPath, 1000);
+        SubmissionInfo info("Artist", "Track", time(nullptr));
+        info.setTrackLength(100);
+        for (int i = 0; i < 120; ++i) {
+            // a user chosen track without length can't be submitted
+            spool.enqueue(i == 70 ? SubmissionInfo("Artist", "No length", time(nullptr)) : info, time(nullptr));
+        }
+    }
+
+    ScrobbleServerStub server;
+
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setSubmissionSpool(spoolPath);
+    scrobbler.setDeadLetterSpool(deadLetterPath);
+    scrobbler.setSubmissionPipelineDepth(2);
+
+    // the lost track triggers a dump of the flight recorder
+    vector<FlightRecord> dumpedRecords;
+    scrobbler.setFlightRecorderDumpHandler([&](FlightDumpReason reason, const vector<FlightRecord>& records) {
+        EXPECT_EQ(FlightDumpReason::HardFailure, reason);
+        dumpedRecords = records;
+    });
+
+    scrobbler.authenticate();
+    scrobbler.flush();
+
+    EXPECT_EQ(119, server.m_SubmittedTracks);
+    ASSERT_EQ(1u, scrobbler.getDeadLetters().size());
+    EXPECT_EQ("No length", scrobbler.getDeadLetters()[0].getTrack());
+
+    ASSERT_FALSE(dumpedRecords.empty());
+    EXPECT_EQ(FlightEvent::Handshake, dumpedRecords.front().event);
+    EXPECT_EQ(FlightEvent::TrackRejected, dumpedRecords.back().event);
+    EXPECT_LE(1, count_if(dumpedRecords.begin(), dumpedRecords.end(), [](const FlightRecord& record) {
+        return record.event == FlightEvent::Submission && record.status == FlightStatus::Ok;
+    }));
+
+    scrobbler.shutdown(1s);
+    SubmissionSpool spool(spoolPath);
+    EXPECT_TRUE(spool.empty());
+
+    // the dead letters survive a restart
+    LastFmScrobbler restartedScrobbler("user", "pass", false, true);
+    restartedScrobbler.setDeadLetterSpool(deadLetterPath);
+    ASSERT_EQ(1u, restartedScrobbler.getDeadLetters().size());
+    EXPECT_EQ("No length", restartedScrobbler.getDeadLetters()[0].getTrack());
+    restartedScrobbler.clearDeadLetters();
+    EXPECT_TRUE(restartedScrobbler.getDeadLetters().empty());
+
+    std::remove(spoolPath.c_str());
+    std::remove(deadLetterPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerServerRejectedSpooledTrack)
+{
+    string spoolPath = testing::TempDir() + "scrobblerrejectedtrack";
+    std::remove(spoolPath.c_str());
+
+    {
+        SubmissionSpool spool(spoolPath, 1000);
+        for (int i = 0; i < 120; ++i) {
+            SubmissionInfo info(i == 30 ? "Bad" : "Artist", "Track" + to_string(i), time(nullptr));
+            info.setTrackLength(100);
+            spool.enqueue(info, time(nullptr));
+        }
+    }
+
+    ScrobbleServerStub server;
+    server.setRejectedArtist("Bad");
+
+    LastFmScrobbler scrobbler("user", "pass", false, true);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setSubmissionSpool(spoolPath);
+    scrobbler.setSubmissionPipelineDepth(2);
+    scrobbler.authenticate();
+    scrobbler.flush();
+
+    EXPECT_EQ(119, server.m_SubmittedTracks);
+    ASSERT_EQ(1u, scrobbler.getDeadLetters().size());
+    EXPECT_EQ("Track30", scrobbler.getDeadLetters()[0].getTrack());
+
+    scrobbler.shutdown(1s);
+    SubmissionSpool spool(spoolPath);
+    EXPECT_TRUE(spool.empty());
+
+    std::remove(spoolPath.c_str());
+}
+
+TEST(LastFmScrobblerTest, LastFmScrobblerNowPlayingLane)
+{
+    string spoolPath = testing::TempDir() + "scrobblernowplayinglane";
+    std::remove(spoolPath.c_str());
+
+    {
+        SubmissionSpool spool(spoolPath, 1000);
+        SubmissionInfo info("Artist", "Track", time(nullptr));
+        info.setTrackLength(100);
+        for (int i = 0; i < 500; ++i) {
+            spool.enqueue(info, time(nullptr));
+        }
+    }
+
+    ScrobbleServerStub server;
+    server.setLatency(100ms);
+
+    LastFmScrobbler scrobbler("user", "pass", false, false);
+    scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+    scrobbler.setSubmissionSpool(spoolPath);
+    scrobbler.authenticate();
+    for (int i = 0; i < 100 && server.m_Handshakes == 0; ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    std::this_thread::sleep_for(200ms);
+
+    // the backlog drains page by page, the now playing update does not wait for it
+    scrobbler.flush();
+    scrobbler.startedPlaying(SubmissionInfo("Artist", "Now playing"));
+    std::this_thread::sleep_for(400ms);
+
+    EXPECT_EQ(1u, scrobbler.getStatistics().nowPlayingSent);
+    EXPECT_LT(server.m_SubmittedTracks, 500);
+
+    scrobbler.shutdown(0ms);
+    std::remove(spoolPath.c_str());
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/utils/boundedmpscqueue.h"
+#include "lastfmlib/utils/log.h"
+#include "lastfmlib/utils/logbackend.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST(BoundedMpscQueueTest, PopsInOrder)
+{
+    BoundedMpscQueue<string> queue(4);
+    for (string value : { "a", "b", "c" }) {
+        EXPECT_TRUE(queue.push(value));
+    }
+
+    string value;
+    EXPECT_TRUE(queue.pop(value));
+    EXPECT_EQ("a", value);
+    EXPECT_TRUE(queue.pop(value));
+    EXPECT_EQ("b", value);
+    EXPECT_TRUE(queue.pop(value));
+    EXPECT_EQ("c", value);
+    EXPECT_FALSE(queue.pop(value));
+    EXPECT_FALSE(queue.hasPending());
+}
+
+TEST(BoundedMpscQueueTest, PushFailsWhenFull)
+{
+    BoundedMpscQueue<int> queue(2);
+    int value = 1;
+    EXPECT_TRUE(queue.push(value));
+    EXPECT_TRUE(queue.push(value));
+    value = 3;
+    EXPECT_FALSE(queue.push(value));
+    EXPECT_EQ(3, value);
+    EXPECT_EQ(2u, queue.getPushedCount());
+
+    EXPECT_TRUE(queue.pop(value));
+    value = 4;
+    EXPECT_TRUE(queue.push(value));
+}
+
+TEST(BoundedMpscQueueTest, CapacityMustBePowerOfTwo)
+{
+    EXPECT_THROW(BoundedMpscQueue<int>(6), logic_error);
+    EXPECT_THROW(BoundedMpscQueue<int>(1), logic_error);
+    EXPECT_EQ(8u, BoundedMpscQueue<int>(8).getCapacity());
+}
+
+TEST(BoundedMpscQueueTest, ManyProducers)
+{
+    const int producers = 4;
+    const int valuesPerProducer = 20000;
+    BoundedMpscQueue<int> queue(64);
+
+    vector<thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < valuesPerProducer; ++i) {
+                int value = p * valuesPerProducer + i;
+                while (!queue.push(value)) {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+
+    vector<int> lastSeen(producers, -1);
+    int received = 0;
+    while (received < producers * valuesPerProducer) {
+        int value;
+        if (!queue.pop(value)) {
+            this_thread::yield();
+            continue;
+        }
+
+        // values of a single producer keep their order
+        int producer = value / valuesPerProducer;
+        EXPECT_LT(lastSeen[producer], value);
+        lastSeen[producer] = value;
+        ++received;
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_FALSE(queue.hasPending());
+}
+
+TEST(LogBackendTest, FlushWritesQueuedMessages)
+{
+    auto dropped = Log::getDroppedCount();
+    for (int i = 0; i < 100; ++i) {
+        Log::debug("LogBackendTest message", i);
+    }
+
+    Log::flush();
+    EXPECT_EQ(dropped, Log::getDroppedCount());
+}
+
+TEST(LogBackendTest, SynchronousMode)
+{
+    Log::setAsynchronous(false);
+    Log::debug("LogBackendTest synchronous message");
+    Log::flush();
+
+    Log::setAsynchronous(true);
+    Log::debug("LogBackendTest asynchronous message");
+    Log::flush();
+}
+
+TEST(LogBackendTest, RuntimeLevel)
+{
+    EXPECT_EQ(Log::Level::Debug, Log::getLevel());
+    EXPECT_TRUE(Log::isEnabled(Log::Level::Debug));
+
+    Log::setLevel(Log::Level::Error);
+    EXPECT_FALSE(Log::isEnabled(Log::Level::Info));
+    EXPECT_FALSE(Log::isEnabled(Log::Level::Warning));
+    EXPECT_TRUE(Log::isEnabled(Log::Level::Error));
+    EXPECT_TRUE(Log::isEnabled(Log::Level::Critical));
+
+    Log::setLevel(Log::Level::Debug);
+}
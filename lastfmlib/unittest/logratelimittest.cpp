@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/utils/log.h"
+
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+class LogRateLimitTest : public testing::Test {
+protected:
+    void TearDown() override
+    {
+        Log::setRateLimit(Log::Level::Debug, {});
+    }
+};
+
+TEST_F(LogRateLimitTest, SuppressesFloodOfCallSite)
+{
+    Log::setRateLimit(Log::Level::Debug, { 2, hours(1), 0 });
+
+    auto suppressed = Log::getSuppressedCount();
+    for (int i = 0; i < 10; ++i) {
+        Log::debug("LogRateLimitTest flood", i);
+    }
+    EXPECT_EQ(suppressed + 8, Log::getSuppressedCount());
+
+    // other call sites and levels have their own limit
+    Log::debug("LogRateLimitTest other call site");
+    Log::info("LogRateLimitTest flood");
+    EXPECT_EQ(suppressed + 8, Log::getSuppressedCount());
+}
+
+TEST_F(LogRateLimitTest, Sampling)
+{
+    Log::setRateLimit(Log::Level::Debug, { 2, hours(1), 4 });
+
+    auto suppressed = Log::getSuppressedCount();
+    for (int i = 0; i < 10; ++i) {
+        Log::debug("LogRateLimitTest sampled", i);
+    }
+    // 2 in the burst and 2 of the 8 above the limit are written
+    EXPECT_EQ(suppressed + 6, Log::getSuppressedCount());
+}
+
+TEST_F(LogRateLimitTest, MessagesWithoutLiteral)
+{
+    Log::setRateLimit(Log::Level::Debug, { 1, hours(1), 0 });
+
+    auto suppressed = Log::getSuppressedCount();
+    const string message = "LogRateLimitTest dynamic message";
+    for (int i = 0; i < 5; ++i) {
+        Log::debug(message);
+    }
+    Log::debug(message + " with another text");
+    EXPECT_EQ(suppressed + 4, Log::getSuppressedCount());
+}
+
+TEST_F(LogRateLimitTest, CallSiteIsTheStatement)
+{
+    Log::setRateLimit(Log::Level::Debug, { 1, hours(1), 0 });
+
+    // the messages of a statement share its limit, whatever their text
+    auto suppressed = Log::getSuppressedCount();
+    for (int i = 0; i < 3; ++i) {
+        Log::debug(i == 0 ? "LogRateLimitTest first text" : "LogRateLimitTest other text", i);
+    }
+    EXPECT_EQ(suppressed + 2, Log::getSuppressedCount());
+
+    // statements with the same text have their own limit
+    Log::debug("LogRateLimitTest same text");
+    Log::debug("LogRateLimitTest same text");
+    EXPECT_EQ(suppressed + 2, Log::getSuppressedCount());
+}
+
+TEST_F(LogRateLimitTest, NewInterval)
+{
+    Log::setRateLimit(Log::Level::Debug, { 1, milliseconds(20), 0 });
+
+    auto suppressed = Log::getSuppressedCount();
+    for (int i = 0; i < 3; ++i) {
+        Log::debug("LogRateLimitTest interval", i);
+    }
+    EXPECT_EQ(suppressed + 2, Log::getSuppressedCount());
+
+    this_thread::sleep_for(milliseconds(30));
+    Log::debug("LogRateLimitTest interval", 3);
+    EXPECT_EQ(suppressed + 2, Log::getSuppressedCount());
+    Log::flush();
+}
@@ -0,0 +1,213 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/lastfmclient.h"
+#include "lastfmlib/lastfmscrobbler.h"
+#include "lastfmlib/metricsregistry.h"
+#include "lastfmlib/nowplayinginfo.h"
+#include "scrobbleserverstub.h"
+
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+static int64_t metricValue(const string& name, const MetricLabels& labels)
+{
+    for (auto& metric : MetricsRegistry::instance().snapshot()) {
+        if (metric.name == name && metric.labels == labels) {
+            return metric.value;
+        }
+    }
+    return 0;
+}
+
+TEST(MetricsRegistryTest, HistogramBuckets)
+{
+    for (uint64_t value : { 0ull, 1ull, 7ull, 8ull, 15ull, 16ull, 100ull, 1000ull, 123456ull, 1ull << 39 }) {
+        size_t index = LatencyHistogram::bucketIndex(value);
+        EXPECT_GE(LatencyHistogram::bucketUpperBound(index), value);
+        EXPECT_LE(LatencyHistogram::bucketUpperBound(index), value + value / 8);
+        if (index > 0) {
+            EXPECT_LT(LatencyHistogram::bucketUpperBound(index - 1), value);
+        }
+    }
+
+    EXPECT_EQ(LatencyHistogram::BUCKET_COUNT - 1, LatencyHistogram::bucketIndex(~0ull));
+}
+
+TEST(MetricsRegistryTest, HistogramPercentiles)
+{
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.record(microseconds(i * 10));
+    }
+
+    HistogramSnapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(1000u, snapshot.count);
+    EXPECT_EQ(5005000u, snapshot.sum);
+    EXPECT_NEAR(5000.0, static_cast<double>(snapshot.percentile(0.5)), 5000 * 0.125);
+    EXPECT_NEAR(9900.0, static_cast<double>(snapshot.percentile(0.99)), 9900 * 0.125);
+    EXPECT_EQ(0u, snapshot.countAtMost(9));
+    EXPECT_EQ(1u, snapshot.countAtMost(10));
+    EXPECT_EQ(1000u, snapshot.countAtMost(1 << 14));
+}
+
+TEST(MetricsRegistryTest, HistogramInclusiveBounds)
+{
+    // a value on a power of two is counted in the le bucket of that power
+    for (unsigned int exponent = 3; exponent < 40; ++exponent) {
+        uint64_t bound = uint64_t(1) << exponent;
+        EXPECT_EQ(bound, LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(bound)));
+        EXPECT_LT(bound, LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(bound + 1)));
+    }
+
+    LatencyHistogram histogram;
+    histogram.record(microseconds(64));
+    histogram.record(microseconds(65));
+    HistogramSnapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(0u, snapshot.countAtMost(63));
+    EXPECT_EQ(1u, snapshot.countAtMost(64));
+    EXPECT_EQ(2u, snapshot.countAtMost(128));
+
+    MetricsRegistry registry;
+    registry.histogram("duration_seconds", "Durations").record(microseconds(64));
+    string text = registry.toPrometheusText();
+    EXPECT_NE(string::npos, text.find("duration_seconds_bucket{le=\"3.2e-05\"} 0\n"));
+    EXPECT_NE(string::npos, text.find("duration_seconds_bucket{le=\"6.4e-05\"} 1\n"));
+}
+
+TEST(MetricsRegistryTest, ConcurrentUpdates)
+{
+    MetricsRegistry registry;
+    MetricsCounter& counter = registry.counter("requests_total", "Requests");
+    EXPECT_EQ(&counter, &registry.counter("requests_total", "Requests"));
+    EXPECT_NE(&counter, &registry.counter("requests_total", "Requests", { { "endpoint", "handshake" } }));
+    EXPECT_THROW(registry.gauge("requests_total", "Requests"), std::logic_error);
+
+    vector<thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            LatencyHistogram& histogram = registry.histogram("duration_seconds", "Durations");
+            for (int j = 0; j < 10000; ++j) {
+                counter.increment();
+                histogram.record(microseconds(j));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto snapshot = registry.snapshot();
+    ASSERT_EQ(3u, snapshot.size());
+    EXPECT_EQ(40000, snapshot[0].value);
+    EXPECT_EQ(MetricSnapshot::Type::Histogram, snapshot[2].type);
+    EXPECT_EQ(40000u, snapshot[2].histogram.count);
+}
+
+TEST(MetricsRegistryTest, PrometheusText)
+{
+    MetricsRegistry registry;
+    registry.counter("lastfm_requests_total", "Requests by outcome", { { "outcome", "OK" } }).increment(3);
+    registry.gauge("lastfm_buffered_tracks", "Buffered tracks").set(-2);
+    registry.counter("lastfm_requests_total", "Requests by outcome", { { "outcome", "FAILED\"" } }).increment();
+    registry.histogram("lastfm_request_duration_seconds", "Durations").record(microseconds(100));
+
+    string text = registry.toPrometheusText();
+    EXPECT_EQ(0u, text.find("# HELP lastfm_requests_total Requests by outcome\n"
+                            "# TYPE lastfm_requests_total counter\n"
+                            "lastfm_requests_total{outcome=\"OK\"} 3\n"
+                            "lastfm_requests_total{outcome=\"FAILED\\\"\"} 1\n"
+                            "# HELP lastfm_buffered_tracks Buffered tracks\n"
+                            "# TYPE lastfm_buffered_tracks gauge\n"
+                            "lastfm_buffered_tracks -2\n"
+                            "# HELP lastfm_request_duration_seconds Durations\n"
+                            "# TYPE lastfm_request_duration_seconds histogram\n"));
+    EXPECT_NE(string::npos, text.find("lastfm_request_duration_seconds_bucket{le=\"6.4e-05\"} 0\n"));
+    EXPECT_NE(string::npos, text.find("lastfm_request_duration_seconds_bucket{le=\"0.000128\"} 1\n"));
+    EXPECT_NE(string::npos, text.find("lastfm_request_duration_seconds_bucket{le=\"+Inf\"} 1\n"));
+    EXPECT_NE(string::npos, text.find("lastfm_request_duration_seconds_sum 0.0001\n"));
+    EXPECT_NE(string::npos, text.find("lastfm_request_duration_seconds_count 1\n"));
+}
+
+TEST(MetricsRegistryTest, ClientRequestOutcomes)
+{
+    const MetricLabels handshakeOk = { { "endpoint", "handshake" }, { "outcome", "OK" } };
+    const MetricLabels nowPlayingOk = { { "endpoint", "nowplaying" }, { "outcome", "OK" } };
+    const MetricLabels nowPlayingBadSession = { { "endpoint", "nowplaying" }, { "outcome", "BADSESSION" } };
+    const MetricLabels nowPlayingConnectionError = { { "endpoint", "nowplaying" }, { "outcome", "ConnectionError" } };
+
+    ScrobbleServerStub server;
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+
+    int64_t handshakes = metricValue("lastfm_requests_total", handshakeOk);
+    int64_t nowPlaying = metricValue("lastfm_requests_total", nowPlayingOk);
+    int64_t badSessions = metricValue("lastfm_requests_total", nowPlayingBadSession);
+    int64_t connectionErrors = metricValue("lastfm_requests_total", nowPlayingConnectionError);
+    int64_t durations = metricValue("lastfm_request_duration_seconds", { { "endpoint", "nowplaying" } });
+
+    client.handshake("user", "pass");
+    NowPlayingInfo info("Artist", "Track");
+    client.nowPlaying(info);
+    server.invalidateSessions();
+    EXPECT_THROW(client.nowPlaying(info), BadSessionError);
+    server.setOnline(false);
+    EXPECT_THROW(client.nowPlaying(info), ConnectionError);
+
+    EXPECT_EQ(handshakes + 1, metricValue("lastfm_requests_total", handshakeOk));
+    EXPECT_EQ(nowPlaying + 1, metricValue("lastfm_requests_total", nowPlayingOk));
+    EXPECT_EQ(badSessions + 1, metricValue("lastfm_requests_total", nowPlayingBadSession));
+    EXPECT_EQ(connectionErrors + 1, metricValue("lastfm_requests_total", nowPlayingConnectionError));
+    EXPECT_EQ(durations + 3, metricValue("lastfm_request_duration_seconds", { { "endpoint", "nowplaying" } }));
+}
+
+TEST(MetricsRegistryTest, TransferMetrics)
+{
+    const MetricLabels handshake = { { "endpoint", "handshake" } };
+    const MetricLabels serverPhase = { { "endpoint", "handshake" }, { "phase", "server" } };
+
+    ScrobbleServerStub server;
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+
+    // the timing is not read from curl unless it is used
+    int64_t bytesSent = metricValue("lastfm_sent_bytes_total", handshake);
+    int64_t serverPhases = metricValue("lastfm_request_phase_seconds", serverPhase);
+    client.handshake("user", "pass");
+    EXPECT_EQ(bytesSent, metricValue("lastfm_sent_bytes_total", handshake));
+    EXPECT_EQ(serverPhases, metricValue("lastfm_request_phase_seconds", serverPhase));
+
+    client.setTransferMetricsEnabled(true);
+    client.handshake("user", "pass");
+    EXPECT_LT(bytesSent, metricValue("lastfm_sent_bytes_total", handshake));
+    EXPECT_EQ(serverPhases + 1, metricValue("lastfm_request_phase_seconds", serverPhase));
+}
+
+TEST(MetricsRegistryTest, ScrobblerGauges)
+{
+    ScrobbleServerStub server;
+    server.setOnline(false);
+
+    int64_t bufferedTracks = metricValue("lastfm_buffered_tracks", {});
+    int64_t failures = metricValue("lastfm_reconnect_failures", {});
+    {
+        LastFmScrobbler scrobbler("user", "pass", false, true);
+        scrobbler.setHandshakeUrl(server.getHandshakeUrl());
+        scrobbler.setCommitOnlyMode(true);
+        scrobbler.authenticate();
+
+        SubmissionInfo info("Artist", "Track", time(nullptr) - 300);
+        info.setTrackLength(100);
+        for (int i = 0; i < 4; ++i) {
+            scrobbler.startedPlaying(info);
+        }
+
+        EXPECT_EQ(bufferedTracks + 3, metricValue("lastfm_buffered_tracks", {}));
+        EXPECT_EQ(failures + 1, metricValue("lastfm_reconnect_failures", {}));
+        EXPECT_EQ(3u, scrobbler.shutdown(1s).size());
+    }
+
+    EXPECT_EQ(bufferedTracks, metricValue("lastfm_buffered_tracks", {}));
+    EXPECT_EQ(failures, metricValue("lastfm_reconnect_failures", {}));
+}
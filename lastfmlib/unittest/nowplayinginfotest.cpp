@@ -31,3 +31,13 @@ TEST(NowPlaingInfoTest, GetPostDataWidechar)
     info.setMusicBrainzId(L"31e7b30b-f960-408f-908b-c8e277308eab");
     EXPECT_EQ(string("&a=The+Artist&t=Trackname&b=An+Album&l=42&n=4&m=31e7b30b-f960-408f-908b-c8e277308eab"), info.getPostData());
 }
+
+TEST(NowPlaingInfoTest, Compare)
+{
+    NowPlayingInfo info1("The Artist", "Trackname");
+    NowPlayingInfo info2("The Artist", "Trackname");
+    EXPECT_TRUE(info1 == info2);
+
+    info2.setAlbum("An Album");
+    EXPECT_TRUE(info1 != info2);
+}
@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/reconnectscheduler.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace std::chrono;
+
+TEST(ReconnectSchedulerTest, ExecutesCallbacks)
+{
+    ReconnectScheduler scheduler(milliseconds(5));
+    std::atomic<int> count {};
+
+    auto start = steady_clock::now();
+    scheduler.schedule(milliseconds(20), [&count] { ++count; });
+    scheduler.schedule(milliseconds(20), [&count] { ++count; });
+    auto cancelled = scheduler.schedule(milliseconds(20), [&count] { count += 100; });
+    scheduler.cancel(cancelled);
+
+    while (count < 2 && steady_clock::now() - start < seconds(5)) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+
+    EXPECT_EQ(2, count);
+    EXPECT_GE(steady_clock::now() - start, milliseconds(20));
+}
+
+TEST(ReconnectSchedulerTest, BackoffDelay)
+{
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_LE(ReconnectScheduler::backoffDelay(0, seconds(60), hours(2)), seconds(60));
+        EXPECT_LE(ReconnectScheduler::backoffDelay(3, seconds(60), hours(2)), seconds(480));
+        EXPECT_LE(ReconnectScheduler::backoffDelay(1000, seconds(60), hours(2)), hours(2));
+    }
+
+    milliseconds total {};
+    for (int i = 0; i < 1000; ++i) {
+        total += ReconnectScheduler::backoffDelay(10, seconds(60), hours(2));
+    }
+    EXPECT_GT(total / 1000, minutes(30));
+}
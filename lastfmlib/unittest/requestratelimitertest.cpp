@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/lastfmclient.h"
+#include "lastfmlib/nowplayinginfo.h"
+#include "lastfmlib/requestratelimiter.h"
+#include "scrobbleserverstub.h"
+
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+TEST(RequestRateLimiterTest, Unlimited)
+{
+    RequestRateLimiter limiter;
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(steady_clock::duration::zero(), limiter.reserve());
+    }
+
+    auto statistics = limiter.getStatistics();
+    EXPECT_EQ(100u, statistics.requests);
+    EXPECT_EQ(0u, statistics.delayedRequests);
+}
+
+TEST(RequestRateLimiterTest, RequestsAreQueued)
+{
+    RequestRateLimiter limiter(10, 2);
+    EXPECT_EQ(steady_clock::duration::zero(), limiter.reserve());
+    EXPECT_EQ(steady_clock::duration::zero(), limiter.reserve());
+
+    // the following requests wait in line, each one 100 ms longer than the previous
+    auto first = limiter.reserve();
+    auto second = limiter.reserve();
+    EXPECT_GT(first, milliseconds(80));
+    EXPECT_GT(second - first, milliseconds(80));
+
+    auto statistics = limiter.getStatistics();
+    EXPECT_EQ(4u, statistics.requests);
+    EXPECT_EQ(2u, statistics.delayedRequests);
+    EXPECT_EQ(duration_cast<microseconds>(second), statistics.maxWait);
+    EXPECT_EQ(duration_cast<microseconds>(first) + duration_cast<microseconds>(second), statistics.totalWait);
+}
+
+TEST(RequestRateLimiterTest, ClientRateLimit)
+{
+    ScrobbleServerStub server;
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+    client.handshake("user", "pass");
+    client.setRateLimit(50, 1);
+
+    NowPlayingInfo info("Artist", "Track");
+    auto start = steady_clock::now();
+    for (int i = 0; i < 6; ++i) {
+        client.nowPlaying(info);
+    }
+
+    EXPECT_GE(steady_clock::now() - start, milliseconds(90));
+    EXPECT_EQ(6, server.m_NowPlayingRequests);
+    EXPECT_EQ(5u, client.getRateLimiterStatistics().delayedRequests);
+}
+
+TEST(RequestRateLimiterTest, AbortWhileWaiting)
+{
+    ScrobbleServerStub server;
+    LastFmClient client;
+    client.setHandshakeUrl(server.getHandshakeUrl());
+    client.handshake("user", "pass");
+    client.setRateLimit(0.1, 1);
+
+    NowPlayingInfo info("Artist", "Track");
+    client.nowPlaying(info);
+
+    thread aborter([&client] {
+        this_thread::sleep_for(milliseconds(50));
+        client.abort();
+    });
+
+    auto start = steady_clock::now();
+    EXPECT_THROW(client.nowPlaying(info), ConnectionError);
+    EXPECT_LT(steady_clock::now() - start, seconds(2));
+    aborter.join();
+
+    EXPECT_EQ(1, server.m_NowPlayingRequests);
+}
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/scrobblerlogimporter.h"
+#include "lastfmlib/submissionrecord.h"
+
+#include <cstdio>
+#include <fstream>
+
+using std::string;
+
+static void writeLog(const string& path, const string& timezone, int count)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << "#AUDIOSCROBBLER/1.1\n";
+    file << "#TZ/" << timezone << "\n";
+    file << "#CLIENT/Rockbox sansae200 $Revision$\n";
+    for (int i = 0; i < count; ++i) {
+        file << "Artist\tAlbum\tTrack" << i << "\t" << (i % 12) + 1 << "\t200\tL\t" << 1000 + i << "\t\n";
+    }
+}
+
+TEST(ScrobblerLogImporterTest, ParseLine)
+{
+    SubmissionInfo info;
+    bool skipped = true;
+    EXPECT_TRUE(ScrobblerLogImporter::parseLine("The Artist\tThe Album\tThe Title\t3\t215\tL\t1234567890\tabc-123", 0, info, skipped));
+    EXPECT_FALSE(skipped);
+    EXPECT_EQ("The Artist", info.getArtist());
+    EXPECT_EQ("The Album", info.getAlbum());
+    EXPECT_EQ("The Title", info.getTrack());
+    EXPECT_EQ(3, info.getTrackNr());
+    EXPECT_EQ(215, info.getTrackLength());
+    EXPECT_EQ(1234567890, info.getTimeStarted());
+    EXPECT_EQ("abc-123", info.getMusicBrainzId());
+
+    // the track number and MusicBrainz id are optional, the timestamp is corrected with the utc offset
+    EXPECT_TRUE(ScrobblerLogImporter::parseLine("Artist\t\tTitle\t\t100\tS\t5000", 3600, info, skipped));
+    EXPECT_TRUE(skipped);
+    EXPECT_EQ(-1, info.getTrackNr());
+    EXPECT_EQ("", info.getAlbum());
+    EXPECT_EQ(1400, info.getTimeStarted());
+}
+
+TEST(ScrobblerLogImporterTest, ParseInvalidLine)
+{
+    SubmissionInfo info;
+    bool skipped = false;
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("", 0, info, skipped));
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("Artist\tAlbum\tTitle\t1\t100\tL", 0, info, skipped));
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("\tAlbum\tTitle\t1\t100\tL\t5000", 0, info, skipped));
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("Artist\tAlbum\tTitle\tx\t100\tL\t5000", 0, info, skipped));
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("Artist\tAlbum\tTitle\t1\t100s\tL\t5000", 0, info, skipped));
+    // a listened track needs a length to be submitted
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("Artist\tAlbum\tTitle\t1\t-5\tL\t5000", 0, info, skipped));
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("Artist\tAlbum\tTitle\t1\t\tL\t5000", 0, info, skipped));
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("Artist\tAlbum\tTitle\t1\t100\tX\t5000", 0, info, skipped));
+    EXPECT_FALSE(ScrobblerLogImporter::parseLine("Artist\tAlbum\tTitle\t1\t100\tL\t5000\tmbid\textra", 0, info, skipped));
+}
+
+TEST(ScrobblerLogImporterTest, ImportPages)
+{
+    string path = testing::TempDir() + "scrobblerlogimportertest";
+    writeLog(path, "UTC", 120);
+
+    std::vector<size_t> pageSizes;
+    std::vector<string> firstTracks;
+    ScrobblerLogImporter importer(path, 4);
+    auto statistics = importer.import([&](const SubmissionInfoCollection& page, const std::vector<string>& records) {
+        pageSizes.push_back(page.size());
+        firstTracks.push_back(page.getInfo(0).getTrack());
+        ASSERT_EQ(page.size(), records.size());
+
+        SubmissionInfo info;
+        time_t timeAdded;
+        ASSERT_TRUE(SubmissionRecord::decode(records.back().data(), records.back().size(), info, timeAdded));
+        EXPECT_EQ(page.getInfo(page.size() - 1).getTrack(), info.getTrack());
+        EXPECT_EQ(page.getTimeAdded(page.size() - 1), timeAdded);
+    });
+
+    EXPECT_EQ(123u, statistics.lines);
+    EXPECT_EQ(120u, statistics.imported);
+    EXPECT_EQ(0u, statistics.skipped);
+    EXPECT_EQ(0u, statistics.invalid);
+    EXPECT_EQ(std::vector<size_t>({ 50, 50, 20 }), pageSizes);
+    EXPECT_EQ(std::vector<string>({ "Track0", "Track50", "Track100" }), firstTracks);
+
+    std::remove(path.c_str());
+}
+
+TEST(ScrobblerLogImporterTest, ImportSkippedAndInvalid)
+{
+    string path = testing::TempDir() + "scrobblerlogimporterinvalid";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "#AUDIOSCROBBLER/1.1\r\n#TZ/UTC\r\n";
+        file << "Artist\tAlbum\tTrack1\t1\t200\tL\t1000\t\r\n";
+        file << "Artist\tAlbum\tTrack2\t2\t200\tS\t1200\t\r\n";
+        file << "garbage\r\n";
+        file << "Artist\tAlbum\tNegative\t3\t-1\tL\t1300\t\r\n";
+        file << "Artist\tAlbum\tTrack3\t3\t200\tL\t1400";
+    }
+
+    std::vector<string> tracks;
+    ScrobblerLogImporter importer(path);
+    auto statistics = importer.import([&](const SubmissionInfoCollection& page, const std::vector<string>&) {
+        for (size_t i = 0; i < page.size(); ++i) {
+            tracks.push_back(page.getInfo(i).getTrack());
+        }
+    });
+
+    EXPECT_EQ(7u, statistics.lines);
+    EXPECT_EQ(2u, statistics.imported);
+    EXPECT_EQ(1u, statistics.skipped);
+    EXPECT_EQ(2u, statistics.invalid);
+    EXPECT_EQ(std::vector<string>({ "Track1", "Track3" }), tracks);
+
+    std::remove(path.c_str());
+}
+
+TEST(ScrobblerLogImporterTest, ImportMissingFile)
+{
+    ScrobblerLogImporter importer(testing::TempDir() + "scrobblerlogdoesnotexist");
+    EXPECT_THROW(importer.import([](const SubmissionInfoCollection&, const std::vector<string>&) {}), std::logic_error);
+}
+
+TEST(ScrobblerLogImporterTest, ImportFailureStopsImport)
+{
+    string path = testing::TempDir() + "scrobblerlogimporterfailure";
+    writeLog(path, "UTC", 120);
+
+    // a page that can't be handled stops the import, the pages after it are not passed on
+    size_t pages = 0;
+    ScrobblerLogImporter importer(path, 4);
+    EXPECT_THROW(importer.import([&](const SubmissionInfoCollection&, const std::vector<string>&) {
+        if (++pages == 2) {
+            throw std::logic_error("page failed");
+        }
+    }),
+        std::logic_error);
+    EXPECT_EQ(2u, pages);
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,251 @@
+#include "scrobbleserverstub.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+ScrobbleServerStub::ScrobbleServerStub()
+{
+    m_Socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_Socket < 0) {
+        throw runtime_error("Failed to create server socket");
+    }
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t length = sizeof(address);
+    if (bind(m_Socket, reinterpret_cast<sockaddr*>(&address), length) != 0
+        || listen(m_Socket, SOMAXCONN) != 0
+        || getsockname(m_Socket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        close(m_Socket);
+        throw runtime_error("Failed to start server stub");
+    }
+
+    m_Port = ntohs(address.sin_port);
+    m_AcceptThread = std::thread([this] { acceptThread(); });
+}
+
+ScrobbleServerStub::~ScrobbleServerStub()
+{
+    m_Stop = true;
+    m_AcceptThread.join();
+    close(m_Socket);
+
+    auto lock = std::unique_lock(m_Mutex);
+    m_ConnectionsClosed.wait(lock, [this] { return m_OpenConnections == 0; });
+}
+
+string ScrobbleServerStub::getHandshakeUrl() const
+{
+    return "http://127.0.0.1:" + std::to_string(m_Port) + "/";
+}
+
+void ScrobbleServerStub::setLatency(std::chrono::milliseconds latency)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    m_Latency = latency;
+}
+
+void ScrobbleServerStub::setOnline(bool online)
+{
+    m_Online = online;
+}
+
+void ScrobbleServerStub::setMaxConcurrentHandshakes(int max)
+{
+    m_MaxConcurrentHandshakes = max;
+}
+
+void ScrobbleServerStub::setNowPlayingResponse(const std::string& response)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    m_NowPlayingResponse = response;
+}
+
+void ScrobbleServerStub::setSubmissionResponse(const std::string& response)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    m_SubmissionResponse = response;
+}
+
+void ScrobbleServerStub::setRejectedArtist(const std::string& artist)
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    m_RejectedArtist = artist;
+}
+
+void ScrobbleServerStub::invalidateSessions()
+{
+    auto lock = std::scoped_lock(m_Mutex);
+    m_ValidSessions.clear();
+}
+
+void ScrobbleServerStub::acceptThread()
+{
+    while (!m_Stop) {
+        pollfd fd { m_Socket, POLLIN, 0 };
+        if (poll(&fd, 1, 20) <= 0) {
+            continue;
+        }
+
+        int client = accept(m_Socket, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+
+        if (!m_Online) {
+            close(client);
+            continue;
+        }
+
+        ++m_OpenConnections;
+        std::thread([this, client] {
+            handleConnection(client);
+            close(client);
+
+            auto lock = std::scoped_lock(m_Mutex);
+            --m_OpenConnections;
+            m_ConnectionsClosed.notify_all();
+        }).detach();
+    }
+}
+
+static bool sendAll(int socket, const string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        auto rc = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (rc <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(rc);
+    }
+    return true;
+}
+
+void ScrobbleServerStub::handleConnection(int socket)
+{
+    string request;
+    char buffer[4096];
+
+    size_t headerEnd;
+    while ((headerEnd = request.find("\r\n\r\n")) == string::npos) {
+        auto rc = recv(socket, buffer, sizeof(buffer), 0);
+        if (rc <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(rc));
+    }
+
+    string headers = request.substr(0, headerEnd);
+    string body = request.substr(headerEnd + 4);
+
+    size_t contentLength = 0;
+    auto pos = headers.find("Content-Length: ");
+    if (pos != string::npos) {
+        contentLength = stoul(headers.substr(pos + 16));
+    }
+
+    if (headers.find("Expect: 100-continue") != string::npos && !sendAll(socket, "HTTP/1.1 100 Continue\r\n\r\n")) {
+        return;
+    }
+
+    while (body.size() < contentLength) {
+        auto rc = recv(socket, buffer, sizeof(buffer), 0);
+        if (rc <= 0) {
+            return;
+        }
+        body.append(buffer, static_cast<size_t>(rc));
+    }
+
+    std::chrono::milliseconds latency;
+    {
+        auto lock = std::scoped_lock(m_Mutex);
+        latency = m_Latency;
+    }
+    string content = handleRequest(headers.substr(0, headers.find("\r\n")), body, latency) + "\n";
+    sendAll(socket, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\nContent-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content);
+}
+
+static string getParameter(const string& data, const string& name)
+{
+    auto pos = data.find(name + "=");
+    if (pos == string::npos) {
+        return "";
+    }
+
+    pos += name.size() + 1;
+    return data.substr(pos, data.find_first_of("& ", pos) - pos);
+}
+
+string ScrobbleServerStub::handleRequest(const string& requestLine, const string& body, std::chrono::milliseconds latency)
+{
+    if (requestLine.find("hs=true") != string::npos) {
+        return handleHandshake(requestLine, latency);
+    }
+
+    this_thread::sleep_for(latency);
+
+    auto lock = std::scoped_lock(m_Mutex);
+    bool validSession = m_ValidSessions.count(getParameter(body, "s")) > 0;
+
+    if (requestLine.find("/np") != string::npos) {
+        ++m_NowPlayingRequests;
+        return validSession ? m_NowPlayingResponse : "BADSESSION";
+    }
+
+    if (requestLine.find("/submit") != string::npos) {
+        ++m_SubmissionRequests;
+        if (!validSession) {
+            return "BADSESSION";
+        }
+
+        if (!m_RejectedArtist.empty() && body.find("]=" + m_RejectedArtist + "&t[") != string::npos) {
+            return "FAILED Invalid track";
+        }
+
+        if (m_SubmissionResponse == "OK") {
+            for (auto pos = body.find("&a["); pos != string::npos; pos = body.find("&a[", pos + 1)) {
+                ++m_SubmittedTracks;
+            }
+        }
+        return m_SubmissionResponse;
+    }
+
+    return "FAILED Unknown request";
+}
+
+string ScrobbleServerStub::handleHandshake(const string& requestLine, std::chrono::milliseconds latency)
+{
+    int concurrent = ++m_ConcurrentHandshakes;
+    int observed = m_MaxObservedConcurrentHandshakes;
+    while (concurrent > observed && !m_MaxObservedConcurrentHandshakes.compare_exchange_weak(observed, concurrent)) {
+    }
+
+    this_thread::sleep_for(latency);
+
+    string response;
+    if (m_MaxConcurrentHandshakes > 0 && concurrent > m_MaxConcurrentHandshakes) {
+        ++m_RejectedHandshakes;
+        response = "FAILED Rate limited";
+    } else {
+        ++m_Handshakes;
+        auto lock = std::scoped_lock(m_Mutex);
+        string& session = m_UserSessions[getParameter(requestLine, "u")];
+        m_ValidSessions.erase(session);
+        session = "session" + std::to_string(++m_SessionCount);
+        m_ValidSessions.insert(session);
+        response = "OK\n" + session + "\n" + getHandshakeUrl() + "np\n" + getHandshakeUrl() + "submit";
+    }
+
+    --m_ConcurrentHandshakes;
+    return response;
+}
@@ -0,0 +1,72 @@
+#ifndef SCROBBLE_SERVER_STUB_H
+#define SCROBBLE_SERVER_STUB_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+/** Local stand-in for the Audioscrobbler server. Listens on a loopback
+ * port and answers handshake, now playing and submission requests, the
+ * latency and the responses can be changed to simulate upstream problems.
+ */
+class ScrobbleServerStub {
+public:
+    ScrobbleServerStub();
+    ~ScrobbleServerStub();
+    ScrobbleServerStub(const ScrobbleServerStub&) = delete;
+    ScrobbleServerStub& operator=(const ScrobbleServerStub&) = delete;
+
+    std::string getHandshakeUrl() const;
+
+    void setLatency(std::chrono::milliseconds latency);
+    // when offline, connections are closed without a response
+    void setOnline(bool online);
+    // handshakes above this number of concurrent requests are refused with FAILED
+    void setMaxConcurrentHandshakes(int max);
+    void setNowPlayingResponse(const std::string& response);
+    void setSubmissionResponse(const std::string& response);
+    // submissions that contain a track of this artist are answered with FAILED
+    void setRejectedArtist(const std::string& artist);
+    // all sessions become invalid, requests get BADSESSION until the next handshake
+    void invalidateSessions();
+
+    std::atomic<int> m_Handshakes {};
+    std::atomic<int> m_RejectedHandshakes {};
+    std::atomic<int> m_MaxObservedConcurrentHandshakes {};
+    std::atomic<int> m_NowPlayingRequests {};
+    std::atomic<int> m_SubmissionRequests {};
+    std::atomic<int> m_SubmittedTracks {};
+
+private:
+    void acceptThread();
+    void handleConnection(int socket);
+    std::string handleRequest(const std::string& requestLine, const std::string& body, std::chrono::milliseconds latency);
+    std::string handleHandshake(const std::string& requestLine, std::chrono::milliseconds latency);
+
+    int m_Socket { -1 };
+    uint16_t m_Port {};
+    std::thread m_AcceptThread;
+
+    std::atomic<bool> m_Stop {};
+    std::atomic<bool> m_Online { true };
+    std::atomic<int> m_MaxConcurrentHandshakes {};
+    std::atomic<int> m_ConcurrentHandshakes {};
+    std::atomic<int> m_OpenConnections {};
+
+    std::mutex m_Mutex;
+    std::condition_variable m_ConnectionsClosed;
+    std::chrono::milliseconds m_Latency {};
+    std::map<std::string, std::string> m_UserSessions;
+    std::set<std::string> m_ValidSessions;
+    int m_SessionCount {};
+    std::string m_NowPlayingResponse { "OK" };
+    std::string m_SubmissionResponse { "OK" };
+    std::string m_RejectedArtist;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/sessioncache.h"
+
+#include <cstdio>
+
+using std::string;
+
+TEST(SessionCacheTest, StoreAndLoad)
+{
+    string path = testing::TempDir() + "sessioncachetest";
+    std::remove(path.c_str());
+
+    SessionCache cache(path);
+    LastFmSession session;
+    EXPECT_FALSE(cache.load("user1", session));
+
+    cache.store("user1", LastFmSession { "id1", "http://np/1", "http://submit/1" });
+    cache.store("user2", LastFmSession { "id2", "http://np/2", "http://submit/2" });
+    cache.store("user1", LastFmSession { "id3", "http://np/3", "http://submit/3" });
+
+    SessionCache otherCache(path);
+    ASSERT_TRUE(otherCache.load("user1", session));
+    EXPECT_EQ("id3", session.sessionId);
+    EXPECT_EQ("http://np/3", session.nowPlayingUrl);
+    EXPECT_EQ("http://submit/3", session.submissionUrl);
+
+    ASSERT_TRUE(otherCache.load("user2", session));
+    EXPECT_EQ("id2", session.sessionId);
+
+    otherCache.remove("user2");
+    EXPECT_FALSE(cache.load("user2", session));
+    EXPECT_TRUE(cache.load("user1", session));
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/submissiondedupindex.h"
+
+using namespace std::chrono;
+
+TEST(SubmissionDedupIndexTest, Duplicates)
+{
+    SubmissionDedupIndex index(hours(1));
+
+    EXPECT_TRUE(index.insert(SubmissionInfo("Artist", "Track", 100), 1000));
+    EXPECT_TRUE(index.insert(SubmissionInfo("Artist", "Track", 101), 1000));
+    EXPECT_TRUE(index.insert(SubmissionInfo("Artist", "Other", 100), 1000));
+    EXPECT_TRUE(index.insert(SubmissionInfo("ArtistT", "rack", 100), 1000));
+    EXPECT_EQ(0u, index.getFilteredCount());
+
+    EXPECT_FALSE(index.insert(SubmissionInfo("Artist", "Track", 100), 1001));
+    EXPECT_FALSE(index.insert(SubmissionInfo("Artist", "Other", 100), 1002));
+    EXPECT_EQ(2u, index.getFilteredCount());
+
+    // checking does not add the submission
+    EXPECT_FALSE(index.isDuplicate(SubmissionInfo("Artist", "New", 100), 1003));
+    EXPECT_TRUE(index.insert(SubmissionInfo("Artist", "New", 100), 1003));
+    EXPECT_TRUE(index.isDuplicate(SubmissionInfo("Artist", "New", 100), 1004));
+    EXPECT_EQ(3u, index.getFilteredCount());
+}
+
+TEST(SubmissionDedupIndexTest, Window)
+{
+    SubmissionDedupIndex index(seconds(100));
+    SubmissionInfo info("Artist", "Track", 100);
+
+    EXPECT_TRUE(index.insert(info, 1000));
+    // half a window later the entry moves to the previous filter
+    EXPECT_FALSE(index.insert(info, 1060));
+    EXPECT_FALSE(index.insert(info, 1099));
+    // a full window later it is forgotten
+    EXPECT_TRUE(index.insert(info, 1160));
+    EXPECT_TRUE(index.insert(SubmissionInfo("Artist", "Other", 100), 1400));
+    EXPECT_TRUE(index.insert(info, 1400));
+}
+
+TEST(SubmissionDedupIndexTest, FalsePositives)
+{
+    SubmissionDedupIndex index(hours(24));
+
+    for (int i = 0; i < 2000; ++i) {
+        index.insert(SubmissionInfo("Artist", "Track", i), 1000);
+    }
+
+    int falsePositives = 0;
+    for (int i = 2000; i < 12000; ++i) {
+        if (!index.insert(SubmissionInfo("Artist", "Track", i), 1000)) {
+            ++falsePositives;
+        }
+    }
+    EXPECT_LT(falsePositives, 5);
+}
@@ -32,3 +32,51 @@ TEST(SubmissionInfoCollectionTest, GetPostData)
                       "&o[1]=U&r[1]=&l[1]=2&b[1]=An+Album2&n[1]=2&m[1]=";
     EXPECT_EQ(expected, collection.getPostData());
 }
+
+TEST(SubmissionInfoCollectionTest, FlushRequired)
+{
+    SubmissionBatchPolicy policy;
+    policy.maxTracks = 3;
+    policy.maxAgeInSecs = 60;
+
+    SubmissionInfoCollection collection;
+    EXPECT_FALSE(collection.isFlushRequired(policy, 1000));
+
+    collection.addInfo(SubmissionInfo("The Artist1", "Trackname1", 100), 1000);
+    collection.addInfo(SubmissionInfo("The Artist2", "Trackname2", 200), 1010);
+    EXPECT_EQ(2u, collection.size());
+    EXPECT_EQ(1010, collection.getTimeAdded(1));
+    EXPECT_FALSE(collection.isFlushRequired(policy, 1059));
+    EXPECT_TRUE(collection.isFlushRequired(policy, 1060));
+
+    collection.addInfo(SubmissionInfo("The Artist3", "Trackname3", 300), 1020);
+    EXPECT_TRUE(collection.isFlushRequired(policy, 1020));
+
+    collection.clear();
+    EXPECT_TRUE(collection.empty());
+    EXPECT_FALSE(collection.isFlushRequired(policy, 2000));
+}
+
+TEST(SubmissionInfoCollectionTest, DuplicatesFiltered)
+{
+    SubmissionInfoCollection collection;
+    collection.setDedupIndex(std::make_shared<SubmissionDedupIndex>(std::chrono::hours(1)));
+
+    EXPECT_TRUE(collection.addInfo(SubmissionInfo("The Artist1", "Trackname1", 100), 1000));
+    EXPECT_TRUE(collection.addInfo(SubmissionInfo("The Artist1", "Trackname1", 400), 1000));
+    EXPECT_FALSE(collection.addInfo(SubmissionInfo("The Artist1", "Trackname1", 100), 1010));
+    EXPECT_EQ(2u, collection.size());
+
+    SubmissionInfo info2("The Artist2", "Trackname2", 100);
+    info2.setTrackLength(200);
+    SubmissionInfo info3("The Artist3", "Trackname3", 100);
+    info3.setTrackLength(200);
+
+    collection.clear();
+    collection.addInfo(info2, 1020);
+
+    // the post data is generated again after the collection changed
+    string postData = collection.getPostData();
+    collection.addInfo(info3, 1030);
+    EXPECT_NE(postData, collection.getPostData());
+}
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/submissionlog.h"
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+using std::string;
+
+static SubmissionInfo createInfo(int index)
+{
+    SubmissionInfo info("Artist" + std::to_string(index), "Track", 1000 + index);
+    info.setAlbum("Album");
+    info.setTrackLength(200);
+    info.setTrackNr(index);
+    info.setMusicBrainzId("mbid");
+    info.setSource(Lastfm, "12345");
+    info.setRating(Love);
+    return info;
+}
+
+TEST(SubmissionLogTest, AppendAndReplay)
+{
+    string path = testing::TempDir() + "submissionlogtest";
+    std::remove(path.c_str());
+
+    {
+        SubmissionLog log(path);
+        log.append(createInfo(1), 10);
+        log.append(createInfo(2), 20);
+        EXPECT_EQ(2u, log.size());
+    }
+
+    SubmissionLog log(path);
+    SubmissionInfoCollection infos;
+    EXPECT_EQ(2u, log.replay(infos));
+    ASSERT_EQ(2u, infos.size());
+    EXPECT_EQ(20, infos.getTimeAdded(1));
+
+    const SubmissionInfo& info = infos.getInfo(1);
+    EXPECT_EQ("Artist2", info.getArtist());
+    EXPECT_EQ("Track", info.getTrack());
+    EXPECT_EQ("Album", info.getAlbum());
+    EXPECT_EQ(1002, info.getTimeStarted());
+    EXPECT_EQ(200, info.getTrackLength());
+    EXPECT_EQ(2, info.getTrackNr());
+    EXPECT_EQ("mbid", info.getMusicBrainzId());
+    EXPECT_EQ(Lastfm, info.getSource());
+    EXPECT_EQ("12345", info.getRecommendationKey());
+    EXPECT_EQ(Love, info.getRating());
+
+    log.truncate();
+    EXPECT_EQ(0u, log.size());
+
+    SubmissionLog otherLog(path);
+    SubmissionInfoCollection otherInfos;
+    EXPECT_EQ(0u, otherLog.replay(otherInfos));
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionLogTest, Rewrite)
+{
+    string path = testing::TempDir() + "submissionlogtest";
+    std::remove(path.c_str());
+
+    {
+        SubmissionLog log(path);
+        for (int i = 1; i <= 3; ++i) {
+            log.append(createInfo(i), i * 10);
+        }
+
+        SubmissionInfoCollection remaining;
+        remaining.addInfo(createInfo(3), 30);
+        log.rewrite(remaining);
+        EXPECT_EQ(1u, log.size());
+
+        // later records are appended to the new log
+        log.append(createInfo(4), 40);
+    }
+    EXPECT_FALSE(std::ifstream(path + ".new").good());
+
+    SubmissionLog log(path);
+    SubmissionInfoCollection infos;
+    EXPECT_EQ(2u, log.replay(infos));
+    ASSERT_EQ(2u, infos.size());
+    EXPECT_EQ("Artist3", infos.getInfo(0).getArtist());
+    EXPECT_EQ(40, infos.getTimeAdded(1));
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionLogTest, DamagedTail)
+{
+    string path = testing::TempDir() + "submissionlogtest";
+    std::remove(path.c_str());
+
+    {
+        SubmissionLog log(path);
+        log.append(createInfo(1), 10);
+        log.append(createInfo(2), 20);
+    }
+
+    {
+        // a record that was only partially written
+        std::ofstream file(path, std::ios::app | std::ios::binary);
+        file.write("\x30\x00\x00\x00\x12\x34", 6);
+    }
+
+    {
+        SubmissionLog log(path);
+        SubmissionInfoCollection infos;
+        EXPECT_EQ(2u, log.replay(infos));
+        log.append(createInfo(3), 30);
+    }
+
+    SubmissionLog log(path);
+    SubmissionInfoCollection infos;
+    EXPECT_EQ(3u, log.replay(infos));
+    EXPECT_EQ("Artist3", infos.getInfo(2).getArtist());
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionLogTest, ConcurrentAppends)
+{
+    string path = testing::TempDir() + "submissionlogtest";
+    std::remove(path.c_str());
+
+    {
+        SubmissionLog log(path);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&log, i] {
+                for (int j = 0; j < 10; ++j) {
+                    log.append(createInfo(i * 10 + j), 0);
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        EXPECT_EQ(40u, log.size());
+    }
+
+    SubmissionLog log(path);
+    SubmissionInfoCollection infos;
+    EXPECT_EQ(40u, log.replay(infos));
+
+    std::remove(path.c_str());
+}
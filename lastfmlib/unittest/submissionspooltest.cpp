@@ -0,0 +1,283 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/submissionrecord.h"
+#include "lastfmlib/submissionspool.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+
+static SubmissionInfo createInfo(int index)
+{
+    SubmissionInfo info("Artist", "Track" + std::to_string(index), 1000 + index);
+    info.setTrackLength(200);
+    return info;
+}
+
+TEST(SubmissionSpoolTest, EnqueueAndRead)
+{
+    string path = testing::TempDir() + "submissionspooltest";
+    std::remove(path.c_str());
+
+    SubmissionSpool spool(path, 200);
+    EXPECT_TRUE(spool.empty());
+    for (int i = 0; i < 120; ++i) {
+        EXPECT_TRUE(spool.enqueue(createInfo(i), i));
+    }
+    EXPECT_EQ(120u, spool.size());
+
+    SubmissionInfoCollection page;
+    EXPECT_EQ(50u, spool.readPage(0, page));
+    ASSERT_EQ(50u, page.size());
+    EXPECT_EQ("Track0", page.getInfo(0).getTrack());
+    EXPECT_EQ(49, page.getTimeAdded(49));
+
+    SubmissionInfoCollection nextPage;
+    EXPECT_EQ(50u, spool.readPage(50, nextPage));
+    EXPECT_EQ("Track50", nextPage.getInfo(0).getTrack());
+
+    spool.remove(100);
+    SubmissionInfoCollection lastPage;
+    EXPECT_EQ(20u, spool.readPage(0, lastPage));
+    EXPECT_EQ("Track100", lastPage.getInfo(0).getTrack());
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionSpoolTest, EnqueueRecord)
+{
+    string path = testing::TempDir() + "submissionspooltest";
+    std::remove(path.c_str());
+
+    SubmissionSpool spool(path, 2);
+    string record;
+    SubmissionRecord::encode(createInfo(1), 5, record);
+    EXPECT_TRUE(spool.enqueueRecord(record));
+    EXPECT_TRUE(spool.enqueue(createInfo(2), 6));
+    EXPECT_FALSE(spool.enqueueRecord(record));
+    EXPECT_THROW(spool.enqueueRecord(string(SubmissionSpool::MAX_RECORD_SIZE + 1, 'a')), std::logic_error);
+
+    SubmissionInfoCollection page;
+    EXPECT_EQ(2u, spool.readPage(0, page));
+    ASSERT_EQ(2u, page.size());
+    EXPECT_EQ("Track1", page.getInfo(0).getTrack());
+    EXPECT_EQ(5, page.getTimeAdded(0));
+    EXPECT_EQ("Track2", page.getInfo(1).getTrack());
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionSpoolTest, WrapAroundAndFull)
+{
+    string path = testing::TempDir() + "submissionspooltest";
+    std::remove(path.c_str());
+
+    SubmissionSpool spool(path, 8);
+    for (int i = 0; i < 6; ++i) {
+        EXPECT_TRUE(spool.enqueue(createInfo(i), 0));
+    }
+    spool.remove(5);
+
+    for (int i = 6; i < 13; ++i) {
+        EXPECT_TRUE(spool.enqueue(createInfo(i), 0));
+    }
+    EXPECT_FALSE(spool.enqueue(createInfo(13), 0));
+    EXPECT_EQ(8u, spool.size());
+
+    SubmissionInfoCollection page;
+    EXPECT_EQ(8u, spool.readPage(0, page));
+    EXPECT_EQ("Track5", page.getInfo(0).getTrack());
+    EXPECT_EQ("Track12", page.getInfo(7).getTrack());
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionSpoolTest, Reopen)
+{
+    string path = testing::TempDir() + "submissionspooltest";
+    std::remove(path.c_str());
+
+    {
+        SubmissionSpool spool(path, 16);
+        for (int i = 0; i < 4; ++i) {
+            spool.enqueue(createInfo(i), 0);
+        }
+        spool.remove(1);
+    }
+
+    {
+        // simulate a crash after the slots were written but before the tail was updated
+        int fd = open(path.c_str(), O_RDWR);
+        uint64_t tail = 2;
+        EXPECT_EQ(static_cast<ssize_t>(sizeof(tail)), pwrite(fd, &tail, sizeof(tail), 32));
+        close(fd);
+    }
+
+    SubmissionSpool spool(path, 1000);
+    EXPECT_EQ(16u, spool.capacity());
+    EXPECT_EQ(3u, spool.size());
+
+    SubmissionInfoCollection page;
+    EXPECT_EQ(3u, spool.readPage(0, page));
+    EXPECT_EQ("Track1", page.getInfo(0).getTrack());
+    EXPECT_EQ("Track3", page.getInfo(2).getTrack());
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionSpoolTest, TailPastWrittenSlots)
+{
+    string path = testing::TempDir() + "submissionspooltest";
+    std::remove(path.c_str());
+
+    {
+        SubmissionSpool spool(path, 16);
+        for (int i = 0; i < 3; ++i) {
+            spool.enqueue(createInfo(i), 0);
+        }
+    }
+
+    {
+        // a tail that points at slots that never reached the disk
+        int fd = open(path.c_str(), O_RDWR);
+        uint64_t tail = 6;
+        EXPECT_EQ(static_cast<ssize_t>(sizeof(tail)), pwrite(fd, &tail, sizeof(tail), 32));
+        close(fd);
+    }
+
+    SubmissionSpool spool(path, 16);
+    EXPECT_EQ(3u, spool.size());
+    EXPECT_TRUE(spool.enqueue(createInfo(3), 0));
+
+    SubmissionInfoCollection page;
+    EXPECT_EQ(4u, spool.readPage(0, page));
+    ASSERT_EQ(4u, page.size());
+    EXPECT_EQ("Track3", page.getInfo(3).getTrack());
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionSpoolTest, PagesAfterRemove)
+{
+    string path = testing::TempDir() + "submissionspooltest";
+    std::remove(path.c_str());
+
+    SubmissionSpool spool(path, 64);
+    for (int i = 0; i < 30; ++i) {
+        spool.enqueue(createInfo(i), 0);
+    }
+
+    // pages are read ahead of the removal, like a pipelined drain does
+    SubmissionInfoCollection first;
+    SubmissionInfoCollection second;
+    EXPECT_EQ(10u, spool.readPage(0, first, 10));
+    EXPECT_EQ(10u, spool.readPage(10, second, 10));
+    spool.remove(10);
+
+    SubmissionInfoCollection third;
+    EXPECT_EQ(10u, spool.readPage(10, third, 10));
+    EXPECT_EQ("Track20", third.getInfo(0).getTrack());
+
+    SubmissionInfoCollection earlier;
+    EXPECT_EQ(5u, spool.readPage(5, earlier, 5));
+    EXPECT_EQ("Track15", earlier.getInfo(0).getTrack());
+
+    spool.remove(15);
+    EXPECT_EQ(5u, spool.size());
+    SubmissionInfoCollection last;
+    EXPECT_EQ(5u, spool.readPage(0, last));
+    EXPECT_EQ("Track25", last.getInfo(0).getTrack());
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionSpoolTest, MarkSubmitted)
+{
+    string path = testing::TempDir() + "submissionspooltest";
+    std::remove(path.c_str());
+
+    {
+        SubmissionSpool spool(path, 16);
+        for (int i = 0; i < 6; ++i) {
+            spool.enqueue(createInfo(i), 0);
+        }
+        spool.markSubmitted(2, 3);
+    }
+
+    SubmissionSpool spool(path, 16);
+    EXPECT_EQ(6u, spool.size());
+
+    SubmissionInfoCollection page;
+    EXPECT_EQ(6u, spool.readPage(0, page));
+    ASSERT_EQ(3u, page.size());
+    EXPECT_EQ("Track1", page.getInfo(1).getTrack());
+    EXPECT_EQ("Track5", page.getInfo(2).getTrack());
+
+    spool.remove(5);
+    SubmissionInfoCollection last;
+    EXPECT_EQ(1u, spool.readPage(0, last));
+    EXPECT_EQ("Track5", last.getInfo(0).getTrack());
+
+    std::remove(path.c_str());
+}
+
+TEST(SubmissionSpoolTest, LargeRecords)
+{
+    string path = testing::TempDir() + "submissionspooltest";
+    std::remove(path.c_str());
+
+    // takes 3 slots
+    string longArtist(600, 'a');
+    SubmissionInfo large(longArtist, "Long", 1000);
+    large.setTrackLength(200);
+
+    {
+        SubmissionSpool spool(path, 8);
+        EXPECT_TRUE(spool.enqueue(createInfo(0), 0));
+        EXPECT_TRUE(spool.enqueue(createInfo(1), 0));
+        EXPECT_TRUE(spool.enqueue(large, 0));
+        EXPECT_TRUE(spool.enqueue(createInfo(2), 0));
+        spool.remove(2);
+        EXPECT_EQ(2u, spool.size());
+
+        // the slots of this entry wrap around the end of the ring
+        EXPECT_TRUE(spool.enqueue(large, 1));
+        EXPECT_TRUE(spool.enqueue(createInfo(3), 0));
+        EXPECT_FALSE(spool.enqueue(createInfo(4), 0));
+        EXPECT_EQ(4u, spool.size());
+
+        spool.remove(1);
+        EXPECT_TRUE(spool.enqueue(createInfo(4), 0));
+        EXPECT_TRUE(spool.enqueue(createInfo(5), 0));
+        EXPECT_FALSE(spool.enqueue(large, 2));
+        EXPECT_EQ(5u, spool.size());
+
+        SubmissionInfo huge(string(SubmissionSpool::MAX_RECORD_SIZE, 'a'), "Huge", 1000);
+        EXPECT_THROW(spool.enqueue(huge, 0), std::logic_error);
+    }
+
+    SubmissionSpool spool(path, 8);
+    EXPECT_EQ(5u, spool.size());
+
+    SubmissionInfoCollection page;
+    EXPECT_EQ(5u, spool.readPage(0, page));
+    ASSERT_EQ(5u, page.size());
+    EXPECT_EQ("Track2", page.getInfo(0).getTrack());
+    EXPECT_EQ(longArtist, page.getInfo(1).getArtist());
+    EXPECT_EQ(1, page.getTimeAdded(1));
+    EXPECT_EQ("Track5", page.getInfo(4).getTrack());
+
+    SubmissionInfoCollection nextPage;
+    EXPECT_EQ(4u, spool.readPage(1, nextPage));
+    EXPECT_EQ(longArtist, nextPage.getInfo(0).getArtist());
+    EXPECT_EQ("Track3", nextPage.getInfo(1).getTrack());
+
+    spool.remove(2);
+    EXPECT_EQ(3u, spool.size());
+    EXPECT_TRUE(spool.enqueue(large, 0));
+    EXPECT_EQ(4u, spool.size());
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "lastfmlib/timerwheel.h"
+
+#include <vector>
+
+using std::vector;
+
+TEST(TimerWheelTest, ExpiresOnTime)
+{
+    TimerWheel wheel;
+    vector<uint64_t> delays = { 1, 5, 63, 64, 65, 200, 4095, 4096, 4097, 300000 };
+
+    vector<uint64_t> fired;
+    for (auto delay : delays) {
+        wheel.schedule(delay, [&fired, &wheel] { fired.push_back(wheel.getCurrentTick()); });
+    }
+    EXPECT_EQ(delays.size(), wheel.size());
+
+    for (uint64_t tick = 1; tick <= 300000; ++tick) {
+        for (auto& timer : wheel.advance()) {
+            timer.callback();
+        }
+    }
+
+    EXPECT_EQ(delays, fired);
+    EXPECT_EQ(0u, wheel.size());
+}
+
+TEST(TimerWheelTest, ScheduleAfterAdvance)
+{
+    TimerWheel wheel;
+    wheel.advance(70);
+
+    auto id = wheel.schedule(4090, [] {});
+    EXPECT_TRUE(wheel.advance(4089).empty());
+
+    auto expired = wheel.advance();
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_EQ(id, expired[0].id);
+    EXPECT_EQ(4160u, wheel.getCurrentTick());
+}
+
+TEST(TimerWheelTest, Cancel)
+{
+    TimerWheel wheel;
+    auto id1 = wheel.schedule(10, [] {});
+    auto id2 = wheel.schedule(1000, [] {});
+
+    EXPECT_TRUE(wheel.cancel(id2));
+    EXPECT_FALSE(wheel.cancel(id2));
+
+    auto expired = wheel.advance(2000);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_EQ(id1, expired[0].id);
+    EXPECT_FALSE(wheel.cancel(id1));
+}
+
+TEST(TimerWheelTest, ManyTimers)
+{
+    TimerWheel wheel;
+    const uint64_t count = 50000;
+
+    for (uint64_t i = 0; i < count; ++i) {
+        wheel.schedule(1 + (i * 7919) % 72000, [] {});
+    }
+
+    size_t expiredCount = 0;
+    for (int i = 0; i < 72000; ++i) {
+        expiredCount += wheel.advance().size();
+    }
+
+    EXPECT_EQ(count, expiredCount);
+}
@@ -20,9 +20,13 @@
 #include <curl/curl.h>
 #include <stdexcept>
 
+#include "tracepoints.h"
+
 using namespace std;
 
 size_t receiveData(char* data, size_t size, size_t nmemb, string* pBuffer);
+static int checkAborted(void* pAborted, curl_off_t, curl_off_t, curl_off_t, curl_off_t);
+static void readTransferTiming(CURL* curlHandle, TransferTiming& timing);
 
 UrlClient::UrlClient()
 {
@@ -59,7 +63,22 @@ void UrlClient::setProxy(const std::string& server, uint32_t port, const std::st
     }
 }
 
-void UrlClient::get(const string& url, string& response) const
+void UrlClient::setTimeout(std::chrono::milliseconds timeout)
+{
+    m_TimeoutInMs = timeout.count();
+}
+
+void UrlClient::abort()
+{
+    m_Aborted = true;
+}
+
+bool UrlClient::isAborted() const
+{
+    return m_Aborted;
+}
+
+void UrlClient::get(const string& url, string& response, TransferTiming* pTiming) const
 {
     CURL* curlHandle = curl_easy_init();
     assert(curlHandle);
@@ -70,6 +89,10 @@ void UrlClient::get(const string& url, string& response) const
     curl_easy_setopt(curlHandle, CURLOPT_FAILONERROR, 1);
     curl_easy_setopt(curlHandle, CURLOPT_CONNECTTIMEOUT, 5);
     curl_easy_setopt(curlHandle, CURLOPT_NOSIGNAL, 1);
+    curl_easy_setopt(curlHandle, CURLOPT_TIMEOUT_MS, static_cast<long>(m_TimeoutInMs));
+    curl_easy_setopt(curlHandle, CURLOPT_XFERINFOFUNCTION, checkAborted);
+    curl_easy_setopt(curlHandle, CURLOPT_XFERINFODATA, &m_Aborted);
+    curl_easy_setopt(curlHandle, CURLOPT_NOPROGRESS, 0L);
 
     if (!m_ProxyServer.empty()) {
         curl_easy_setopt(curlHandle, CURLOPT_PROXY, m_ProxyServer.c_str());
@@ -79,15 +102,23 @@ void UrlClient::get(const string& url, string& response) const
         curl_easy_setopt(curlHandle, CURLOPT_PROXYUSERPWD, m_ProxyUserPass.c_str());
     }
 
-    CURLcode rc = curl_easy_perform(curlHandle);
+    LASTFMLIB_TRACE(http__start, url.c_str(), 0);
+    CURLcode rc = CURLE_ABORTED_BY_CALLBACK;
+    if (!m_Aborted) {
+        rc = curl_easy_perform(curlHandle);
+        if (pTiming) {
+            readTransferTiming(curlHandle, *pTiming);
+        }
+    }
     curl_easy_cleanup(curlHandle);
+    LASTFMLIB_TRACE(http__done, url.c_str(), static_cast<int>(rc), response.size());
 
     if (CURLE_OK != rc) {
         throw std::logic_error("Failed to get " + url + ": " + curl_easy_strerror(rc));
     }
 }
 
-void UrlClient::post(const string& url, const string& data, string& response)
+void UrlClient::post(const string& url, const string& data, string& response, TransferTiming* pTiming) const
 {
     CURL* curlHandle = curl_easy_init();
     assert(curlHandle);
@@ -99,9 +130,21 @@ void UrlClient::post(const string& url, const string& data, string& response)
     curl_easy_setopt(curlHandle, CURLOPT_FAILONERROR, 1);
     curl_easy_setopt(curlHandle, CURLOPT_CONNECTTIMEOUT, 5);
     curl_easy_setopt(curlHandle, CURLOPT_NOSIGNAL, 1);
-
-    CURLcode rc = curl_easy_perform(curlHandle);
+    curl_easy_setopt(curlHandle, CURLOPT_TIMEOUT_MS, static_cast<long>(m_TimeoutInMs));
+    curl_easy_setopt(curlHandle, CURLOPT_XFERINFOFUNCTION, checkAborted);
+    curl_easy_setopt(curlHandle, CURLOPT_XFERINFODATA, &m_Aborted);
+    curl_easy_setopt(curlHandle, CURLOPT_NOPROGRESS, 0L);
+
+    LASTFMLIB_TRACE(http__start, url.c_str(), data.size());
+    CURLcode rc = CURLE_ABORTED_BY_CALLBACK;
+    if (!m_Aborted) {
+        rc = curl_easy_perform(curlHandle);
+        if (pTiming) {
+            readTransferTiming(curlHandle, *pTiming);
+        }
+    }
     curl_easy_cleanup(curlHandle);
+    LASTFMLIB_TRACE(http__done, url.c_str(), static_cast<int>(rc), response.size());
 
     if (CURLE_OK != rc) {
         throw std::logic_error("Failed to post " + url + ": " + curl_easy_strerror(rc));
@@ -115,3 +158,29 @@ size_t receiveData(char* data, size_t size, size_t nmemb, string* pBuffer)
 
     return dataSize;
 }
+
+int checkAborted(void* pAborted, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+    return *static_cast<const std::atomic<bool>*>(pAborted) ? 1 : 0;
+}
+
+template <typename T>
+static T getInfo(CURL* curlHandle, CURLINFO info)
+{
+    T value {};
+    curl_easy_getinfo(curlHandle, info, &value);
+    return value;
+}
+
+void readTransferTiming(CURL* curlHandle, TransferTiming& timing)
+{
+    timing.nameLookup = chrono::microseconds(getInfo<curl_off_t>(curlHandle, CURLINFO_NAMELOOKUP_TIME_T));
+    timing.connect = chrono::microseconds(getInfo<curl_off_t>(curlHandle, CURLINFO_CONNECT_TIME_T));
+    timing.appConnect = chrono::microseconds(getInfo<curl_off_t>(curlHandle, CURLINFO_APPCONNECT_TIME_T));
+    timing.startTransfer = chrono::microseconds(getInfo<curl_off_t>(curlHandle, CURLINFO_STARTTRANSFER_TIME_T));
+    timing.total = chrono::microseconds(getInfo<curl_off_t>(curlHandle, CURLINFO_TOTAL_TIME_T));
+    // the request size includes the post data
+    timing.bytesSent = static_cast<uint64_t>(getInfo<long>(curlHandle, CURLINFO_REQUEST_SIZE));
+    timing.bytesReceived = static_cast<uint64_t>(getInfo<long>(curlHandle, CURLINFO_HEADER_SIZE))
+        + static_cast<uint64_t>(getInfo<curl_off_t>(curlHandle, CURLINFO_SIZE_DOWNLOAD_T));
+}
@@ -17,8 +17,25 @@
 #ifndef URL_CLIENT_H
 #define URL_CLIENT_H
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
 
+/** The TransferTiming struct contains the timing of a request as reported
+ * by curl. The times are measured from the start of the request, so the
+ * connect time includes the name lookup and so on.
+ */
+struct TransferTiming {
+    std::chrono::microseconds nameLookup {}; /**< \brief until the name was resolved */
+    std::chrono::microseconds connect {}; /**< \brief until the connection was established */
+    std::chrono::microseconds appConnect {}; /**< \brief until the TLS handshake finished (0 without TLS) */
+    std::chrono::microseconds startTransfer {}; /**< \brief until the first byte of the response was received */
+    std::chrono::microseconds total {}; /**< \brief until the request finished */
+    uint64_t bytesSent {}; /**< \brief request headers and body */
+    uint64_t bytesReceived {}; /**< \brief response headers and body */
+};
+
 class UrlClient {
 public:
     UrlClient();
@@ -28,12 +45,18 @@ public:
 
     void setProxy(const std::string& server, uint32_t port = 8080, const std::string& username = "", const std::string& password = "");
 
-    void get(const std::string& url, std::string& response) const;
-    static void post(const std::string& url, const std::string& data, std::string& response);
+    void setTimeout(std::chrono::milliseconds timeout);
+    void abort();
+    bool isAborted() const;
+
+    void get(const std::string& url, std::string& response, TransferTiming* pTiming = nullptr) const;
+    void post(const std::string& url, const std::string& data, std::string& response, TransferTiming* pTiming = nullptr) const;
 
 private:
     std::string m_ProxyServer;
     std::string m_ProxyUserPass;
+    std::atomic<int64_t> m_TimeoutInMs {};
+    std::atomic<bool> m_Aborted {};
 };
 
 #endif
@@ -0,0 +1,132 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file boundedmpscqueue.h
+ * @brief Contains the BoundedMpscQueue class
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef UTILS_BOUNDED_MPSC_QUEUE_H
+#define UTILS_BOUNDED_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+/** The BoundedMpscQueue class is a fixed size lock-free queue for many
+ * producers and a single consumer. Every slot carries a sequence number
+ * that tells whether it is free for the producer that claimed its
+ * position or holds a value for the consumer. Producers only contend on
+ * the enqueue position, push never waits and fails when the queue is full.
+ */
+template <typename T>
+class BoundedMpscQueue {
+public:
+    /** Constructor
+     * \param capacity the number of slots, must be a power of two
+     */
+    explicit BoundedMpscQueue(size_t capacity)
+    : m_Cells(std::make_unique<Cell[]>(capacity))
+    , m_Mask(capacity - 1)
+    {
+        if (capacity < 2 || (capacity & m_Mask) != 0) {
+            throw std::logic_error("BoundedMpscQueue: capacity must be a power of two");
+        }
+
+        for (size_t i = 0; i < capacity; ++i) {
+            m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedMpscQueue(const BoundedMpscQueue&) = delete;
+    BoundedMpscQueue& operator=(const BoundedMpscQueue&) = delete;
+
+    /** Add a value to the queue, can be called from any thread
+     * \param value the value to add, it is only moved from on success
+     * \return false if the queue was full
+     */
+    bool push(T& value)
+    {
+        uint64_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = m_Cells[pos & m_Mask];
+            uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<int64_t>(sequence - pos);
+            if (diff == 0) {
+                if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_EnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Take the oldest value from the queue, must only be called from the consumer thread
+     * \param value receives the value
+     * \return false if the queue was empty
+     */
+    bool pop(T& value)
+    {
+        Cell& cell = m_Cells[m_DequeuePos & m_Mask];
+        if (cell.sequence.load(std::memory_order_acquire) != m_DequeuePos + 1) {
+            return false;
+        }
+
+        value = std::move(cell.value);
+        cell.sequence.store(m_DequeuePos + m_Mask + 1, std::memory_order_release);
+        ++m_DequeuePos;
+        return true;
+    }
+
+    /** \brief returns true if pop would return a value, consumer thread only */
+    [[nodiscard]] bool hasPending() const
+    {
+        return m_Cells[m_DequeuePos & m_Mask].sequence.load(std::memory_order_acquire) == m_DequeuePos + 1;
+    }
+
+    /** \brief returns the number of values that were ever added to the queue */
+    [[nodiscard]] uint64_t getPushedCount() const
+    {
+        return m_EnqueuePos.load(std::memory_order_acquire);
+    }
+
+    /** \brief returns the number of slots */
+    [[nodiscard]] size_t getCapacity() const
+    {
+        return m_Mask + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_Cells;
+    const uint64_t m_Mask;
+    alignas(64) std::atomic<uint64_t> m_EnqueuePos { 0 };
+    alignas(64) uint64_t m_DequeuePos = 0;
+};
+
+#endif
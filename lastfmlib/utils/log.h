@@ -17,75 +17,100 @@
 #ifndef UTILS_LOG_H
 #define UTILS_LOG_H
 
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "logbackend.h"
+#include "logratelimit.h"
+
+/** The least severe level that is compiled in: 0 debug, 1 info, 2 warning,
+ * 3 error, 4 critical. Statements below it compile to nothing.
+ */
+#ifndef LASTFMLIB_MIN_LOG_LEVEL
+#define LASTFMLIB_MIN_LOG_LEVEL 0
+#endif
+
 namespace Log {
-template <typename T1>
-void info(const T1& t1);
-template <typename T1, typename T2>
-void info(const T1& t1, const T2& t2);
-template <typename T1, typename T2, typename T3>
-void info(const T1& t1, const T2& t2, const T3& t3);
-template <typename T1, typename T2, typename T3, typename T4>
-void info(const T1& t1, const T2& t2, const T3& t3, const T4& t4);
-template <typename T1, typename T2, typename T3, typename T4, typename T5>
-void info(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5);
-template <typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
-void info(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5, const T6& t6);
-
-template <typename T1>
-void warn(const T1& t1);
-template <typename T1, typename T2>
-void warn(const T1& t1, const T2& t2);
-template <typename T1, typename T2, typename T3>
-void warn(const T1& t1, const T2& t2, const T3& t3);
-template <typename T1, typename T2, typename T3, typename T4>
-void warn(const T1& t1, const T2& t2, const T3& t3, const T4& t4);
-template <typename T1, typename T2, typename T3, typename T4, typename T5>
-void warn(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5);
-template <typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
-void warn(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5, const T6& t6);
-
-template <typename T1>
-void critical(const T1& t1);
-template <typename T1, typename T2>
-void critical(const T1& t1, const T2& t2);
-template <typename T1, typename T2, typename T3>
-void critical(const T1& t1, const T2& t2, const T3& t3);
-template <typename T1, typename T2, typename T3, typename T4>
-void critical(const T1& t1, const T2& t2, const T3& t3, const T4& t4);
-template <typename T1, typename T2, typename T3, typename T4, typename T5>
-void critical(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5);
-template <typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
-void critical(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5, const T6& t6);
-
-template <typename T1>
-void error(const T1& t1);
-template <typename T1, typename T2>
-void error(const T1& t1, const T2& t2);
-template <typename T1, typename T2, typename T3>
-void error(const T1& t1, const T2& t2, const T3& t3);
-template <typename T1, typename T2, typename T3, typename T4>
-void error(const T1& t1, const T2& t2, const T3& t3, const T4& t4);
-template <typename T1, typename T2, typename T3, typename T4, typename T5>
-void error(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5);
-template <typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
-void error(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5, const T6& t6);
-
-template <typename T1>
-void debug(const T1& t1);
-template <typename T1, typename T2>
-void debug(const T1& t1, const T2& t2);
-template <typename T1, typename T2, typename T3>
-void debug(const T1& t1, const T2& t2, const T3& t3);
-template <typename T1, typename T2, typename T3, typename T4>
-void debug(const T1& t1, const T2& t2, const T3& t3, const T4& t4);
-template <typename T1, typename T2, typename T3, typename T4, typename T5>
-void debug(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5);
-template <typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
-void debug(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5, const T6& t6);
-template <typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7>
-void debug(const T1& t1, const T2& t2, const T3& t3, const T4& t4, const T5& t5, const T6& t6, const T7& t7);
-} // namespace Log
 
-#include "log.cpp"
+static constexpr Level MINIMUM_LEVEL = static_cast<Level>(LASTFMLIB_MIN_LOG_LEVEL);
+
+/** \brief returns true if messages of the level are written */
+inline bool isEnabled(Level level)
+{
+    return level >= MINIMUM_LEVEL && level >= getLevel();
+}
+
+/** The first part of a message, the conversion from the text captures the
+ * location of the log statement, which identifies its call site
+ */
+struct MessageStart {
+    MessageStart(const char* text, const char* file = __builtin_FILE(), unsigned int line = __builtin_LINE())
+    : text(text)
+    , location { file, line }
+    {
+    }
+
+    MessageStart(const std::string& text, const char* file = __builtin_FILE(), unsigned int line = __builtin_LINE())
+    : text(text)
+    , location { file, line }
+    {
+    }
+
+    std::string_view text;
+    SourceLocation location;
+};
+
+/** Write the arguments separated by spaces. The arguments are only
+ * formatted when the level is enabled and the rate limit of the call
+ * site is not exceeded: pass the parts of a message as separate
+ * arguments instead of concatenating them at the call site.
+ */
+template <Level level, typename... Args>
+void log([[maybe_unused]] const MessageStart& start, [[maybe_unused]] const Args&... args)
+{
+    if constexpr (level >= MINIMUM_LEVEL) {
+        if (level < getLevel() || !admit(level, start.location)) {
+            return;
+        }
+
+        std::ostringstream ss;
+        ss << start.text;
+        ((ss << ' ' << args), ...);
+        write(level, ss.str());
+    }
+}
+
+template <typename... Args>
+void debug(const MessageStart& start, const Args&... args)
+{
+    log<Level::Debug>(start, args...);
+}
+
+template <typename... Args>
+void info(const MessageStart& start, const Args&... args)
+{
+    log<Level::Info>(start, args...);
+}
+
+template <typename... Args>
+void warn(const MessageStart& start, const Args&... args)
+{
+    log<Level::Warning>(start, args...);
+}
+
+template <typename... Args>
+void error(const MessageStart& start, const Args&... args)
+{
+    log<Level::Error>(start, args...);
+}
+
+template <typename... Args>
+void critical(const MessageStart& start, const Args&... args)
+{
+    log<Level::Critical>(start, args...);
+}
+
+} // namespace Log
 
 #endif
@@ -0,0 +1,284 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "logbackend.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef ENABLE_LOGGING
+#include <syslog.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include "boundedmpscqueue.h"
+#include "logratelimit.h"
+
+using namespace std;
+
+namespace Log {
+
+static constexpr string_view red = "\033[31m";
+[[maybe_unused]] static constexpr string_view green = "\033[32m";
+static constexpr string_view yellow = "\033[33m";
+static constexpr string_view purple = "\033[35m";
+static constexpr string_view standard = "\033[39m";
+
+static const size_t QUEUE_SIZE = 8192;
+static const chrono::milliseconds IDLE_WAKEUP_INTERVAL(50);
+
+static atomic<Level> runtimeLevel { Level::Debug };
+
+struct Record {
+    Level level = Level::Debug;
+    string message;
+};
+
+static void output(const Record& record)
+{
+    switch (record.level) {
+    case Level::Debug:
+#ifdef ENABLE_LOGGING
+        syslog(LOG_DEBUG, "%s", record.message.c_str());
+#endif
+#ifdef ENABLE_DEBUG
+        cout << "DEBUG: " << record.message << '\n';
+#endif
+        break;
+    case Level::Info:
+#ifdef ENABLE_LOGGING
+        syslog(LOG_INFO, "%s", record.message.c_str());
+#endif
+#ifdef ENABLE_DEBUG
+        cout << green << "INFO:  " << record.message << standard << '\n';
+#endif
+        break;
+    case Level::Warning:
+#ifdef ENABLE_LOGGING
+        syslog(LOG_WARNING, "%s", record.message.c_str());
+#endif
+        cout << yellow << "WARN:  " << record.message << standard << '\n';
+        break;
+    case Level::Error:
+#ifdef ENABLE_LOGGING
+        syslog(LOG_ERR, "%s", record.message.c_str());
+#endif
+        cerr << red << "ERROR: " << record.message << standard << '\n';
+        break;
+    case Level::Critical:
+#ifdef ENABLE_LOGGING
+        syslog(LOG_CRIT, "%s", record.message.c_str());
+#endif
+        cerr << purple << "CRIT:  " << record.message << standard << '\n';
+        break;
+    }
+}
+
+/** Owns the record queue and the thread that writes the records */
+class AsyncBackend {
+public:
+    // Never destroyed: objects with static storage may still log from
+    // their destructors, the exit handler switches to synchronous output
+    static AsyncBackend& instance()
+    {
+        static auto* pBackend = createInstance();
+        return *pBackend;
+    }
+
+    void write(Level level, string& message)
+    {
+        if (!m_Asynchronous.load(memory_order_acquire)) {
+            output(Record { level, move(message) });
+            cout.flush();
+            return;
+        }
+
+        Record record { level, move(message) };
+        if (!m_Queue.push(record)) {
+            m_Dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+
+        if (m_ConsumerIdle.exchange(false)) {
+            m_WakeUp.notify_one();
+        }
+    }
+
+    void flush()
+    {
+        auto target = m_Queue.getPushedCount();
+        auto lock = unique_lock(m_Mutex);
+        if (!m_Thread.joinable()) {
+            return;
+        }
+
+        m_FlushRequested = true;
+        m_WakeUp.notify_one();
+        m_Flushed.wait(lock, [&]() { return m_Written >= target || !m_Thread.joinable(); });
+    }
+
+    void setAsynchronous(bool enabled)
+    {
+        if (enabled) {
+            auto lock = scoped_lock(m_Mutex);
+            m_Asynchronous = true;
+            if (!m_Thread.joinable()) {
+                m_Stop = false;
+                m_Thread = thread(&AsyncBackend::run, this);
+            }
+        } else {
+            stop();
+        }
+    }
+
+    uint64_t getDroppedCount() const
+    {
+        return m_Dropped.load(memory_order_relaxed);
+    }
+
+private:
+    AsyncBackend()
+    : m_Queue(QUEUE_SIZE)
+    {
+        setAsynchronous(true);
+    }
+
+    static AsyncBackend* createInstance()
+    {
+        auto* pBackend = new AsyncBackend();
+        atexit([]() { AsyncBackend::instance().stop(); });
+        return pBackend;
+    }
+
+    // Writers that still see the asynchronous flag after it was cleared
+    // get their records in the queue before the consumer drains it for
+    // the last time, later records are written synchronously
+    void stop()
+    {
+        thread consumer;
+        {
+            auto lock = scoped_lock(m_Mutex);
+            m_Asynchronous = false;
+            m_Stop = true;
+            consumer = move(m_Thread);
+        }
+
+        if (consumer.joinable()) {
+            m_WakeUp.notify_one();
+            consumer.join();
+            m_Flushed.notify_all();
+        }
+    }
+
+    void run()
+    {
+        Record record;
+        uint64_t written = 0;
+        {
+            auto lock = scoped_lock(m_Mutex);
+            written = m_Written;
+        }
+
+        auto nextSummaries = chrono::steady_clock::now();
+        for (;;) {
+            if (chrono::steady_clock::now() >= nextSummaries) {
+                writeSuppressionSummaries();
+                nextSummaries = chrono::steady_clock::now() + IDLE_WAKEUP_INTERVAL;
+            }
+
+            auto batchStart = written;
+            while (m_Queue.pop(record)) {
+                output(record);
+                ++written;
+            }
+
+            if (written != batchStart) {
+                cout.flush();
+            }
+
+            auto lock = unique_lock(m_Mutex);
+            if (written != batchStart) {
+                m_Written = written;
+                m_Flushed.notify_all();
+            }
+
+            if (m_Stop && !m_Queue.hasPending()) {
+                return;
+            }
+
+            m_FlushRequested = false;
+            m_ConsumerIdle = true;
+            m_WakeUp.wait_for(lock, IDLE_WAKEUP_INTERVAL, [this]() {
+                return m_Stop || m_FlushRequested || m_Queue.hasPending();
+            });
+            m_ConsumerIdle = false;
+        }
+    }
+
+    BoundedMpscQueue<Record> m_Queue;
+    atomic<uint64_t> m_Dropped { 0 };
+    atomic<bool> m_Asynchronous { false };
+    atomic<bool> m_ConsumerIdle { false };
+
+    mutex m_Mutex;
+    condition_variable m_WakeUp;
+    condition_variable m_Flushed;
+    thread m_Thread;
+    uint64_t m_Written = 0;
+    bool m_FlushRequested = false;
+    bool m_Stop = false;
+};
+
+void setLevel(Level level)
+{
+    runtimeLevel.store(level, memory_order_relaxed);
+}
+
+Level getLevel()
+{
+    return runtimeLevel.load(memory_order_relaxed);
+}
+
+void write(Level level, string message)
+{
+    AsyncBackend::instance().write(level, message);
+}
+
+void flush()
+{
+    AsyncBackend::instance().flush();
+}
+
+void setAsynchronous(bool enabled)
+{
+    AsyncBackend::instance().setAsynchronous(enabled);
+}
+
+uint64_t getDroppedCount()
+{
+    return AsyncBackend::instance().getDroppedCount();
+}
+
+} // namespace Log
@@ -0,0 +1,75 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file logbackend.h
+ * @brief Contains the asynchronous backend of the Log functions
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef UTILS_LOG_BACKEND_H
+#define UTILS_LOG_BACKEND_H
+
+#include <cstdint>
+#include <string>
+
+namespace Log {
+
+/** The severity of a log record */
+enum class Level {
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Critical,
+};
+
+/** Set the least severe level that is written, messages below it are
+ * discarded before they are formatted (debug by default)
+ * \param level the minimum level
+ */
+void setLevel(Level level);
+
+/** \brief returns the least severe level that is written */
+Level getLevel();
+
+/** Hand a formatted message to the log backend. In asynchronous mode
+ * (the default) the message is put in a bounded lock-free queue and
+ * written to syslog and the console by a background thread. The call
+ * never blocks: when the queue is full the message is dropped and
+ * counted.
+ * \param level the severity of the message
+ * \param message the message text
+ */
+void write(Level level, std::string message);
+
+/** Wait until all messages that were queued before the call have been
+ * written
+ */
+void flush();
+
+/** Switch between asynchronous and synchronous output, pending messages
+ * are flushed before the mode changes
+ * \param enabled when false every message is written on the calling thread
+ */
+void setAsynchronous(bool enabled);
+
+/** \brief returns the number of messages that were dropped because the queue was full */
+uint64_t getDroppedCount();
+
+} // namespace Log
+
+#endif
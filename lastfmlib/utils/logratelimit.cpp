@@ -0,0 +1,229 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "logratelimit.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace Log {
+
+// the log statements bound the number of call sites, this bounds the memory
+// when a statement is compiled into many translation units
+static const size_t MAX_CALL_SITES = 4096;
+
+namespace {
+// the file name is a string literal, a file has a single copy of it
+struct CallSiteKey {
+    const char* file {};
+    unsigned int line {};
+
+    bool operator==(const CallSiteKey& other) const
+    {
+        return file == other.file && line == other.line;
+    }
+};
+
+struct CallSiteKeyHash {
+    size_t operator()(const CallSiteKey& key) const
+    {
+        return std::hash<const void*>()(key.file) ^ key.line;
+    }
+};
+
+struct CallSite {
+    Level level {};
+    steady_clock::time_point intervalStart;
+    unsigned int written {};
+    unsigned int aboveLimit {};
+    uint64_t suppressed {};
+    string description;
+};
+
+/** Keeps the state of the call sites of the limited levels */
+class CallSiteLimiter {
+public:
+    // Never destroyed: the log backend thread writes the summaries until the process exits
+    static CallSiteLimiter& instance()
+    {
+        static auto* pLimiter = new CallSiteLimiter();
+        return *pLimiter;
+    }
+
+    void setLimit(Level level, const RateLimit& limit)
+    {
+        auto lock = scoped_lock(m_Mutex);
+        m_Limits[static_cast<size_t>(level)] = limit;
+        m_Enabled[static_cast<size_t>(level)] = limit.burst > 0;
+    }
+
+    bool isEnabled(Level level) const
+    {
+        return m_Enabled[static_cast<size_t>(level)].load(memory_order_relaxed);
+    }
+
+    bool admit(Level level, const SourceLocation& location)
+    {
+        auto now = steady_clock::now();
+        CallSiteKey key { location.file, location.line };
+        vector<pair<Level, string>> summaries;
+        bool admitted = true;
+        {
+            auto lock = scoped_lock(m_Mutex);
+            const RateLimit& limit = m_Limits[static_cast<size_t>(level)];
+            if (limit.burst == 0) {
+                return true;
+            }
+
+            if (m_CallSites.size() >= MAX_CALL_SITES && m_CallSites.count(key) == 0) {
+                removeExpired(now, summaries);
+                if (m_CallSites.size() >= MAX_CALL_SITES) {
+                    return true;
+                }
+            }
+
+            auto [iter, inserted] = m_CallSites.try_emplace(key);
+            CallSite& site = iter->second;
+            if (inserted) {
+                site.level = level;
+                site.intervalStart = now;
+                site.description = describe(location);
+            } else if (now - site.intervalStart >= limit.interval) {
+                if (site.suppressed > 0) {
+                    summaries.emplace_back(level, createSummary(site));
+                }
+                site.intervalStart = now;
+                site.written = 0;
+                site.aboveLimit = 0;
+                site.suppressed = 0;
+            }
+
+            if (site.written < limit.burst) {
+                ++site.written;
+            } else if (limit.sampleRate != 0 && ++site.aboveLimit % limit.sampleRate == 0) {
+                // a sample of the flood stays visible
+            } else {
+                ++site.suppressed;
+                admitted = false;
+            }
+        }
+
+        if (!admitted) {
+            m_SuppressedCount.fetch_add(1, memory_order_relaxed);
+        }
+
+        for (auto& [summaryLevel, summary] : summaries) {
+            write(summaryLevel, std::move(summary));
+        }
+
+        return admitted;
+    }
+
+    void writeSummaries()
+    {
+        if (!any_of(m_Enabled.begin(), m_Enabled.end(), [](const atomic<bool>& enabled) { return enabled.load(memory_order_relaxed); })) {
+            return;
+        }
+
+        vector<pair<Level, string>> summaries;
+        {
+            auto lock = scoped_lock(m_Mutex);
+            removeExpired(steady_clock::now(), summaries);
+        }
+
+        for (auto& [level, summary] : summaries) {
+            write(level, std::move(summary));
+        }
+    }
+
+    uint64_t getSuppressedCount() const
+    {
+        return m_SuppressedCount.load(memory_order_relaxed);
+    }
+
+private:
+    CallSiteLimiter() = default;
+
+    static string describe(const SourceLocation& location)
+    {
+        const char* file = strrchr(location.file, '/');
+        return string(file ? file + 1 : location.file) + ":" + to_string(location.line);
+    }
+
+    static string createSummary(const CallSite& site)
+    {
+        return to_string(site.suppressed) + " similar messages suppressed: " + site.description;
+    }
+
+    // the call sites of which the interval ended are forgotten, a new interval starts with their next message
+    void removeExpired(steady_clock::time_point now, vector<pair<Level, string>>& summaries)
+    {
+        for (auto iter = m_CallSites.begin(); iter != m_CallSites.end();) {
+            const CallSite& site = iter->second;
+            if (now - site.intervalStart < m_Limits[static_cast<size_t>(site.level)].interval) {
+                ++iter;
+                continue;
+            }
+
+            if (site.suppressed > 0) {
+                summaries.emplace_back(site.level, createSummary(site));
+            }
+            iter = m_CallSites.erase(iter);
+        }
+    }
+
+    array<RateLimit, 5> m_Limits {};
+    array<atomic<bool>, 5> m_Enabled {};
+    unordered_map<CallSiteKey, CallSite, CallSiteKeyHash> m_CallSites;
+    atomic<uint64_t> m_SuppressedCount { 0 };
+    mutex m_Mutex;
+};
+} // namespace
+
+void setRateLimit(Level level, const RateLimit& limit)
+{
+    CallSiteLimiter::instance().setLimit(level, limit);
+}
+
+uint64_t getSuppressedCount()
+{
+    return CallSiteLimiter::instance().getSuppressedCount();
+}
+
+bool admit(Level level, const SourceLocation& location)
+{
+    CallSiteLimiter& limiter = CallSiteLimiter::instance();
+    if (!limiter.isEnabled(level)) {
+        return true;
+    }
+
+    return limiter.admit(level, location);
+}
+
+void writeSuppressionSummaries()
+{
+    CallSiteLimiter::instance().writeSummaries();
+}
+
+} // namespace Log
@@ -0,0 +1,73 @@
+//    Copyright (C) 2009 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/**
+ * @file logratelimit.h
+ * @brief Contains the flood suppression of the Log functions
+ * @author Dirk Vanden Boer
+ */
+
+#ifndef UTILS_LOG_RATE_LIMIT_H
+#define UTILS_LOG_RATE_LIMIT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "logbackend.h"
+
+namespace Log {
+
+/** The RateLimit struct limits the messages of a single call site, the
+ * log statement identified by its file and line.
+ */
+struct RateLimit {
+    unsigned int burst {}; /**< \brief messages of a call site written per interval, 0 disables the limit */
+    std::chrono::milliseconds interval { std::chrono::seconds(10) }; /**< \brief the length of the interval */
+    unsigned int sampleRate {}; /**< \brief 1 in sampleRate messages above the limit is still written, 0 writes none */
+};
+
+/** Limit the messages of every call site of a level. At the end of an
+ * interval in which messages were suppressed, a single "N similar
+ * messages suppressed" message is written. No levels are limited by default.
+ * \param level the level to limit
+ * \param limit the limit of a call site
+ */
+void setRateLimit(Level level, const RateLimit& limit);
+
+/** \brief returns the number of messages that were suppressed by the rate limits */
+uint64_t getSuppressedCount();
+
+/** \brief the location of a log statement */
+struct SourceLocation {
+    const char* file; /**< \brief the file name, as passed to the compiler */
+    unsigned int line; /**< \brief the line in the file */
+};
+
+/** Check the rate limit of a call site, used by Log::log() before the
+ * message is formatted
+ * \param level the level of the message
+ * \param location the location of the log statement
+ * \return false if the message must be suppressed
+ */
+bool admit(Level level, const SourceLocation& location);
+
+/** Write the summaries of the intervals that ended, called periodically by the log backend */
+void writeSuppressionSummaries();
+
+} // namespace Log
+
+#endif